@@ -0,0 +1,559 @@
+/**
+ * @file BTreeBench.cpp
+ * @brief Benchmark program for the B+ tree. Runs a fixed suite of workloads against fresh tree files:
+ *        sequential and random loads, uniform and Zipfian point lookups, range scans, a delete burst
+ *        and a mixed search and insert workload on an increasing number of threads. Every workload
+ *        reports its throughput, p50 and p99 latency, the heap allocations it made and the TreeStats
+ *        counters as one JSON document on standard output, so runs can be compared between releases.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <cstdio>
+#include <new>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BTreeFile.h"
+#include "HeaderBuffer.h"
+#include "Record.h"
+#include "RecordBuffer.h"
+#include "ParallelCsvReader.h"
+#include "TreeStats.h"
+
+using namespace std;
+
+static atomic<long long> allocationCount(0); // Calls to operator new made by the whole program
+
+/**
+ * Counts every allocation made through operator new, the tree's included, before handing it to malloc.
+ */
+void *operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    void *memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) throw bad_alloc();
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    free(memory);
+}
+
+/**
+ * @brief Settings shared by every workload of a run.
+ */
+struct BenchConfig {
+    int maxThreads = 4;                                         /**< Most threads for the mixed workload */
+    int operations = 200000;                                    /**< Operations per lookup and mixed run */
+    int readPercent = 90;                                       /**< Share of mixed operations that search */
+    int scanWidth = 1000;                                       /**< Keys covered by each range scan */
+    int cacheCapacity = 4096;                                   /**< Nodes the buffer pool keeps */
+    unsigned seed = 1;                                          /**< Seed for every random choice */
+    BTreeFile::ConcurrencyMode mode = BTreeFile::LATCH_CRABBING; /**< Latching protocol */
+    BTreeFile::SplitMode splitMode = BTreeFile::ONE_TO_TWO;     /**< How full nodes split */
+};
+
+/**
+ * @brief What one workload measured.
+ */
+struct WorkloadResult {
+    string name;                /**< Name of the workload */
+    int threads = 1;            /**< Threads the workload ran on */
+    long long operations = 0;   /**< Operations completed */
+    double seconds = 0;         /**< Wall clock time taken */
+    vector<double> latencies;   /**< Time each operation took, in microseconds */
+    TreeStats::Counts counts{}; /**< Block I/O and structural changes during the workload */
+    long long allocations = 0;  /**< Heap allocations made during the workload */
+    int height = 0;             /**< Height of the tree afterwards */
+};
+
+/**
+ * @brief The counters at the start of a workload.
+ */
+struct Snapshot {
+    TreeStats::Counts counts{}; /**< TreeStats counters */
+    long long allocations = 0;  /**< Heap allocations made so far */
+};
+
+// Function prototypes
+bool loadRecords(const string &fileName, vector<RecordBuffer> &records);
+RecordBuffer makeRecord(RecordBuffer recordBuffer, int key);
+bool openTree(BTreeFile &bTreeFile, string &fileName, const BenchConfig &config);
+WorkloadResult runLoad(BTreeFile &bTreeFile, const string &name, vector<RecordBuffer> &records);
+WorkloadResult runLookups(BTreeFile &bTreeFile, const string &name, const vector<int> &keys,
+                          const BenchConfig &config, bool zipfian);
+WorkloadResult runScans(BTreeFile &bTreeFile, const vector<int> &keys, const BenchConfig &config);
+WorkloadResult runDeletes(BTreeFile &bTreeFile, vector<RecordBuffer> records, const BenchConfig &config);
+WorkloadResult runMixedWorkload(BTreeFile &bTreeFile, const vector<RecordBuffer> &records, int threads,
+                                const BenchConfig &config, atomic<int> &nextKey);
+Snapshot takeSnapshot();
+void finishResult(WorkloadResult &result, BTreeFile &bTreeFile, const Snapshot &before);
+double percentile(vector<double> &sorted, double fraction);
+void writeJson(ostream &out, const BenchConfig &config, size_t records, vector<WorkloadResult> &results);
+
+/**
+ * Entry point for the benchmark. The last argument is the CSV file of records to load.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Array of command line arguments.
+ * @return int Program exit status.
+ */
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    config.maxThreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 4;
+    string randomFileName; // Records in the order the random load inserts them, optional.
+
+    if (argc < 2) {
+        cerr << "Usage: btree_bench [-THREADS n] [-OPERATIONS n] [-READ_PERCENT p] [-SCAN_WIDTH keys] [-CACHE nodes]"
+                " [-SEED s] [-RANDOM_RECORDS random.csv] [-BLINK] [-TWO_TO_THREE] records.csv" << endl;
+        return -1;
+    }
+
+    for (int i = 1; i < argc - 1; i++) {
+        string arg = argv[i];
+        if (arg == "-THREADS" && i + 1 < argc - 1) {
+            config.maxThreads = stoi(argv[++i]);
+        } else if (arg == "-OPERATIONS" && i + 1 < argc - 1) {
+            config.operations = stoi(argv[++i]);
+        } else if (arg == "-READ_PERCENT" && i + 1 < argc - 1) {
+            config.readPercent = stoi(argv[++i]);
+        } else if (arg == "-SCAN_WIDTH" && i + 1 < argc - 1) {
+            config.scanWidth = stoi(argv[++i]);
+        } else if (arg == "-CACHE" && i + 1 < argc - 1) {
+            config.cacheCapacity = stoi(argv[++i]);
+        } else if (arg == "-SEED" && i + 1 < argc - 1) {
+            config.seed = stoul(argv[++i]);
+        } else if (arg == "-RANDOM_RECORDS" && i + 1 < argc - 1) {
+            randomFileName = argv[++i];
+        } else if (arg == "-BLINK") {
+            config.mode = BTreeFile::B_LINK;
+        } else if (arg == "-TWO_TO_THREE") {
+            config.splitMode = BTreeFile::TWO_TO_THREE;
+        }
+    }
+
+    vector<RecordBuffer> records;
+    if (!loadRecords(argv[argc - 1], records) || records.empty()) {
+        cerr << "Failed to load records from " << argv[argc - 1] << endl;
+        return -1;
+    }
+
+    // Without a second file the random load shuffles the records with the seed
+    vector<RecordBuffer> randomRecords;
+    if (!randomFileName.empty()) {
+        if (!loadRecords(randomFileName, randomRecords) || randomRecords.empty()) {
+            cerr << "Failed to load records from " << randomFileName << endl;
+            return -1;
+        }
+    } else {
+        randomRecords = records;
+        shuffle(randomRecords.begin(), randomRecords.end(), mt19937(config.seed));
+    }
+
+    string bTreeFileName = "btree_bench.idx";
+    vector<WorkloadResult> results;
+
+    // The sequentially loaded tree is closed again, the rest of the suite runs on the randomly loaded one
+    {
+        HeaderBuffer headerBuffer;
+        BTreeFile bTreeFile(headerBuffer, 10, config.cacheCapacity);
+        if (!openTree(bTreeFile, bTreeFileName, config)) {
+            return -1;
+        }
+        results.push_back(runLoad(bTreeFile, "load_sequential", records));
+    }
+
+    HeaderBuffer headerBuffer;
+    BTreeFile bTreeFile(headerBuffer, 10, config.cacheCapacity);
+    if (!openTree(bTreeFile, bTreeFileName, config)) {
+        return -1;
+    }
+    results.push_back(runLoad(bTreeFile, "load_random", randomRecords));
+
+    vector<int> keys;
+    for (auto &recordBuffer : records) {
+        keys.push_back(recordBuffer.getRecordKey());
+    }
+    sort(keys.begin(), keys.end());
+
+    results.push_back(runLookups(bTreeFile, "lookup_uniform", keys, config, false));
+    results.push_back(runLookups(bTreeFile, "lookup_zipfian", keys, config, true));
+    results.push_back(runScans(bTreeFile, keys, config));
+    results.push_back(runDeletes(bTreeFile, randomRecords, config));
+
+    // Fresh keys for inserts start above the largest ZIP code
+    atomic<int> nextKey(max(100000, keys.back() + 1));
+
+    for (int threads = 1; threads <= config.maxThreads; threads *= 2) {
+        results.push_back(runMixedWorkload(bTreeFile, records, threads, config, nextKey));
+    }
+
+    writeJson(cout, config, records.size(), results);
+    return 0;
+}
+
+
+/**
+ * Reads every record of a CSV file into memory.
+ *
+ * @param fileName Name of the CSV file to read.
+ * @param records Vector to store the records in.
+ * @return True if the file could be read.
+ */
+bool loadRecords(const string &fileName, vector<RecordBuffer> &records) {
+    ParallelCsvReader csvReader;
+
+    if (!csvReader.openFile(fileName)) {
+        return false;
+    }
+
+    csvReader.readBatches([&records](vector<RecordBuffer> &batch) {
+        records.insert(records.end(), make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+    });
+
+    return true;
+}
+
+
+/**
+ * Copies a record under a new key, used to insert records that are not in the tree yet.
+ *
+ * @param recordBuffer The record to copy the fields from.
+ * @param key The key of the new record.
+ * @return The new record.
+ */
+RecordBuffer makeRecord(RecordBuffer recordBuffer, int key) {
+    Record record(recordBuffer);
+    RecordBuffer newRecord;
+
+    newRecord.pack(to_string(key));
+    newRecord.pack(record.PlaceName);
+    newRecord.pack(record.State);
+    newRecord.pack(record.County);
+    newRecord.pack(to_string(record.Lat));
+    newRecord.pack(to_string(record.Long));
+
+    return newRecord;
+}
+
+
+/**
+ * Opens a tree on a fresh file, removing whatever an earlier run left behind.
+ *
+ * @param bTreeFile The tree to open.
+ * @param fileName Name of the tree file.
+ * @param config Settings for the tree.
+ * @return True if the tree could be opened.
+ */
+bool openTree(BTreeFile &bTreeFile, string &fileName, const BenchConfig &config) {
+    std::remove(fileName.c_str());
+    bTreeFile.setConcurrencyMode(config.mode);
+    bTreeFile.setSplitMode(config.splitMode);
+    if (!bTreeFile.openFile(fileName)) {
+        cerr << "Failed to open " << fileName << "!" << endl;
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Times one operation and records how long it took.
+ *
+ * @param result The workload to record the latency in.
+ * @param operation The operation to run.
+ */
+template <typename Operation>
+void timeOperation(WorkloadResult &result, Operation operation) {
+    auto start = chrono::steady_clock::now();
+    operation();
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+    result.latencies.push_back(elapsed.count());
+}
+
+
+/**
+ * Inserts records into the tree in the order given, then flushes it so the writes are counted.
+ *
+ * @param bTreeFile The tree to load, normally empty.
+ * @param name Name to report the workload under.
+ * @param records The records to insert.
+ * @return What the load measured.
+ */
+WorkloadResult runLoad(BTreeFile &bTreeFile, const string &name, vector<RecordBuffer> &records) {
+    WorkloadResult result;
+    result.name = name;
+    Snapshot before = takeSnapshot();
+
+    auto start = chrono::steady_clock::now();
+    for (auto &recordBuffer : records) {
+        timeOperation(result, [&]() { bTreeFile.insert(recordBuffer); });
+    }
+    bTreeFile.flushData();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    result.operations = records.size();
+    result.seconds = elapsed.count();
+    finishResult(result, bTreeFile, before);
+    return result;
+}
+
+
+/**
+ * Searches for keys in the tree, each picked uniformly or with a Zipfian skew. The Zipfian ranks
+ * are mapped to keys through a shuffle, so the popular keys are spread over the whole tree.
+ *
+ * @param bTreeFile The tree to search.
+ * @param name Name to report the workload under.
+ * @param keys The keys in the tree, in order.
+ * @param config Settings for the run, giving the operation count and seed.
+ * @param zipfian True to skew the picks with an exponent of 0.99, false to pick uniformly.
+ * @return What the lookups measured.
+ */
+WorkloadResult runLookups(BTreeFile &bTreeFile, const string &name, const vector<int> &keys,
+                          const BenchConfig &config, bool zipfian) {
+    WorkloadResult result;
+    result.name = name;
+    mt19937 rng(config.seed);
+
+    vector<int> order = keys;
+    shuffle(order.begin(), order.end(), rng);
+
+    // Cumulative weights of the ranks, rank r weighs 1 / r^0.99
+    vector<double> cumulative(order.size());
+    double total = 0;
+    for (size_t rank = 0; rank < order.size(); rank++) {
+        total += zipfian ? 1.0 / pow(rank + 1, 0.99) : 1.0;
+        cumulative[rank] = total;
+    }
+    uniform_real_distribution<double> pickWeight(0, total);
+
+    RecordBuffer recordBuffer;
+    Snapshot before = takeSnapshot();
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < config.operations; i++) {
+        size_t rank = lower_bound(cumulative.begin(), cumulative.end(), pickWeight(rng)) - cumulative.begin();
+        int key = order[min(rank, order.size() - 1)];
+        timeOperation(result, [&]() { bTreeFile.search(recordBuffer, key); });
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    result.operations = config.operations;
+    result.seconds = elapsed.count();
+    finishResult(result, bTreeFile, before);
+    return result;
+}
+
+
+/**
+ * Runs range searches of a fixed key width starting at uniformly picked keys.
+ *
+ * @param bTreeFile The tree to scan.
+ * @param keys The keys in the tree, in order.
+ * @param config Settings for the run, one scan is run for every hundred operations.
+ * @return What the scans measured.
+ */
+WorkloadResult runScans(BTreeFile &bTreeFile, const vector<int> &keys, const BenchConfig &config) {
+    WorkloadResult result;
+    result.name = "range_scan";
+    mt19937 rng(config.seed);
+    uniform_int_distribution<size_t> pickKey(0, keys.size() - 1);
+
+    vector<RecordBuffer> found;
+    int scans = max(1, config.operations / 100);
+    Snapshot before = takeSnapshot();
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < scans; i++) {
+        int lowKey = keys[pickKey(rng)];
+        found.clear();
+        timeOperation(result, [&]() { bTreeFile.rangeSearch(lowKey, lowKey + config.scanWidth, found); });
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    result.operations = scans;
+    result.seconds = elapsed.count();
+    finishResult(result, bTreeFile, before);
+    return result;
+}
+
+
+/**
+ * Deletes a tenth of the records in a burst, in an order picked with the seed, then flushes the tree.
+ *
+ * @param bTreeFile The tree to delete from.
+ * @param records The records in the tree.
+ * @param config Settings for the run, giving the seed.
+ * @return What the deletes measured.
+ */
+WorkloadResult runDeletes(BTreeFile &bTreeFile, vector<RecordBuffer> records, const BenchConfig &config) {
+    WorkloadResult result;
+    result.name = "delete_burst";
+    shuffle(records.begin(), records.end(), mt19937(config.seed + 1));
+    records.resize(max<size_t>(1, records.size() / 10));
+    Snapshot before = takeSnapshot();
+
+    auto start = chrono::steady_clock::now();
+    for (auto &recordBuffer : records) {
+        timeOperation(result, [&]() { bTreeFile.remove(recordBuffer); });
+    }
+    bTreeFile.flushData();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    result.operations = records.size();
+    result.seconds = elapsed.count();
+    finishResult(result, bTreeFile, before);
+    return result;
+}
+
+
+/**
+ * Runs searches for existing keys mixed with inserts of new keys on several threads.
+ *
+ * @param bTreeFile The tree to run against.
+ * @param records The loaded records, searches pick their keys from these.
+ * @param threads Number of threads to run.
+ * @param config Settings for the run, the operations are split evenly across the threads.
+ * @param nextKey Source of keys for inserted records.
+ * @return What the run measured.
+ */
+WorkloadResult runMixedWorkload(BTreeFile &bTreeFile, const vector<RecordBuffer> &records, int threads,
+                                const BenchConfig &config, atomic<int> &nextKey) {
+    vector<thread> workers;
+    vector<WorkloadResult> perThreadResults(threads);
+    int perThread = config.operations / threads;
+    Snapshot before = takeSnapshot();
+
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            mt19937 rng(config.seed + t);
+            uniform_int_distribution<int> pickRecord(0, records.size() - 1);
+            uniform_int_distribution<int> pickPercent(0, 99);
+            RecordBuffer result;
+
+            for (int i = 0; i < perThread; i++) {
+                RecordBuffer recordBuffer = records[pickRecord(rng)];
+                if (pickPercent(rng) < config.readPercent) {
+                    timeOperation(perThreadResults[t], [&]() {
+                        bTreeFile.search(result, recordBuffer.getRecordKey());
+                    });
+                } else {
+                    RecordBuffer newRecord = makeRecord(recordBuffer, nextKey++);
+                    timeOperation(perThreadResults[t], [&]() { bTreeFile.insert(newRecord); });
+                }
+            }
+        });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    WorkloadResult result;
+    result.name = "mixed";
+    result.threads = threads;
+    for (auto &threadResult : perThreadResults) {
+        result.latencies.insert(result.latencies.end(), threadResult.latencies.begin(),
+                                threadResult.latencies.end());
+    }
+    result.operations = static_cast<long long>(perThread) * threads;
+    result.seconds = elapsed.count();
+    finishResult(result, bTreeFile, before);
+    return result;
+}
+
+
+/**
+ * Reads the counters at the start of a workload.
+ *
+ * @return The TreeStats counters and the allocations made so far.
+ */
+Snapshot takeSnapshot() {
+    Snapshot snapshot;
+    snapshot.counts = TreeStats::report();
+    snapshot.allocations = allocationCount.load(memory_order_relaxed);
+    return snapshot;
+}
+
+
+/**
+ * Records what the counters and the tree look like at the end of a workload.
+ *
+ * @param result The workload to fill in.
+ * @param bTreeFile The tree the workload ran on.
+ * @param before The counters when the workload started.
+ */
+void finishResult(WorkloadResult &result, BTreeFile &bTreeFile, const Snapshot &before) {
+    result.allocations = allocationCount.load(memory_order_relaxed) - before.allocations;
+    TreeStats::Counts after = TreeStats::report();
+    for (int i = 0; i < TreeStats::COUNTER_COUNT; i++) {
+        result.counts[i] = after[i] - before.counts[i];
+    }
+    result.height = bTreeFile.getHeight();
+}
+
+
+/**
+ * Picks a percentile out of sorted latencies.
+ *
+ * @param sorted The latencies, in increasing order.
+ * @param fraction The percentile as a fraction, 0.99 for p99.
+ * @return The latency at the percentile, 0 if there are none.
+ */
+double percentile(vector<double> &sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+    return sorted[index];
+}
+
+
+/**
+ * Writes the settings and the results of every workload as a JSON document.
+ *
+ * @param out Stream to write to.
+ * @param config Settings of the run.
+ * @param records Number of records loaded.
+ * @param results What each workload measured, the latencies are sorted in place.
+ */
+void writeJson(ostream &out, const BenchConfig &config, size_t records, vector<WorkloadResult> &results) {
+    out << "{\n";
+    out << "  \"config\": {\"records\": " << records << ", \"operations\": " << config.operations
+        << ", \"read_percent\": " << config.readPercent << ", \"scan_width\": " << config.scanWidth
+        << ", \"cache\": " << config.cacheCapacity << ", \"seed\": " << config.seed
+        << ", \"mode\": \"" << (config.mode == BTreeFile::B_LINK ? "blink" : "crabbing")
+        << "\", \"split_mode\": \"" << (config.splitMode == BTreeFile::TWO_TO_THREE ? "two_to_three" : "one_to_two")
+        << "\"},\n";
+    out << "  \"workloads\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        WorkloadResult &result = results[i];
+        sort(result.latencies.begin(), result.latencies.end());
+        out << "    {\"name\": \"" << result.name << "\", \"threads\": " << result.threads
+            << ", \"operations\": " << result.operations << ", \"seconds\": " << result.seconds
+            << ", \"ops_per_sec\": " << (result.seconds > 0 ? result.operations / result.seconds : 0)
+            << ", \"p50_us\": " << percentile(result.latencies, 0.5)
+            << ", \"p99_us\": " << percentile(result.latencies, 0.99)
+            << ", \"allocations\": " << result.allocations
+            << ", \"allocations_per_op\": "
+            << (result.operations > 0 ? static_cast<double>(result.allocations) / result.operations : 0)
+            << ", \"height\": " << result.height;
+        for (int c = 0; c < TreeStats::COUNTER_COUNT; c++) {
+            out << ", \"" << TreeStats::getName(static_cast<TreeStats::Counter>(c)) << "\": " << result.counts[c];
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}" << endl;
+}
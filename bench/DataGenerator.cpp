@@ -0,0 +1,294 @@
+/**
+ * @file DataGenerator.cpp
+ * @brief Generates synthetic ZIP code records for scaling tests. Writes a CSV file with the
+ *        ZipCode,PlaceName,State,County,Lat,Long schema of data_files/us_postal_codes.csv, with
+ *        any number of rows and a choice of how the keys are spread and ordered.
+ *
+ *        SORTED writes evenly spaced keys in increasing order, RANDOM the same keys in a random
+ *        order, and CLUSTERED the same keys in runs of consecutive keys with the runs in a random
+ *        order. ZIPFIAN splits the key space into ranges whose share of the rows follows a Zipfian
+ *        distribution, so a few ranges are packed with keys and most are sparse, and writes the keys
+ *        in a random order. Random orders come from a keyed permutation, so no table of rows is kept.
+ *
+ *        The fields of a row depend only on the seed and its key, so every distribution gives a key
+ *        the same place name, state, county and coordinates, and the same seed always gives the same file.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief A state with the rough box its ZIP codes fall in.
+ */
+struct StateArea {
+    const char *code;   /**< Two letter state code */
+    double lat;         /**< Latitude of the middle of the state */
+    double lng;         /**< Longitude of the middle of the state */
+    double spread;      /**< Degrees coordinates may stray from the middle */
+};
+
+static const StateArea states[] = {
+    {"AL", 32.8, -86.8, 2.0}, {"AK", 61.4, -152.3, 6.0}, {"AZ", 34.2, -111.7, 2.5}, {"AR", 34.9, -92.4, 1.8},
+    {"CA", 37.2, -119.7, 4.0}, {"CO", 39.0, -105.5, 2.5}, {"CT", 41.6, -72.7, 0.5}, {"DE", 39.0, -75.5, 0.5},
+    {"DC", 38.9, -77.0, 0.1}, {"FL", 28.6, -82.4, 3.0}, {"GA", 32.7, -83.4, 2.0}, {"HI", 20.8, -156.3, 1.5},
+    {"ID", 44.4, -114.6, 2.5}, {"IL", 40.0, -89.2, 2.0}, {"IN", 39.9, -86.3, 1.5}, {"IA", 42.1, -93.5, 1.5},
+    {"KS", 38.5, -98.4, 2.0}, {"KY", 37.5, -85.3, 1.5}, {"LA", 31.1, -92.0, 1.5}, {"ME", 45.4, -69.2, 1.5},
+    {"MD", 39.0, -76.8, 0.8}, {"MA", 42.3, -71.8, 0.7}, {"MI", 44.3, -85.4, 2.5}, {"MN", 46.3, -94.3, 2.5},
+    {"MS", 32.7, -89.7, 1.5}, {"MO", 38.4, -92.5, 2.0}, {"MT", 47.0, -109.6, 3.0}, {"NE", 41.5, -99.8, 2.5},
+    {"NV", 39.3, -116.6, 2.5}, {"NH", 43.7, -71.6, 0.7}, {"NJ", 40.2, -74.7, 0.7}, {"NM", 34.4, -106.1, 2.5},
+    {"NY", 42.9, -75.5, 2.0}, {"NC", 35.6, -79.4, 2.0}, {"ND", 47.5, -100.5, 2.0}, {"OH", 40.3, -82.8, 1.5},
+    {"OK", 35.6, -97.5, 2.0}, {"OR", 43.9, -120.6, 2.5}, {"PA", 40.9, -77.8, 1.5}, {"RI", 41.7, -71.5, 0.3},
+    {"SC", 33.9, -80.9, 1.5}, {"SD", 44.4, -100.2, 2.0}, {"TN", 35.9, -86.4, 1.5}, {"TX", 31.5, -99.3, 4.0},
+    {"UT", 39.3, -111.7, 2.0}, {"VT", 44.1, -72.7, 0.7}, {"VA", 37.5, -78.9, 1.8}, {"WA", 47.4, -120.5, 2.0},
+    {"WV", 38.6, -80.6, 1.2}, {"WI", 44.6, -89.9, 2.0}, {"WY", 43.0, -107.5, 2.5},
+};
+
+// Syllables names are built from, giving place names of 4 to 18 and counties of 4 to 14 letters
+static const char *syllables[] = {
+    "ash", "bel", "bur", "cal", "car", "clay", "dal", "den", "eas", "el", "fair", "field", "ford", "glen",
+    "green", "ham", "har", "hill", "kings", "la", "lake", "lin", "mar", "mead", "mil", "mont", "new", "oak",
+    "or", "park", "port", "ridge", "riv", "ro", "sal", "san", "spring", "stone", "ton", "town", "val", "ville",
+    "wa", "well", "west", "win", "wood", "york",
+};
+static const int syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+static const int stateCount = sizeof(states) / sizeof(states[0]);
+
+static const int keySpacing = 2;     // Gap between keys, leaving room to insert between them
+static const int zipfRanges = 1024;  // Ranges the key space is split into for ZIPFIAN
+
+// Function prototypes
+uint64_t mix(uint64_t value);
+uint64_t permute(uint64_t index, uint64_t size, uint64_t seed);
+string makeName(uint64_t &bits, int minSyllables, int maxSyllables);
+void appendRow(string &out, long long key, uint64_t seed);
+
+/**
+ * Entry point for the generator. The last argument is the CSV file to write.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Array of command line arguments.
+ * @return int Program exit status.
+ */
+int main(int argc, char* argv[]) {
+    long long rows = 1000000;
+    string distribution = "RANDOM";
+    long long clusterSize = 1000;
+    uint64_t seed = 1;
+
+    if (argc < 2) {
+        cerr << "Usage: btree_datagen [-ROWS n] [-DISTRIBUTION SORTED|RANDOM|CLUSTERED|ZIPFIAN] [-CLUSTER_SIZE n]"
+                " [-SEED s] output.csv" << endl;
+        return -1;
+    }
+
+    for (int i = 1; i < argc - 1; i++) {
+        string arg = argv[i];
+        if (arg == "-ROWS" && i + 1 < argc - 1) {
+            rows = stoll(argv[++i]);
+        } else if (arg == "-DISTRIBUTION" && i + 1 < argc - 1) {
+            distribution = argv[++i];
+        } else if (arg == "-CLUSTER_SIZE" && i + 1 < argc - 1) {
+            clusterSize = max(1LL, stoll(argv[++i]));
+        } else if (arg == "-SEED" && i + 1 < argc - 1) {
+            seed = stoull(argv[++i]);
+        }
+    }
+
+    if (distribution != "SORTED" && distribution != "RANDOM" && distribution != "CLUSTERED" &&
+        distribution != "ZIPFIAN") {
+        cerr << "Error: -DISTRIBUTION must be SORTED, RANDOM, CLUSTERED or ZIPFIAN." << endl;
+        return -1;
+    }
+
+    // Keys are ints in the tree, and ZIPFIAN may widen its ranges by one key space each
+    long long maxRows = (INT32_MAX - 2LL * zipfRanges) / keySpacing;
+    if (rows <= 0 || rows > maxRows) {
+        cerr << "Error: -ROWS must be between 1 and " << maxRows << "." << endl;
+        return -1;
+    }
+
+    // For ZIPFIAN, range r takes a Zipfian share of the rows and is as wide as its rows, or as an even
+    // share of the key space when that is wider, so hot ranges are packed and cold ones sparse
+    vector<long long> rangeRows(zipfRanges), rangeFirstRow(zipfRanges + 1), rangeStart(zipfRanges + 1);
+    if (distribution == "ZIPFIAN") {
+        vector<double> weights(zipfRanges);
+        double total = 0;
+        for (int r = 0; r < zipfRanges; r++) {
+            // The hottest ranges are spread over the key space rather than sitting at its start
+            int rank = static_cast<int>(permute(r, zipfRanges, seed));
+            weights[r] = 1.0 / pow(rank + 1, 0.99);
+            total += weights[r];
+        }
+        long long assigned = 0;
+        for (int r = 0; r < zipfRanges; r++) {
+            rangeRows[r] = static_cast<long long>(rows * weights[r] / total);
+            assigned += rangeRows[r];
+        }
+        for (int r = 0; assigned < rows; r = (r + 1) % zipfRanges, assigned++) {
+            rangeRows[r]++;
+        }
+        long long evenWidth = rows * keySpacing / 2 / zipfRanges + 1;
+        for (int r = 0; r < zipfRanges; r++) {
+            rangeFirstRow[r + 1] = rangeFirstRow[r] + rangeRows[r];
+            rangeStart[r + 1] = rangeStart[r] + max(rangeRows[r], evenWidth);
+        }
+    }
+
+    ofstream out(argv[argc - 1], ios::binary);
+    if (!out) {
+        cerr << "Failed to open " << argv[argc - 1] << endl;
+        return -1;
+    }
+
+    string buffer = "ZipCode,PlaceName,State,County,Lat,Long\n";
+    long long clusters = (rows + clusterSize - 1) / clusterSize;
+
+    for (long long i = 0, cluster = 0, offset = 0; i < rows; i++) {
+        long long index = i;
+        if (distribution == "RANDOM" || distribution == "ZIPFIAN") {
+            index = static_cast<long long>(permute(i, rows, seed));
+        } else if (distribution == "CLUSTERED") {
+            // Walk the clusters in a random order, skipping the part of the last one past the rows
+            long long first;
+            while ((first = static_cast<long long>(permute(cluster, clusters, seed)) * clusterSize) + offset >= rows) {
+                cluster++;
+                offset = 0;
+            }
+            index = first + offset;
+            if (++offset == clusterSize) {
+                cluster++;
+                offset = 0;
+            }
+        }
+
+        long long key = 1 + index * keySpacing;
+        if (distribution == "ZIPFIAN") {
+            int r = static_cast<int>(upper_bound(rangeFirstRow.begin(), rangeFirstRow.end(), index) -
+                                     rangeFirstRow.begin()) - 1;
+            long long width = rangeStart[r + 1] - rangeStart[r];
+            key = 1 + rangeStart[r] + (index - rangeFirstRow[r]) * (width / rangeRows[r]);
+        }
+
+        appendRow(buffer, key, seed);
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+
+    if (!out) {
+        cerr << "Failed to write " << argv[argc - 1] << endl;
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Scrambles the bits of a number, the finalizer of splitmix64.
+ *
+ * @param value The number to scramble.
+ * @return The scrambled number.
+ */
+uint64_t mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+
+/**
+ * Maps an index to its place in a random ordering of 0 to size - 1, without storing the ordering.
+ * A Feistel network shuffles the smallest even number of bits covering size, and indexes it maps
+ * past the end are fed through again until they land inside.
+ *
+ * @param index The index to map, below size.
+ * @param size Number of indexes being ordered.
+ * @param seed Chooses the ordering.
+ * @return The mapped index, below size.
+ */
+uint64_t permute(uint64_t index, uint64_t size, uint64_t seed) {
+    int halfBits = 1;
+    while ((1ULL << (2 * halfBits)) < size) {
+        halfBits++;
+    }
+    uint64_t mask = (1ULL << halfBits) - 1;
+
+    do {
+        uint64_t left = index >> halfBits, right = index & mask;
+        for (int round = 0; round < 4; round++) {
+            uint64_t next = left ^ (mix(right ^ mix(seed + round)) & mask);
+            left = right;
+            right = next;
+        }
+        index = (left << halfBits) | right;
+    } while (index >= size);
+
+    return index;
+}
+
+
+/**
+ * Builds a capitalized name out of syllables.
+ *
+ * @param bits Random bits to choose with, used up as the name is built.
+ * @param minSyllables Fewest syllables in the name.
+ * @param maxSyllables Most syllables in the name.
+ * @return The name.
+ */
+string makeName(uint64_t &bits, int minSyllables, int maxSyllables) {
+    int count = minSyllables + static_cast<int>(bits % (maxSyllables - minSyllables + 1));
+    bits = mix(bits);
+
+    string name;
+    for (int i = 0; i < count; i++) {
+        name += syllables[bits % syllableCount];
+        bits = mix(bits);
+    }
+    name[0] = static_cast<char>(toupper(name[0]));
+    return name;
+}
+
+
+/**
+ * Appends one CSV row for a key, its fields chosen from the seed and the key alone.
+ *
+ * @param out String to append the row to.
+ * @param key The ZIP code of the row.
+ * @param seed Seed of the whole file.
+ */
+void appendRow(string &out, long long key, uint64_t seed) {
+    uint64_t bits = mix(seed ^ mix(static_cast<uint64_t>(key)));
+
+    // Neighboring keys mostly share a state, as real ZIP codes do
+    const StateArea &state = states[mix(seed ^ (static_cast<uint64_t>(key) >> 12)) % stateCount];
+    string placeName = makeName(bits, 2, 4);
+    string county = makeName(bits, 2, 3);
+
+    double lat = state.lat + ((bits & 0xFFFF) / 32767.5 - 1) * state.spread;
+    double lng = state.lng + (((bits >> 16) & 0xFFFF) / 32767.5 - 1) * state.spread;
+
+    char coordinates[48];
+    snprintf(coordinates, sizeof(coordinates), "%.4f,%.4f\n", lat, lng);
+
+    out += to_string(key);
+    out += ',';
+    out += placeName;
+    out += ',';
+    out += state.code;
+    out += ',';
+    out += county;
+    out += ',';
+    out += coordinates;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file Arena.cpp
+ * @brief Implementation file for the Arena class.
+ */
+
+#include "Arena.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+Arena::Scope::Scope() : arena(Arena::local()), chunkIndex(arena.chunkIndex), offset(arena.offset) {
+
+}
+
+Arena::Scope::~Scope() {
+    arena.chunkIndex = chunkIndex;
+    arena.offset = offset;
+}
+
+Arena &Arena::local() {
+    thread_local Arena arena;
+    return arena;
+}
+
+void *Arena::allocate(size_t bytes, size_t alignment) {
+    if (!chunks.empty()) {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start + bytes <= chunks[chunkIndex].size) {
+            offset = start + bytes;
+            return chunks[chunkIndex].data.get() + start;
+        }
+    }
+
+    // Move on to the next chunk, taking a new one from the heap if it is missing or too small
+    size_t next = chunks.empty() ? 0 : chunkIndex + 1;
+    if (next == chunks.size() || chunks[next].size < bytes) {
+        size_t size = max(chunkSize, bytes);
+        chunks.insert(chunks.begin() + next, Chunk{unique_ptr<char[]>(new char[size]), size});
+    }
+
+    // Chunks come from new, so their start is aligned for any type
+    chunkIndex = next;
+    offset = bytes;
+    return chunks[chunkIndex].data.get();
+}
+
+std::string_view Arena::copy(std::string_view text) {
+    char *data = static_cast<char *>(allocate(text.size(), 1));
+    memcpy(data, text.data(), text.size());
+    return string_view(data, text.size());
+}
@@ -0,0 +1,137 @@
+/**
+ * @file Arena.h
+ * @brief Header file for the Arena class.
+ */
+
+/**
+ * @class Arena
+ * @brief Scratch memory for the temporaries of one operation, handed out by bumping a pointer.
+ * @details: Every thread has an arena of its own. Memory is taken from the current chunk and is given
+ * back all at once when the Scope it was taken under ends, so freeing costs nothing and the chunks are
+ * kept for the next operation. Once the chunks have grown to what the largest operation needs, taking
+ * memory never calls the heap. Scopes nest, and an inner scope gives back only what was taken after it
+ * began, so memory must not be taken for an outer scope while an inner one is open.
+ * Includes: Taking memory, scopes that give it back, and an allocator so standard containers can use it.
+ * Assumes: Nothing taken under a scope is used after the scope ends.
+ */
+
+#ifndef CSCI331_PROJECT4_ARENA_H
+#define CSCI331_PROJECT4_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class Arena {
+public:
+    static const size_t chunkSize = 64 * 1024; /**< Bytes in a chunk, larger requests get a chunk of their own */
+
+    /**
+    * @class Scope
+    * @brief Gives back everything the thread took from its arena since the scope began when it ends.
+    */
+    class Scope {
+    public:
+        /**
+        * @brief Marks where the calling thread's arena is.
+        */
+        Scope();
+
+        /**
+        * @brief Returns the arena to the mark.
+        */
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Arena &arena;       /**< The arena of the thread that opened the scope */
+        size_t chunkIndex;  /**< Chunk in use when the scope began */
+        size_t offset;      /**< Bytes taken from that chunk when the scope began */
+    };
+
+    /**
+    * @brief Gets the arena of the calling thread.
+    * @return the arena
+    */
+    static Arena &local();
+
+    /**
+    * @brief Takes memory from the arena.
+    * @param bytes how many bytes to take
+    * @param alignment what the address must be a multiple of, a power of two
+    * @return the memory, valid until the innermost open scope ends
+    */
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    /**
+    * @brief Copies text into the arena.
+    * @param text the text to copy
+    * @return a view of the copy
+    */
+    std::string_view copy(std::string_view text);
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+private:
+    /**
+    * @brief A block of memory the arena hands out.
+    */
+    struct Chunk {
+        std::unique_ptr<char[]> data; /**< The memory */
+        size_t size;                  /**< Bytes in the chunk */
+    };
+
+    std::vector<Chunk> chunks;  /**< Every chunk taken from the heap, kept until the thread ends */
+    size_t chunkIndex = 0;      /**< Chunk memory is taken from */
+    size_t offset = 0;          /**< Bytes taken from that chunk */
+
+    Arena() = default;
+};
+
+/**
+ * @class ArenaAllocator
+ * @brief An allocator taking memory from the calling thread's arena, for containers used within a scope.
+ * @details: Deallocating does nothing, the memory comes back when the scope ends.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type; /**< Type of the elements allocated */
+
+    ArenaAllocator() = default;
+
+    /**
+    * @brief Converts from an allocator of another type, as containers do internally.
+    */
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &) {}
+
+    /**
+    * @brief Takes room for elements from the arena.
+    * @param count number of elements
+    * @return the memory for them
+    */
+    T *allocate(size_t count) {
+        return static_cast<T *>(Arena::local().allocate(count * sizeof(T), alignof(T)));
+    }
+
+    /**
+    * @brief Does nothing, the memory is given back when the scope ends.
+    */
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &) const { return true; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>; /**< A vector whose elements live in the arena */
+
+#endif //CSCI331_PROJECT4_ARENA_H
@@ -0,0 +1,180 @@
+/**
+ * @file BTreeBuilder.cpp
+ * @brief Implementation file for the BTreeBuilder class.
+ */
+
+#include "BTreeBuilder.h"
+
+using namespace std;
+
+BTreeBuilder::BTreeBuilder(ostream &stream, HeaderBuffer &hbuf, const BTreeNode &emptyNode, double fillFactor)
+    : stream(stream), headerBuffer(hbuf), emptyNode(emptyNode), fillFactor(fillFactor), leaf(emptyNode) {
+    leafCount = 0;
+    leafRecords = 0;
+    lastKey = -1;
+    height = 1;
+    rbnAvail = firstRBN;
+}
+
+int BTreeBuilder::add(RecordBuffer &recordBuffer) {
+    int key = recordBuffer.getRecordKey();
+    if (key <= lastKey) {
+        return -1;
+    }
+
+    // A leaf always takes its first record, after that only as many as the fill factor allows
+    bool full = leaf.insertRecord(recordBuffer) == -1 || !leaf.isSafeForInsert(0);
+    if (!full && (leafRecords == 0 || leaf.getFill() <= fillFactor)) {
+        leafRecords++;
+        lastKey = key;
+        return 0;
+    }
+    if (leafRecords == 0) {
+        return -1;
+    }
+
+    // The record starts the next leaf instead
+    leaf.removeRecord(recordBuffer);
+    if (writeLeaf(BTreeNode::shortestSeparator(lastKey, key)) == -1) {
+        return -1;
+    }
+    if (leaf.insertRecord(recordBuffer) == -1 || !leaf.isSafeForInsert(0)) {
+        return -1;
+    }
+
+    leafRecords = 1;
+    lastKey = key;
+    return 0;
+}
+
+int BTreeBuilder::finish() {
+    if (writeLeaf(-1) == -1) {
+        return -1;
+    }
+
+    height = 1;
+    while (children.size() > 1) {
+        if (buildLevel() == -1) {
+            return -1;
+        }
+        height++;
+    }
+
+    headerBuffer.rbnAvail = rbnAvail;
+    headerBuffer.blockCount = rbnAvail - 1;
+    headerBuffer.freeMapBlocks = 0;
+    headerBuffer.stale = "false";
+    if (headerBuffer.writeHeader(stream) == -1) {
+        return -1;
+    }
+
+    stream.flush();
+    return stream ? 0 : -1;
+}
+
+int BTreeBuilder::getLeafCount() const {
+    return leafCount;
+}
+
+int BTreeBuilder::getHeight() const {
+    return height;
+}
+
+int BTreeBuilder::writeLeaf(int separator) {
+    // The only leaf is the root
+    int RBN = separator == -1 && leafCount == 0 ? rootRBN : firstRBN + leafCount;
+
+    leaf.setPrevRBN(leafCount > 0 ? RBN - 1 : 0);
+    leaf.setNextRBN(separator != -1 ? RBN + 1 : 0);
+    leaf.setHighKey(separator);
+    if (writeNode(leaf, RBN) == -1) {
+        return -1;
+    }
+
+    if (RBN != rootRBN) {
+        children.push_back(RBN);
+        if (separator != -1) separators.push_back(separator);
+        rbnAvail = RBN + 1;
+    }
+
+    leafCount++;
+    leaf = emptyNode;
+    leafRecords = 0;
+    return 0;
+}
+
+int BTreeBuilder::buildLevel() {
+    vector<BTreeNode> nodes;
+    vector<int> nodeSeparators;
+
+    // Links are filled in once the level is laid out, until then they hold the widest values they can take
+    BTreeNode node = emptyNode;
+    node.setIsLeaf(false);
+    node.setNextRBN(rbnAvail + children.size());
+    node.setHighKey(separators.back());
+
+    size_t first = 0;
+    for (size_t i = 1; i < children.size(); i++) {
+        if (i == first + 1) {
+            node.insertKeyAndChildren(separators[i - 1], children[first], children[i]);
+            continue;
+        }
+
+        node.insertKeyAndChildren(separators[i - 1], children[i]);
+        bool last = i + 1 == children.size();
+        bool overFilled = node.isOverFilled();
+        if (!overFilled && (node.getFill() <= fillFactor || last)) {
+            continue;
+        }
+
+        // Child i starts the next node, or the child before it does so the last node has two children
+        size_t start = last ? i - 1 : i;
+        if (start < first + 2) {
+            return -1;
+        }
+        for (size_t j = i; j >= start; j--) {
+            node.removeKeyAndChildren(separators[j - 1], children[j]);
+        }
+
+        nodes.push_back(node);
+        nodeSeparators.push_back(separators[start - 1]);
+
+        node = emptyNode;
+        node.setIsLeaf(false);
+        node.setNextRBN(rbnAvail + children.size());
+        node.setHighKey(separators.back());
+        first = start;
+        i = start;
+    }
+    nodes.push_back(node);
+
+    // A level of one node is the root
+    vector<int> RBNs;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        RBNs.push_back(nodes.size() == 1 ? rootRBN : rbnAvail++);
+    }
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i].setNextRBN(i + 1 < nodes.size() ? RBNs[i + 1] : 0);
+        nodes[i].setHighKey(i < nodeSeparators.size() ? nodeSeparators[i] : -1);
+        if (writeNode(nodes[i], RBNs[i]) == -1) {
+            return -1;
+        }
+    }
+
+    children = RBNs;
+    separators = nodeSeparators;
+    return 0;
+}
+
+int BTreeBuilder::writeNode(BTreeNode &node, int RBN) {
+    if (node.isOverFilled()) {
+        return -1;
+    }
+
+    node.setCurRBN(RBN);
+    if (node.write(stream, headerBuffer.headerRecordSize, RBN) == -1 || !stream) {
+        return -1;
+    }
+    return 0;
+}
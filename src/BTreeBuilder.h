@@ -0,0 +1,102 @@
+/**
+ * @file BTreeBuilder.h
+ * @brief Header file for the BTreeBuilder class.
+ */
+
+/**
+ * @class BTreeBuilder
+ * @brief Writes a packed tree file from records given in key order.
+ * @details BTreeBuilder class: Builds a tree bottom up instead of inserting into one. Each leaf is filled
+ * to the fill factor before the next is started, and the leaves are written one after another from RBN 2,
+ * so the sequence set reads the file front to back. Once the last record is added, the index levels are
+ * built the same way over the leaves, each level after the one below it, and the single node on top is
+ * written to RBN 1 as the root.
+ * Includes: Adding records, finishing the file, counting the leaves and levels written.
+ * Assumes: Records are added in ascending key order, and the stream is a new, empty file.
+ */
+
+#ifndef CSCI331_PROJECT4_BTREEBUILDER_H
+#define CSCI331_PROJECT4_BTREEBUILDER_H
+
+#include <iostream>
+#include <vector>
+#include "BTreeNode.h"
+#include "HeaderBuffer.h"
+#include "RecordBuffer.h"
+
+class BTreeBuilder {
+public:
+    /**
+    * @brief Constructor for the tree builder.
+    * @param stream the new tree file
+    * @param hbuf the header of the new file, its block settings are used and its block counts are filled in
+    * @param emptyNode an empty leaf made with the file's block settings, copied for every node
+    * @param fillFactor how full to make each node, from above 0 up to 1
+    */
+    BTreeBuilder(std::ostream &stream, HeaderBuffer &hbuf, const BTreeNode &emptyNode, double fillFactor);
+
+    /**
+    * @brief Adds the next record to the sequence set, writing out the leaf before it once that is full.
+    * @param recordBuffer the record, whose key must be larger than every key added before it
+    * @return -1 if the record is out of order or could not be written, 0 otherwise
+    */
+    int add(RecordBuffer &recordBuffer);
+
+    /**
+    * @brief Writes the last leaf, the index levels above the leaves and the header.
+    * @return -1 if the file could not be written, 0 otherwise
+    */
+    int finish();
+
+    /**
+    * @brief Gets the number of leaves written.
+    * @return the leaf count
+    */
+    int getLeafCount() const;
+
+    /**
+    * @brief Gets the number of levels in the tree, counting the leaves.
+    * @return the height, only complete once finish has returned
+    */
+    int getHeight() const;
+
+private:
+    static const int rootRBN = 1;  /**< The root is always at the front of the file */
+    static const int firstRBN = 2; /**< The first block after the root */
+
+    std::ostream &stream;          /**< The new tree file */
+    HeaderBuffer &headerBuffer;    /**< The header of the new tree file */
+    BTreeNode emptyNode;           /**< Copied to start each node */
+    double fillFactor;             /**< How full each node is made */
+    BTreeNode leaf;                /**< The leaf being filled */
+    int leafCount;                 /**< Leaves written so far */
+    int leafRecords;               /**< Records in the leaf being filled */
+    int lastKey;                   /**< Key of the last record added, -1 before the first */
+    int height;                    /**< Levels built so far */
+    int rbnAvail;                  /**< The block after the last block written */
+    std::vector<int> children;     /**< Blocks of the level built last, in key order */
+    std::vector<int> separators;   /**< Separators between neighboring blocks in children */
+
+    /**
+    * @brief Writes the leaf being filled and starts the next one.
+    * @param separator the separator between the leaf and the next, -1 if it is the last leaf
+    * @return -1 if the leaf could not be written, 0 otherwise
+    */
+    int writeLeaf(int separator);
+
+    /**
+    * @brief Builds the index level over children, replacing children and separators with its nodes.
+    * @return -1 if a node could not be written, 0 otherwise
+    */
+    int buildLevel();
+
+    /**
+    * @brief Writes a node to a block.
+    * @param node the node
+    * @param RBN the block to write it to
+    * @return -1 if the node does not fit or could not be written, 0 otherwise
+    */
+    int writeNode(BTreeNode &node, int RBN);
+};
+
+#endif //CSCI331_PROJECT4_BTREEBUILDER_H
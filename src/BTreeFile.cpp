@@ -4,15 +4,20 @@
  */
 
 #include "BTreeFile.h"
+#include "BTreeBuilder.h"
+#include "BlockChecksum.h"
 #include "RecordBuffer.h"
+#include <algorithm>
+#include <filesystem>
 #include <string>
+#include <thread>
 #include <utility>
 using namespace std;
 
-BTreeFile::BTreeFile(HeaderBuffer &hbuf, int order) : headerBuffer(hbuf), root(nullptr) {
+BTreeFile::BTreeFile(HeaderBuffer &hbuf, int order, int cacheCapacity)
+    : headerBuffer(hbuf), pool(file, hbuf, order, cacheCapacity), freeSpace(hbuf) {
     this->order = order;
     this->height = 1;
-    this->root = new BTreeNode(order);
 }
 
 BTreeFile::~BTreeFile() {
@@ -25,13 +30,17 @@ bool BTreeFile::openFile(std::string &bTreeFileName) {
     file.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
 
     // If that fails, most likely means file does not exist, so create it and write header.
-    if (!file.is_open()) {
+    bool created = !file.is_open();
+    if (created) {
         file.open(filename.c_str(), std::ios::out | std::ios::binary);
         headerBuffer.fileType = "blocked sequence set with index";
         headerBuffer.writeHeader(file);
-        flushData();
+        file.close();
+        file.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
     } else {
-        headerBuffer.readHeader(file);
+        if (headerBuffer.readHeader(file) == -1 || freeSpace.read(file) == -1) {
+            return false;
+        }
     }
 
     // Move past the header
@@ -44,331 +53,1397 @@ bool BTreeFile::openFile(std::string &bTreeFileName) {
     }
 
     // Read root into memory
-    if (root->read(file, headerBuffer.headerRecordSize, 1) == -1) {
-        flushData();
+    Frame* frame = pool.fetch(rootRBN);
+    if (frame == nullptr) {
+        // A root that cannot be read, such as one failing its checksum, must not be taken for an empty file
+        if (!created && headerBuffer.rbnAvail > rootRBN + 1) {
+            return false;
+        }
+
         // If read fails assume empty file, so init with root
-        if (root->write(file, headerBuffer.headerRecordSize, 1) == -1)
-        {
+        frame = pool.create(rootRBN);
+        pool.unpin(frame, true);
+        return flushData();
+    }
+
+    // Walk the leftmost path to find the height
+    height = 1;
+    while (!frame->node.getIsLeaf()) {
+        Frame* child = pool.fetch(frame->node.getChildren()[0]);
+        pool.unpin(frame, false);
+        if (child == nullptr) {
             return false;
         }
+        frame = child;
+        height++;
     }
+    pool.unpin(frame, false);
 
     return true;
 }
 
 bool BTreeFile::closeFile() {
     if (file.is_open()) {
-        file.seekg(0, std::ios::end);
-        headerBuffer.blockCount = file.tellg() / headerBuffer.blockSize;
+        flushData();
+        pool.clear();
+        file.clear();
+
+        // The free space bitmap goes after the last block in use, anything past it is dropped
+        freeSpace.write(file);
+        headerBuffer.blockCount = headerBuffer.rbnAvail - 1 + headerBuffer.freeMapBlocks;
         headerBuffer.stale = "false";
         headerBuffer.writeHeader(file);
         file.close();
+
+        std::error_code error;
+        std::filesystem::resize_file(filename, headerBuffer.headerRecordSize +
+                                     static_cast<std::uintmax_t>(headerBuffer.blockCount) * headerBuffer.blockSize, error);
         return true;
     }
     return false;
 }
 
 int BTreeFile::insert(RecordBuffer& recordBuffer) {
-    int key = recordBuffer.getRecordKey();
-    BTreeNode* leaf = findLeafNode(key);
+    TreeStats::Timer timer(TreeStats::INSERT);
 
-    // If the leaf is too full
-    if (leaf->insertRecord(recordBuffer) == -1) {
-        BTreeNode* newLeaf = new BTreeNode(order);
-        leaf->split(newLeaf);
-        int largestKey = leaf->getLargestKey();
+    // Longer records would not read back from a block
+    if (recordBuffer.getView().getText().size() > BlockBuffer::maxRecordSize) return -1;
 
-        if (leaf == root) {
-            handleRootSplit(largestKey, leaf, newLeaf);
-        } else {
-            handleNonRootSplit(largestKey, leaf, newLeaf);
+    if (concurrencyMode == B_LINK) {
+        return insertBLink(recordBuffer);
+    }
+
+    int key = recordBuffer.getRecordKey();
+    int recordSize = recordBuffer.getBufferSize();
+    Arena::Scope scope; // The path is given back to the thread's arena when the operation ends
+    FramePath path;
+
+    // Crab down with exclusive latches, dropping ancestors once a node can absorb the insert
+    Frame* frame = pool.fetch(rootRBN);
+    if (frame == nullptr) return -1;
+    frame->latch.lock();
+    path.push_back(frame);
+
+    while (!frame->node.getIsLeaf()) {
+        Frame* child = pool.fetch(frame->node.getNextChild(key));
+        if (child == nullptr) {
+            releasePath(path, false);
+            return -1;
+        }
+        child->latch.lock();
+        if (child->node.isSafeForInsert(recordSize)) {
+            releasePath(path, false);
         }
+        path.push_back(child);
+        frame = child;
+    }
+
+    // If the leaf is too full
+    if (frame->node.insertRecord(recordBuffer) == -1) {
+        handleOverflow(path, recordSize);
     } else {
-        leaf->write(file, headerBuffer.headerRecordSize, leaf->getCurRBN());
+        path.pop_back();
+        releaseFrame(frame, true, true);
+        releasePath(path, false);
     }
 
-    return flushData();
+    return 0;
 }
 
 int BTreeFile::remove(RecordBuffer& recordBuffer) {
-    int key = recordBuffer.getRecordKey();
-    BTreeNode* leaf = findLeafNode(key);
-    BTreeNode* parent = findParentNode(leaf);
+    TreeStats::Timer timer(TreeStats::REMOVE);
 
-    int largestKey = leaf->getLargestKey();
-    int status = leaf->removeRecord(recordBuffer);
+    if (deleteMode == LAZY) {
+        return removeLazy(recordBuffer);
+    }
+    if (concurrencyMode == B_LINK) {
+        return removeBLink(recordBuffer);
+    }
+
+    int key = recordBuffer.getRecordKey();
+    int recordSize = recordBuffer.getBufferSize();
+    Arena::Scope scope; // The path is given back to the thread's arena when the operation ends
+    FramePath path;
+
+    // Crab down with exclusive latches, dropping ancestors once a node can absorb the remove
+    Frame* frame = pool.fetch(rootRBN);
+    if (frame == nullptr) return -1;
+    frame->latch.lock();
+    path.push_back(frame);
+
+    while (!frame->node.getIsLeaf()) {
+        Frame* child = pool.fetch(frame->node.getNextChild(key));
+        if (child == nullptr) {
+            releasePath(path, false);
+            return -1;
+        }
+        child->latch.lock();
+        if (child->node.isSafeForRemove(recordSize)) {
+            releasePath(path, false);
+        }
+        path.push_back(child);
+        frame = child;
+    }
 
-    // Update parent if largest key changed
-    int newLargestKey = leaf->getLargestKey();
-    if (newLargestKey != largestKey) {
-        parent->removeKeyAndChildren(largestKey, leaf->getCurRBN());
-        parent->insertKeyAndChildren(newLargestKey, leaf->getCurRBN());
+    RecordBuffer existing;
+    if (frame->node.retrieveRecord(existing, key) == -1) {
+        releasePath(path, false);
+        return -1;
     }
 
-    // If the leaf is under limit
-    if (status == -1) {
-        handleMerge(parent, leaf);
+    // Separators stay valid when keys leave a leaf, so only an underfilled leaf touches its parent
+    if (frame->node.removeRecord(recordBuffer) == -1 && frame->node.isUnderFilled()) {
+        handleMerge(path);
     } else {
-        leaf->write(file, headerBuffer.headerRecordSize, leaf->getCurRBN());
+        path.pop_back();
+        releaseFrame(frame, true, true);
+        releasePath(path, false);
     }
 
-    return flushData();
+    return 0;
 }
 
 int BTreeFile::search(RecordBuffer& recordBuffer, int key) {
-    BTreeNode * node = findLeafNode(key);
+    TreeStats::Timer timer(TreeStats::SEARCH);
+    Frame * frame = findLeafNode(key);
 
-    if (node == nullptr) {
+    if (frame == nullptr) {
+        return -1;
+    }
+
+    int status = frame->node.retrieveRecord(recordBuffer, key);
+    releaseFrame(frame, false, false);
+    if (status == -1 || recordBuffer.getBufferSize() <= headerBuffer.recordSizeDigits) {
         return -1;
-    } else {
-        node->retrieveRecord(recordBuffer, key);
-        if (recordBuffer.getBufferSize() <= headerBuffer.recordSizeDigits) {
-            return -1;
-        }
     }
 
     return 0;
 }
 
-void BTreeFile::displaySequenceSet(std::ostream &ostream) {
-    BlockBuffer blockBuffer;
-    RecordBuffer recordBuffer;
-    stringstream ss;
+int BTreeFile::rangeSearch(int lowKey, int highKey, vector<RecordBuffer>& results) {
+    int found = 0;
+
+    Frame * frame = findLeafNode(lowKey);
+    if (frame == nullptr) {
+        return -1;
+    }
 
+    while(frame != nullptr) {
+        TreeStats::Timer leafTimer(TreeStats::SCAN_LEAF);
+
+        // Records are read in place, only those in the range are copied out
+        bool pastRange = false;
+        frame->node.getBlockBuffer().forEachRecord([&](const RecordView &record) {
+            int key = record.getKey();
+            if (key > highKey) {
+                pastRange = true;
+                return false;
+            }
+            if (key >= lowKey && !record.isTombstone()) {
+                results.emplace_back();
+                results.back().assign(record.getText());
+                found++;
+            }
+            return true;
+        });
+
+        if (pastRange) {
+            releaseFrame(frame, false, false);
+            return found;
+        }
+        frame = nextLeafNode(frame);
+    }
+
+    return found;
+}
+
+void BTreeFile::displaySequenceSet(std::ostream &ostream) {
     // Get leftmost node
-    BTreeNode * node = findLeafNode(0);
-    int RBN = node->getCurRBN();
+    Frame * frame = findLeafNode(0);
 
-    while(RBN != 0) {
-        blockBuffer.read(file, headerBuffer.headerRecordSize, RBN);
+    while(frame != nullptr) {
+        TreeStats::Timer leafTimer(TreeStats::SCAN_LEAF);
+        BlockBuffer blockBuffer = frame->node.getBlockBuffer();
 
-        int currentBlock = blockBuffer.getCurRBN();
-        cout << "RELATIVE BLOCK NUMBER: " << currentBlock << endl;
+        ostream << "RELATIVE BLOCK NUMBER: " << frame->rbn << endl;
 
-        blockBuffer.write(ss, 0);
-        cout << ss.str();
+        blockBuffer.print(ostream);
+        ostream << endl;
 
-        ss.clear();
-        ss.str("");
-        RBN = blockBuffer.getNextRBN();
+        frame = nextLeafNode(frame);
     }
 }
 
 void BTreeFile::displayExtrema(ostream &ostream, std::string state) {
-    BlockBuffer blockBuffer;
-    RecordBuffer recordBuffer;
     StateDatabase stateDb;
 
     // Get leftmost node
-    BTreeNode * node = findLeafNode(0);
-    int RBN = node->getCurRBN();
+    Frame * frame = findLeafNode(0);
 
-    while(RBN != 0) {
-        blockBuffer.read(file, headerBuffer.headerRecordSize, RBN);
+    while(frame != nullptr) {
+        TreeStats::Timer leafTimer(TreeStats::SCAN_LEAF);
+        BlockBuffer blockBuffer = frame->node.getBlockBuffer();
 
-        while(blockBuffer.unpack(recordBuffer) != -1) {
-            Record record(recordBuffer);
-            stateDb.processRecord(record);
+        // Columnar blocks are aggregated from their State and coordinate columns alone
+        LeafColumns columns;
+        if (blockBuffer.getColumns(columns) != -1 && stateDb.processColumns(columns)) {
+            frame = nextLeafNode(frame);
+            continue;
         }
 
-        RBN = blockBuffer.getNextRBN();
+        blockBuffer.forEachRecord([&stateDb](const RecordView &record) {
+            if (record.isTombstone()) return true;
+            stateDb.processLocation(record.getState(), record.getZipCode(), record.getLat(), record.getLong());
+            return true;
+        });
+
+        frame = nextLeafNode(frame);
     }
 
-    stateDb.printStateInfo(std::move(state));
+    stateDb.printStateInfo(ostream, std::move(state));
 }
 
 void BTreeFile::displayTree(ostream &ostream) {
-    displayNode(root, ostream, 0, "");
+    Frame* frame = pool.fetch(rootRBN);
+    if (frame != nullptr) {
+        displayNode(frame, ostream, 0, "");
+    }
+}
+
+int BTreeFile::getHeight() {
+    return height;
+}
+
+void BTreeFile::setConcurrencyMode(ConcurrencyMode mode) {
+    concurrencyMode = mode;
+}
+
+BTreeFile::ConcurrencyMode BTreeFile::getConcurrencyMode() {
+    return concurrencyMode;
+}
+
+void BTreeFile::setSplitMode(SplitMode mode) {
+    splitMode = mode;
+}
+
+BTreeFile::SplitMode BTreeFile::getSplitMode() {
+    return splitMode;
+}
+
+void BTreeFile::setDeleteMode(DeleteMode mode) {
+    deleteMode = mode;
 }
 
+BTreeFile::DeleteMode BTreeFile::getDeleteMode() {
+    return deleteMode;
+}
+
+void BTreeFile::setTombstoneThreshold(int threshold) {
+    tombstoneThreshold = threshold;
+}
+
+int BTreeFile::purgeStep(int maxLeaves, int &purged) {
+    lock_guard<mutex> lock(purgeMutex);
+    return purgeLeaves(maxLeaves, purged);
+}
+
+int BTreeFile::insertBLink(RecordBuffer& recordBuffer) {
+    int key = recordBuffer.getRecordKey();
+
+    Frame* frame = descendToLevel(key, 0, true);
+    if (frame == nullptr) return -1;
 
-void BTreeFile::handleRootSplit(int largestKey, BTreeNode* leaf, BTreeNode* newLeaf) {
-    // If the split node was the root, we need to create a new root
-    BTreeNode* newRoot = new BTreeNode(order);
-    newRoot->insertKeyAndChildren(largestKey, headerBuffer.rbnAvail, headerBuffer.rbnAvail+1);
+    if (frame->node.insertRecord(recordBuffer) == -1) {
+        handleBLinkSplit(frame, 0);
+    } else {
+        releaseFrame(frame, true, true);
+    }
+
+    return 0;
+}
 
-    leaf->setNextRBN(headerBuffer.rbnAvail + 1);
-    leaf->write(file, headerBuffer.headerRecordSize, headerBuffer.rbnAvail);
-    headerBuffer.rbnAvail++;
+int BTreeFile::removeLazy(RecordBuffer& recordBuffer) {
+    int key = recordBuffer.getRecordKey();
 
-    newLeaf->setPrevRBN(leaf->getCurRBN());
-    newLeaf->write(file, headerBuffer.headerRecordSize, headerBuffer.rbnAvail);
-    headerBuffer.rbnAvail++;
+    Frame* frame = findLeafNode(key, true);
+    if (frame == nullptr) return -1;
+
+    // The leaf only shrinks, so nothing above it changes
+    if (frame->node.markDeleted(key) == -1) {
+        releaseFrame(frame, true, false);
+        return -1;
+    }
+    releaseFrame(frame, true, true);
+
+    if (tombstoneThreshold > 0 && ++tombstones >= tombstoneThreshold) {
+        // Whoever gets the purge going runs a whole pass, the others carry on deleting
+        unique_lock<mutex> lock(purgeMutex, try_to_lock);
+        if (lock.owns_lock()) {
+            int purged;
+            purgeKey = 0;
+            while (purgeLeaves(purgeBatch, purged) > 0) {
+            }
+        }
+    }
 
-    root = newRoot;
-    root->setIsLeaf(false);
-    root->write(file, headerBuffer.headerRecordSize, 1);
+    return 0;
+}
+
+int BTreeFile::purgeLeaves(int maxLeaves, int &purged) {
+    purged = 0;
+
+    // Note the leaves holding tombstones under shared latches, so scans are not held up
+    vector<int> keys;
+    bool passDone = false;
+    Frame* frame = findLeafNode(purgeKey);
+    if (frame == nullptr) return -1;
+    for (int visited = 0; frame != nullptr && visited < maxLeaves; visited++) {
+        if (frame->node.getTombstoneBytes() > 0) {
+            keys.push_back(frame->node.getLargestKey());
+        }
+
+        // Blocks written before high keys were kept carry on from past their largest key
+        int highKey = frame->node.getHighKey();
+        passDone = frame->node.getNextRBN() == 0;
+        purgeKey = passDone ? 0 : (highKey != -1 ? highKey : frame->node.getLargestKey()) + 1;
+        if (passDone || visited + 1 == maxLeaves) {
+            releaseFrame(frame, false, false);
+            frame = nullptr;
+        } else {
+            frame = nextLeafNode(frame);
+        }
+    }
+
+    for (int key : keys) {
+        int count = purgeLeaf(key);
+        if (count == -1) return -1;
+        purged += count;
+        tombstones -= count;
+    }
+
+    if (passDone) {
+        tombstones = 0;
+        return 0;
+    }
+    return 1;
+}
+
+int BTreeFile::purgeLeaf(int key) {
+    if (concurrencyMode == B_LINK) {
+        // Nodes are never freed in this mode, so the leaf is only compacted
+        Frame* frame = descendToLevel(key, 0, true);
+        if (frame == nullptr) return -1;
+        int count = frame->node.purgeTombstones();
+        releaseFrame(frame, true, count > 0);
+        return count;
+    }
+
+    Arena::Scope scope; // The path is given back to the thread's arena when the operation ends
+    FramePath path;
+
+    // Crab down as remove does, the leaf is safe if it stays above minimum capacity without its tombstones
+    Frame* frame = pool.fetch(rootRBN);
+    if (frame == nullptr) return -1;
+    frame->latch.lock();
+    path.push_back(frame);
+
+    while (!frame->node.getIsLeaf()) {
+        Frame* child = pool.fetch(frame->node.getNextChild(key));
+        if (child == nullptr) {
+            releasePath(path, false);
+            return -1;
+        }
+        child->latch.lock();
+        if (child->node.isSafeForRemove(child->node.getTombstoneBytes())) {
+            releasePath(path, false);
+        }
+        path.push_back(child);
+        frame = child;
+    }
+
+    int count = frame->node.purgeTombstones();
+    if (count > 0 && frame->node.isUnderFilled()) {
+        handleMerge(path);
+    } else {
+        path.pop_back();
+        releaseFrame(frame, true, count > 0);
+        releasePath(path, false);
+    }
+
+    return count;
+}
+
+int BTreeFile::removeBLink(RecordBuffer& recordBuffer) {
+    int key = recordBuffer.getRecordKey();
+
+    Frame* frame = descendToLevel(key, 0, true);
+    if (frame == nullptr) return -1;
+
+    RecordBuffer existing;
+    if (frame->node.retrieveRecord(existing, key) == -1) {
+        releaseFrame(frame, true, false);
+        return -1;
+    }
+
+    // Nodes are never freed in this mode, so an underfilled leaf simply stays underfilled
+    frame->node.removeRecord(recordBuffer);
+    releaseFrame(frame, true, true);
+    return 0;
+}
+
+
+void BTreeFile::handleRootSplit(int separator, Frame* rootFrame, BTreeNode* newNode) {
+    TreeStats::add(TreeStats::ROOT_SPLITS);
+
+    // The root stays in its block, so move both halves into new blocks below it
+    int leftRBN = allocateRBN(rootRBN);
+    int rightRBN = allocateRBN(leftRBN);
+    Frame* left = pool.create(leftRBN);
+    Frame* right = pool.create(rightRBN);
+
+    left->node = rootFrame->node;
+    left->node.setCurRBN(leftRBN);
+    right->node = *newNode;
+    right->node.setCurRBN(rightRBN);
+
+    // The two halves are the only nodes on their level
+    left->node.setNextRBN(rightRBN);
+    left->node.setHighKey(separator);
+    right->node.setNextRBN(0);
+    right->node.setHighKey(-1);
+    if (left->node.getIsLeaf()) {
+        left->node.setPrevRBN(0);
+        right->node.setPrevRBN(leftRBN);
+    }
+
+    pool.unpin(left, true);
+    pool.unpin(right, true);
+
+    BTreeNode newRoot = makeNode();
+    newRoot.setIsLeaf(false);
+    newRoot.insertKeyAndChildren(separator, leftRBN, rightRBN);
+    newRoot.setCurRBN(rootRBN);
+    rootFrame->node = newRoot;
     height++;
 }
 
-void BTreeFile::handleNonRootSplit(int largestKey, BTreeNode* leaf, BTreeNode* newLeaf) {
-    BTreeNode* parent = findParentNode(leaf);
-    if (parent == nullptr) {
-        handleRootSplit(largestKey, leaf, newLeaf);
+void BTreeFile::handleNonRootSplit(int separator, FramePath& path, BTreeNode* newNode) {
+    Frame* frame = path.back();
+    path.pop_back();
+    Frame* parent = path.back();
+
+    int newRBN = linkNewNode(frame, newNode);
+    releaseFrame(frame, true, true);
+
+    // Insert key pair into parent
+    parent->node.insertKeyAndChildren(separator, newRBN);
+
+    // Check if the parent is overfull and handle splitting recursively
+    if (parent->node.isOverFilled()) {
+        handleOverflow(path, 0);
+    } else {
+        path.pop_back();
+        releaseFrame(parent, true, true);
+        releasePath(path, false);
+    }
+}
+
+void BTreeFile::handleMerge(FramePath& path) {
+    Frame* frame = path.back();
+    path.pop_back();
+
+    if (path.empty()) {
+        releaseFrame(frame, true, true);
         return;
     }
 
-    // Write both child nodes and insert key pair into parent
-    parent->insertKeyAndChildren(largestKey, headerBuffer.rbnAvail);
+    Frame* parent = path.back();
+    bool onRight = false;
+    int separator = -1;
+    Frame* sibling = latchSibling(parent, frame, onRight, separator);
+    Frame* left = onRight ? frame : sibling;
+    Frame* right = onRight ? sibling : frame;
+
+    bool merged = false;
+    bool redistributed = false;
+    vector<int> freedRBNs;
+    if (left != nullptr && right != nullptr && left->node.canMerge(&right->node, separator)) {
+        left->node.merge(&right->node, separator);
+
+        int nextRBN = right->node.getNextRBN();
+        left->node.setNextRBN(nextRBN);
+        if (left->node.getIsLeaf()) {
+            if (nextRBN != 0) {
+                Frame* next = pool.fetch(nextRBN);
+                if (next != nullptr) {
+                    next->latch.lock();
+                    next->node.setPrevRBN(left->rbn);
+                    releaseFrame(next, true, true);
+                }
+            }
+        }
 
-    // Write the split leaf
-    newLeaf->setNextRBN(leaf->getNextRBN());
-    leaf->setNextRBN(headerBuffer.rbnAvail);
-    leaf->write(file, headerBuffer.headerRecordSize, leaf->getCurRBN());
+        // The right block is no longer referenced, leave it empty for reuse
+        parent->node.removeKeyAndChildren(separator, right->rbn);
+        right->node = makeNode();
+        right->node.setCurRBN(right->rbn);
+        freedRBNs.push_back(right->rbn);
+        merged = true;
+        TreeStats::add(TreeStats::MERGES);
+
+        // A root left with a single child is replaced by that child
+        if (parent->rbn == rootRBN && parent->node.getKeys().empty()) {
+            parent->node = left->node;
+            parent->node.setCurRBN(rootRBN);
+            left->node = makeNode();
+            left->node.setCurRBN(left->rbn);
+            freedRBNs.push_back(left->rbn);
+            height--;
+        }
+    } else if (left != nullptr && right != nullptr) {
+        // Too much for one node, so the two share it instead
+        redistributed = redistributeSiblings(parent, left, right, separator, -1);
+    }
 
-    // Write the new leaf
-    newLeaf->setPrevRBN(leaf->getCurRBN());
-    newLeaf->write(file, headerBuffer.headerRecordSize, headerBuffer.rbnAvail);
-    headerBuffer.rbnAvail++;
+    if (left != nullptr) releaseFrame(left, true, merged || redistributed || left == frame);
+    if (right != nullptr) releaseFrame(right, true, merged || redistributed || right == frame);
+    if (left != frame && right != frame) releaseFrame(frame, true, true);
 
-    // Set the prev RBN of the next node of new node
-    if (newLeaf->getNextRBN() != 0) {
-        BTreeNode * nextOfNewLeaf = new BTreeNode(order);
-        nextOfNewLeaf->read(file, headerBuffer.headerRecordSize, newLeaf->getNextRBN());
-        nextOfNewLeaf->setPrevRBN(newLeaf->getCurRBN());
-        nextOfNewLeaf->write(file, headerBuffer.headerRecordSize, nextOfNewLeaf->getCurRBN());
+    // Only hand the emptied blocks out again once nothing here holds them
+    for (int RBN : freedRBNs) {
+        freeRBN(RBN);
     }
 
-    // Check if the parent is overfull and handle splitting recursively
-    if (parent->isOverFilled()) {
-        BTreeNode* newParentNode = new BTreeNode(order);
-        newParentNode->setIsLeaf(false);
-        int parentSplitKey = parent->split(newParentNode);
+    if (merged && parent->rbn != rootRBN && parent->node.isUnderFilled()) {
+        handleMerge(path);
+    } else {
+        path.pop_back();
+        releaseFrame(parent, true, merged || redistributed);
+        releasePath(path, false);
+    }
+}
+
+void BTreeFile::handleOverflow(FramePath& path, int recordSize) {
+    Frame* frame = path.back();
+
+    if (frame->rbn != rootRBN) {
+        Frame* parent = path[path.size() - 2];
+        bool onRight = false;
+        int separator = -1;
+        Frame* sibling = latchSibling(parent, frame, onRight, separator);
+
+        if (sibling != nullptr) {
+            Frame* left = onRight ? frame : sibling;
+            Frame* right = onRight ? sibling : frame;
+
+            // A sibling with room takes some of the entries, and the parent only gets a new separator
+            if (redistributeSiblings(parent, left, right, separator, recordSize)) {
+                releaseFrame(sibling, true, true);
+                path.pop_back();
+                releaseFrame(frame, true, true);
+                path.pop_back();
+                releaseFrame(parent, true, true);
+                releasePath(path, false);
+                return;
+            }
+
+            if (splitMode == TWO_TO_THREE && splitThreeWays(path, left, right, separator)) {
+                return;
+            }
+            releaseFrame(sibling, true, false);
+        }
+    }
+
+    BTreeNode newNode = makeNode();
+    int separator = frame->node.split(&newNode);
 
-        handleNonRootSplit(parentSplitKey, parent, newParentNode);
+    if (frame->rbn == rootRBN) {
+        handleRootSplit(separator, frame, &newNode);
+        releasePath(path, true);
     } else {
-        parent->write(file, headerBuffer.headerRecordSize, parent->getCurRBN());
+        handleNonRootSplit(separator, path, &newNode);
     }
 }
 
-void BTreeFile::handleMerge(BTreeNode* parent, BTreeNode *leaf) {
-    if (parent == nullptr) {
-        return;
+Frame* BTreeFile::latchSibling(Frame* parent, Frame* frame, bool &onRight, int &separator) {
+    vector<int> children = parent->node.getChildren();
+    vector<int> keys = parent->node.getKeys();
+    int index = std::find(children.begin(), children.end(), frame->rbn) - children.begin();
+
+    Frame* sibling = nullptr;
+    if (index + 1 < children.size()) {
+        // Latching rightward matches the order of sequence set scans
+        sibling = pool.fetch(children[index + 1]);
+        if (sibling != nullptr) sibling->latch.lock();
+        onRight = true;
+        separator = keys[index];
+    } else if (index > 0) {
+        // Latching leftward could deadlock with a scan, so give up if the sibling is busy
+        sibling = pool.fetch(children[index - 1]);
+        if (sibling != nullptr && !sibling->latch.try_lock()) {
+            pool.unpin(sibling, false);
+            sibling = nullptr;
+        }
+        onRight = false;
+        separator = keys[index - 1];
     }
 
-    int prevRBN = leaf->getPrevRBN();
-    int nextRBN = leaf->getNextRBN();
-    int curRBN = leaf->getCurRBN();
-    BTreeNode * prevLeaf = new BTreeNode(order);
-    BTreeNode * nextLeaf = new BTreeNode(order);
+    return sibling;
+}
 
-    if (prevRBN != 0) {
-        prevLeaf->read(file, headerBuffer.headerRecordSize, prevRBN);
+bool BTreeFile::redistributeSiblings(Frame* parent, Frame* left, Frame* right, int separator, int recordSize) {
+    // Copies to put back if sharing leaves either node no better off
+    BTreeNode leftNode = left->node;
+    BTreeNode rightNode = right->node;
+    int newSeparator = left->node.redistribute(&right->node, separator);
+
+    bool balanced = !left->node.isOverFilled() && !right->node.isOverFilled();
+    if (recordSize == -1) {
+        balanced = balanced && !left->node.isUnderFilled() && !right->node.isUnderFilled();
+    } else {
+        balanced = balanced && left->node.isSafeForInsert(recordSize) && right->node.isSafeForInsert(recordSize);
     }
 
+    // The parent may not have room for a longer separator
+    if (balanced && newSeparator != separator) {
+        parent->node.replaceKey(separator, newSeparator);
+        if (parent->node.isOverFilled()) {
+            parent->node.replaceKey(newSeparator, separator);
+            balanced = false;
+        }
+    }
+
+    if (!balanced) {
+        left->node = leftNode;
+        right->node = rightNode;
+    } else {
+        TreeStats::add(TreeStats::REDISTRIBUTIONS);
+    }
+    return balanced;
+}
+
+bool BTreeFile::splitThreeWays(FramePath& path, Frame* left, Frame* right, int separator) {
+    Frame* frame = path.back();
+    Frame* parent = path[path.size() - 2];
+
+    // Splitting the parent in turn needs the node above it, unless it is the root
+    bool parentCanSplit = parent->rbn == rootRBN || path.size() > 2;
+    BTreeNode leftNode = left->node;
+    BTreeNode rightNode = right->node;
+    BTreeNode newNode = makeNode();
+    int newSeparator;
+    int firstSeparator = left->node.splitThree(&right->node, &newNode, separator, newSeparator);
+
+    if (!parentCanSplit) {
+        BTreeNode parentNode = parent->node;
+        parentNode.replaceKey(separator, firstSeparator);
+        parentNode.insertKeyAndChildren(newSeparator, headerBuffer.rbnAvail);
+        if (parentNode.isOverFilled()) {
+            left->node = leftNode;
+            right->node = rightNode;
+            return false;
+        }
+    }
+
+    TreeStats::add(TreeStats::THREE_WAY_SPLITS);
+    int newRBN = linkNewNode(right, &newNode);
+    releaseFrame(left == frame ? right : left, true, true);
+    path.pop_back();
+    releaseFrame(frame, true, true);
+
+    parent->node.replaceKey(separator, firstSeparator);
+    parent->node.insertKeyAndChildren(newSeparator, newRBN);
+
+    if (parent->node.isOverFilled()) {
+        handleOverflow(path, 0);
+    } else {
+        path.pop_back();
+        releaseFrame(parent, true, true);
+        releasePath(path, false);
+    }
+    return true;
+}
+
+Frame* BTreeFile::findLeafNode(int key, bool exclusive) {
+    if (concurrencyMode == B_LINK) {
+        return descendToLevel(key, 0, exclusive);
+    }
+
+    while (true) {
+        Frame * frame = pool.fetch(rootRBN);
+        if (frame == nullptr) return nullptr;
+
+        // The height only changes while the root is latched exclusive, so check it under the latch
+        bool frameExclusive = exclusive && height == 1;
+        latchFrame(frame, frameExclusive);
+        int level = height - 1;
+        if (exclusive && (level == 0) != frameExclusive) {
+            releaseFrame(frame, frameExclusive, false);
+            TreeStats::add(TreeStats::REDESCENTS);
+            continue;
+        }
+
+        while (!frame->node.getIsLeaf()) {
+            // read node from child key, latching it before letting go of the parent
+            level--;
+            bool childExclusive = exclusive && level == 0;
+            Frame * child = pool.fetch(frame->node.getNextChild(key));
+            if (child != nullptr) latchFrame(child, childExclusive);
+            releaseFrame(frame, false, false);
+            if (child == nullptr) return nullptr;
+            frame = child;
+        }
+
+        return frame;
+    }
+}
+
+Frame* BTreeFile::nextLeafNode(Frame* leaf) {
+    int nextRBN = leaf->node.getNextRBN();
+    Frame* next = nullptr;
+
     if (nextRBN != 0) {
-        nextLeaf->read(file, headerBuffer.headerRecordSize, nextRBN);
-    }
-
-    if (prevRBN != 0 && prevLeaf->isUnderFilled()) {
-        int largestKey = prevLeaf->getLargestKey();
-        parent->removeKeyAndChildren(largestKey, leaf->getCurRBN());
-        prevLeaf->merge(leaf);
-
-        // Update metadata
-        nextLeaf->setNextRBN(leaf->getNextRBN());
-        leaf->setPrevRBN(0);
-        leaf->setNextRBN(headerBuffer.rbnAvail);
-        headerBuffer.rbnAvail = leaf->getCurRBN();
-
-        // Write old block (now empty)
-        leaf->write(file, headerBuffer.headerRecordSize, curRBN);
-        // Write merged block
-        prevLeaf->write(file, headerBuffer.headerRecordSize, prevRBN);
-        // Write parent
-        parent->write(file, headerBuffer.headerRecordSize, parent->getCurRBN());
-
-    } else if (nextRBN != 0 && nextLeaf->isUnderFilled()) {
-        int largestKey = leaf->getLargestKey();
-        parent->removeKeyAndChildren(largestKey, nextLeaf->getCurRBN());
-        leaf->merge(nextLeaf);
-
-        // Update metadata
-        leaf->setNextRBN(nextLeaf->getNextRBN());
-        nextLeaf->setPrevRBN(0);
-        nextLeaf->setNextRBN(headerBuffer.rbnAvail);
-        headerBuffer.rbnAvail = nextLeaf->getCurRBN();
-
-        // Write merged block
-        leaf->write(file, headerBuffer.headerRecordSize, curRBN);
-        // Write old block (now empty)
-        nextLeaf->write(file, headerBuffer.headerRecordSize, nextRBN);
-        // Write parent
-        parent->write(file, headerBuffer.headerRecordSize, parent->getCurRBN());
+        next = pool.fetch(nextRBN);
+        if (next != nullptr) next->latch.lock_shared();
+    }
+
+    releaseFrame(leaf, false, false);
+    return next;
+}
+
+void BTreeFile::handleBLinkSplit(Frame* frame, int level) {
+    // Split one node at a time and let go of it before latching the parent, so a writer
+    // never holds more than the node it is changing. Readers that reach the left half in
+    // between follow its right link to the new node.
+    while (true) {
+        BTreeNode sibling = makeNode();
+        int separator = frame->node.split(&sibling);
+
+        if (frame->rbn == rootRBN) {
+            handleRootSplit(separator, frame, &sibling);
+            releaseFrame(frame, true, true);
+            return;
+        }
+
+        int newRBN = linkNewNode(frame, &sibling);
+        releaseFrame(frame, true, true);
+
+        // Find the parent again, it may have split or moved below a new root meanwhile
+        level++;
+        TreeStats::add(TreeStats::REDESCENTS);
+        frame = descendToLevel(separator, level, true);
+        if (frame == nullptr) return;
+
+        frame->node.insertKeyAndChildren(separator, newRBN);
+        if (!frame->node.isOverFilled()) {
+            releaseFrame(frame, true, true);
+            return;
+        }
+    }
+}
+
+Frame* BTreeFile::descendToLevel(int key, int level, bool exclusive) {
+    while (true) {
+        Frame* frame = pool.fetch(rootRBN);
+        if (frame == nullptr) return nullptr;
+
+        // The height only changes while the root is latched exclusive, so check it under the latch
+        bool frameExclusive = exclusive && height - 1 == level;
+        latchFrame(frame, frameExclusive);
+        int currentLevel = height - 1;
+        if (exclusive && (currentLevel == level) != frameExclusive) {
+            releaseFrame(frame, frameExclusive, false);
+            TreeStats::add(TreeStats::REDESCENTS);
+            continue;
+        }
+
+        while (currentLevel > level) {
+            frame = moveRight(frame, key, false);
+            if (frame == nullptr) return nullptr;
+
+            // Only one latch is held at a time, a split in between is repaired by moving right
+            int childRBN = frame->node.getNextChild(key);
+            releaseFrame(frame, false, false);
+            currentLevel--;
+
+            frame = pool.fetch(childRBN);
+            if (frame == nullptr) return nullptr;
+            frameExclusive = exclusive && currentLevel == level;
+            latchFrame(frame, frameExclusive);
+        }
+
+        return moveRight(frame, key, frameExclusive);
+    }
+}
+
+Frame* BTreeFile::moveRight(Frame* frame, int key, bool exclusive) {
+    while (frame->node.isBeyondHighKey(key)) {
+        TreeStats::add(TreeStats::LINK_CHASES);
+        int nextRBN = frame->node.getNextRBN();
+        releaseFrame(frame, exclusive, false);
+
+        frame = pool.fetch(nextRBN);
+        if (frame == nullptr) return nullptr;
+        latchFrame(frame, exclusive);
+    }
+
+    return frame;
+}
+
+int BTreeFile::linkNewNode(Frame* frame, BTreeNode* newNode) {
+    int newRBN = allocateRBN(frame->rbn);
+    Frame* newFrame = pool.create(newRBN);
+    newFrame->node = *newNode;
+    newFrame->node.setCurRBN(newRBN);
+
+    // Link the new node in as the right sibling of the split node
+    int nextRBN = frame->node.getNextRBN();
+    newFrame->node.setNextRBN(nextRBN);
+    frame->node.setNextRBN(newRBN);
+
+    if (frame->node.getIsLeaf()) {
+        newFrame->node.setPrevRBN(frame->rbn);
+
+        // Set the prev RBN of the next node of new node
+        if (nextRBN != 0) {
+            Frame* next = pool.fetch(nextRBN);
+            if (next != nullptr) {
+                next->latch.lock();
+                next->node.setPrevRBN(newRBN);
+                releaseFrame(next, true, true);
+            }
+        }
+    }
+
+    pool.unpin(newFrame, true);
+    return newRBN;
+}
+
+void BTreeFile::latchFrame(Frame* frame, bool exclusive) {
+    if (exclusive) {
+        frame->latch.lock();
     } else {
-        leaf->write(file, headerBuffer.headerRecordSize, curRBN);
-        parent->write(file, headerBuffer.headerRecordSize, parent->getCurRBN());
+        frame->latch.lock_shared();
+    }
+}
+
+void BTreeFile::releaseFrame(Frame* frame, bool exclusive, bool dirty) {
+    if (exclusive) {
+        frame->latch.unlock();
+    } else {
+        frame->latch.unlock_shared();
+    }
+    pool.unpin(frame, dirty);
+}
+
+void BTreeFile::releasePath(FramePath& path, bool dirty) {
+    for (Frame* frame : path) {
+        releaseFrame(frame, true, dirty);
+    }
+    path.clear();
+}
+
+int BTreeFile::defragmentStep(int maxLeaves, int &moved) {
+    moved = 0;
+    if (concurrencyMode == B_LINK) {
+        return -1;
+    }
+    maxLeaves = max(maxLeaves, 1);
+
+    if (defragPosition == -1) {
+        return planDefragment(maxLeaves);
+    }
+    return placeLeaves(maxLeaves, moved);
+}
+
+int BTreeFile::planDefragment(int maxLeaves) {
+    Frame* frame;
+    if (defragSlots.empty()) {
+        frame = findLeafNode(0);
+    } else {
+        frame = pool.fetch(defragScanRBN);
+        if (frame != nullptr) frame->latch.lock_shared();
+    }
+    if (frame == nullptr) {
+        resetDefragment();
+        return -1;
+    }
+
+    for (int visited = 0; ; visited++) {
+        // A leaf merged away since the last step may have become anything, so start over
+        if (!frame->node.getIsLeaf() || static_cast<int>(defragSlots.size()) >= headerBuffer.rbnAvail) {
+            releaseFrame(frame, false, false);
+            resetDefragment();
+            return 1;
+        }
+        if (visited == maxLeaves) {
+            defragScanRBN = frame->rbn;
+            releaseFrame(frame, false, false);
+            return 1;
+        }
+
+        defragSlots.push_back(frame->rbn);
+        if (frame->node.getNextRBN() == 0) {
+            releaseFrame(frame, false, false);
+            break;
+        }
+
+        frame = nextLeafNode(frame);
+        if (frame == nullptr) {
+            resetDefragment();
+            return -1;
+        }
+    }
+
+    // The leaves keep the blocks they already use, lowest first
+    std::sort(defragSlots.begin(), defragSlots.end());
+    defragPosition = 0;
+    defragPlacedRBN = 0;
+    return defragSlots.size();
+}
+
+int BTreeFile::placeLeaves(int maxLeaves, int &moved) {
+    map<int, Frame*> latched;
+    set<int> modified;
+
+    // With the root held no operation can start, and any still running below it is waited out by backing off
+    Frame* root = pool.fetch(rootRBN);
+    if (root == nullptr) return -1;
+    root->latch.lock();
+    latched[root->rbn] = root;
+
+    int result = 1;
+    for (int visited = 0; visited < maxLeaves; visited++) {
+        if (root->node.getIsLeaf() || defragPosition >= static_cast<int>(defragSlots.size())) {
+            result = 0;
+            break;
+        }
+
+        // Find the leaf after the last one placed
+        int currentRBN;
+        if (defragPosition == 0) {
+            Frame* frame = root;
+            while (frame != nullptr && !frame->node.getIsLeaf()) {
+                frame = tryLatch(frame->node.getChildren()[0], latched);
+            }
+            if (frame == nullptr) break;
+            currentRBN = frame->rbn;
+        } else {
+            Frame* placed = tryLatch(defragPlacedRBN, latched);
+            if (placed == nullptr) break;
+            if (!placed->node.getIsLeaf()) {
+                resetDefragment();
+                break;
+            }
+            currentRBN = placed->node.getNextRBN();
+        }
+        if (currentRBN == 0) {
+            result = 0;
+            break;
+        }
+
+        int targetRBN = defragSlots[defragPosition];
+        if (currentRBN != targetRBN) {
+            int status = swapLeaves(currentRBN, targetRBN, latched, modified);
+            if (status == -1) break;
+            if (status == -2) {
+                resetDefragment();
+                break;
+            }
+            // The leaf stays where it is and tries the next block instead
+            if (status == -3) {
+                defragPosition++;
+                continue;
+            }
+            moved++;
+        }
+
+        defragPlacedRBN = targetRBN;
+        defragPosition++;
+    }
+
+    for (auto &entry : latched) {
+        releaseFrame(entry.second, true, modified.count(entry.first) > 0);
+    }
+
+    if (result == 0) {
+        resetDefragment();
+        return 0;
+    }
+    return max(1, static_cast<int>(defragSlots.size()) - defragPosition);
+}
+
+int BTreeFile::swapLeaves(int firstRBN, int secondRBN, map<int, Frame*>& latched, set<int>& modified) {
+    Frame* first = tryLatch(firstRBN, latched);
+    Frame* second = first != nullptr ? tryLatch(secondRBN, latched) : nullptr;
+    if (first == nullptr || second == nullptr) return -1;
+    if (!first->node.getIsLeaf() || !second->node.getIsLeaf()) return -2;
+
+    Frame* firstParent;
+    Frame* secondParent;
+    int status = findParent(first, latched, firstParent);
+    if (status == 0) status = findParent(second, latched, secondParent);
+    if (status != 0) return status;
+
+    // Latch the neighbors before changing anything, so a busy one leaves the tree as it was
+    vector<Frame*> neighbors;
+    for (int RBN : {first->node.getPrevRBN(), first->node.getNextRBN(),
+                    second->node.getPrevRBN(), second->node.getNextRBN()}) {
+        if (RBN == 0 || RBN == firstRBN || RBN == secondRBN) continue;
+        Frame* neighbor = tryLatch(RBN, latched);
+        if (neighbor == nullptr) return -1;
+        // A leaf between the two is a neighbor of both, but must only be relinked once
+        if (std::find(neighbors.begin(), neighbors.end(), neighbor) == neighbors.end()) {
+            neighbors.push_back(neighbor);
+        }
+    }
+
+    // The parents are the only nodes that can fail to change, so they go first
+    if (firstParent->node.swapChildren(firstRBN, secondRBN) == -1) return -3;
+    if (secondParent != firstParent && secondParent->node.swapChildren(firstRBN, secondRBN) == -1) {
+        firstParent->node.swapChildren(firstRBN, secondRBN);
+        return -3;
+    }
+    modified.insert(firstParent->rbn);
+    modified.insert(secondParent->rbn);
+
+    auto relink = [firstRBN, secondRBN](int RBN) {
+        return RBN == firstRBN ? secondRBN : RBN == secondRBN ? firstRBN : RBN;
+    };
+
+    std::swap(first->node, second->node);
+    first->node.setCurRBN(firstRBN);
+    second->node.setCurRBN(secondRBN);
+
+    for (Frame* frame : {first, second}) {
+        frame->node.setPrevRBN(relink(frame->node.getPrevRBN()));
+        frame->node.setNextRBN(relink(frame->node.getNextRBN()));
+        modified.insert(frame->rbn);
+    }
+    for (Frame* neighbor : neighbors) {
+        neighbor->node.setPrevRBN(relink(neighbor->node.getPrevRBN()));
+        neighbor->node.setNextRBN(relink(neighbor->node.getNextRBN()));
+        modified.insert(neighbor->rbn);
+    }
+
+    return 0;
+}
+
+Frame* BTreeFile::tryLatch(int RBN, map<int, Frame*>& latched) {
+    auto it = latched.find(RBN);
+    if (it != latched.end()) {
+        return it->second;
     }
 
-    if (parent->isUnderFilled()) {
-        BTreeNode *newParent = findParentNode(parent);
-        handleMerge(newParent, parent);
+    Frame* frame = pool.fetch(RBN);
+    if (frame == nullptr) return nullptr;
+    if (!frame->latch.try_lock()) {
+        pool.unpin(frame, false);
+        return nullptr;
+    }
+
+    latched[RBN] = frame;
+    return frame;
+}
+
+int BTreeFile::findParent(Frame* leaf, map<int, Frame*>& latched, Frame*& parent) {
+    // Any key of a leaf leads to it, only the root can be an empty leaf
+    int key = leaf->node.getLargestKey();
+    if (key == -1) return -2;
+
+    parent = tryLatch(rootRBN, latched);
+    while (true) {
+        int childRBN = parent->node.getNextChild(key);
+        if (childRBN == leaf->rbn) return 0;
+
+        Frame* child = tryLatch(childRBN, latched);
+        if (child == nullptr) return -1;
+        if (child->node.getIsLeaf()) return -2;
+        parent = child;
     }
 }
 
-BTreeNode* BTreeFile::findParentNode(BTreeNode* childNode) {
-    BTreeNode* currentNode = this->root;
-    BTreeNode* parentNode = nullptr;
+void BTreeFile::resetDefragment() {
+    defragSlots.clear();
+    defragScanRBN = 0;
+    defragPosition = -1;
+    defragPlacedRBN = 0;
+}
+
+int BTreeFile::vacuum(double fillFactor, VacuumReport &report) {
+    if (!file.is_open() || fillFactor <= 0 || fillFactor > 1 || !flushData()) {
+        return -1;
+    }
+
+    std::error_code error;
+    report.oldSize = std::filesystem::file_size(filename, error);
+    report.oldHeight = height;
+    report.oldLeaves = 0;
 
-    while (currentNode && !currentNode->getIsLeaf()) {
-        int childRBN = currentNode->getNextChild(childNode->getLargestKey());
+    // The new tree is built beside the old one, which stays untouched until the new one is complete
+    string vacuumName = filename + ".vacuum";
+    fstream vacuumFile(vacuumName.c_str(), ios::in | ios::out | ios::binary | ios::trunc);
+    if (!vacuumFile.is_open()) {
+        return -1;
+    }
 
-        if (childRBN == childNode->getCurRBN()) {
-            if (parentNode == nullptr) return root;
-            else return currentNode;
+    HeaderBuffer vacuumHeader = headerBuffer;
+    BTreeBuilder builder(vacuumFile, vacuumHeader, makeNode(), fillFactor);
+    RecordBuffer recordBuffer;
+    int status = 0;
+
+    Frame* frame = findLeafNode(0);
+    while (frame != nullptr) {
+        report.oldLeaves++;
+        frame->node.getBlockBuffer().forEachRecord([&](const RecordView &record) {
+            // Deleted records are simply left out of the new tree
+            if (record.isTombstone()) return true;
+            if (recordBuffer.assign(record.getText()) == -1 || builder.add(recordBuffer) == -1) {
+                status = -1;
+                return false;
+            }
+            return true;
+        });
+
+        if (status == -1) {
+            releaseFrame(frame, false, false);
+            break;
         }
+        frame = nextLeafNode(frame);
+    }
+
+    if (status == 0) {
+        status = builder.finish();
+    }
+    vacuumFile.close();
 
-        parentNode = currentNode;
-        currentNode = new BTreeNode(order);
-        currentNode->read(file, headerBuffer.headerRecordSize, childRBN);
+    // Renaming over the tree file swaps the new tree in all at once
+    if (status == 0) {
+        std::filesystem::rename(vacuumName, filename, error);
+    }
+    if (status == -1 || error) {
+        std::filesystem::remove(vacuumName, error);
+        return -1;
+    }
+
+    // The cached nodes and free blocks belonged to the old file
+    pool.clear();
+    file.close();
+    resetDefragment();
+    if (!openFile(filename)) {
+        return -1;
     }
 
-    return nullptr;
+    report.newSize = std::filesystem::file_size(filename, error);
+    report.newHeight = height;
+    report.newLeaves = builder.getLeafCount();
+    return 0;
 }
 
-BTreeNode* BTreeFile::findLeafNode(int key) {
-    BTreeNode * currentNode = this->root;
+int BTreeFile::verify(VerifyReport &report, int threads) {
+    if (!file.is_open() || headerBuffer.blockChecksum != "CRC32C" || !flushData()) {
+        return -1;
+    }
+    if (threads <= 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
 
-    while (!currentNode->getIsLeaf()) {
-        int childKey = currentNode->getNextChild(key);
-        // read node from child key
-        BTreeNode * newNode = new BTreeNode(order);
-        newNode->read(file, headerBuffer.headerRecordSize, childKey);
-        currentNode = newNode;
+    // The free space bitmap after rbnAvail has no checksums
+    int blocks = headerBuffer.rbnAvail - 1;
+    int blockSize = headerBuffer.blockSize;
+    vector<vector<int>> badBlocks(threads);
+    atomic<bool> failed(false);
+    vector<thread> workers;
+
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            int first = 1 + static_cast<int>(static_cast<long long>(blocks) * t / threads);
+            int last = 1 + static_cast<int>(static_cast<long long>(blocks) * (t + 1) / threads);
+            if (first == last) return;
+
+            ifstream in(filename.c_str(), ios::binary);
+            in.seekg(HeaderBuffer::blockOffset(first, blockSize, headerBuffer.headerRecordSize));
+            string block(blockSize, '\0');
+            for (int RBN = first; RBN < last; RBN++) {
+                if (!in.read(&block[0], blockSize)) {
+                    failed = true;
+                    return;
+                }
+                if (!BlockChecksum::verify(block)) {
+                    badBlocks[t].push_back(RBN);
+                }
+            }
+        });
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    if (failed) {
+        return -1;
     }
 
-    return currentNode;
+    report.blocks = blocks;
+    report.badBlocks.clear();
+    for (vector<int> &bad : badBlocks) {
+        report.badBlocks.insert(report.badBlocks.end(), bad.begin(), bad.end());
+    }
+    return 0;
 }
 
-void BTreeFile::displayNode(BTreeNode* node, ostream& ostream, int level, const string& prefix) {
-    if (node == nullptr) return;
+/**
+ * Counts a node in the report of its level.
+ */
+static void countNode(LevelReport &level, double fill) {
+    level.nodes++;
+    level.averageFill += fill;
+    level.fillHistogram[min(9, static_cast<int>(fill * 10))]++;
+}
+
+int BTreeFile::analyze(AnalyzeReport &report, int threads) {
+    if (!file.is_open() || !flushData()) {
+        return -1;
+    }
+    if (threads <= 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+
+    report = AnalyzeReport();
+    report.height = height;
+    report.levels.assign(height, LevelReport());
+    report.blocks = headerBuffer.rbnAvail - 1;
+    {
+        lock_guard<mutex> guard(allocMutex);
+        report.freeBlocks = freeSpace.getFreeCount();
+    }
+
+    // Each index level gives the blocks of the one below it, in key order
+    vector<int> level = {rootRBN};
+    for (int depth = height - 1; depth > 0; depth--) {
+        vector<vector<int>> children(threads);
+        vector<LevelReport> partial(threads);
+        atomic<bool> failed(false);
+        vector<thread> workers;
+
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                size_t first = level.size() * t / threads;
+                size_t last = level.size() * (t + 1) / threads;
+                if (first == last) return;
+
+                ifstream in(filename.c_str(), ios::binary);
+                BTreeNode node = makeNode();
+                for (size_t i = first; i < last; i++) {
+                    if (node.read(in, headerBuffer.headerRecordSize, level[i]) == -1 || node.getIsLeaf()) {
+                        failed = true;
+                        return;
+                    }
+                    countNode(partial[t], node.getFill());
+                    vector<int> nodeChildren = node.getChildren();
+                    children[t].insert(children[t].end(), nodeChildren.begin(), nodeChildren.end());
+                }
+            });
+        }
+        for (thread &worker : workers) {
+            worker.join();
+        }
+        if (failed) {
+            return -1;
+        }
+
+        LevelReport &levelReport = report.levels[depth];
+        level.clear();
+        for (int t = 0; t < threads; t++) {
+            levelReport.nodes += partial[t].nodes;
+            levelReport.averageFill += partial[t].averageFill;
+            for (int i = 0; i < 10; i++) {
+                levelReport.fillHistogram[i] += partial[t].fillHistogram[i];
+            }
+            level.insert(level.end(), children[t].begin(), children[t].end());
+        }
+    }
+
+    // Reading the leaves in block order rather than sequence set order keeps the reads sequential
+    sort(level.begin(), level.end());
+    ifstream in(filename.c_str(), ios::binary);
+    BTreeNode node = makeNode();
+    long long keySpans = 0;
+    int spannedLeaves = 0;
+    for (int RBN : level) {
+        if (node.read(in, headerBuffer.headerRecordSize, RBN) == -1 || !node.getIsLeaf()) {
+            return -1;
+        }
+        countNode(report.levels[0], node.getFill());
+
+        const BlockBuffer &blockBuffer = node.getBlockBuffer();
+        int smallestKey = -1;
+        int records = blockBuffer.forEachRecord([&smallestKey](const RecordView &record) {
+            if (smallestKey == -1) smallestKey = record.getKey();
+            return true;
+        });
+        if (records > 0) {
+            report.records += records;
+            keySpans += node.getLargestKey() - smallestKey;
+            spannedLeaves++;
+        }
+
+        int nextRBN = node.getNextRBN();
+        if (nextRBN != 0) {
+            report.leafLinks++;
+            if (nextRBN == RBN + 1) report.sequentialLinks++;
+            if (nextRBN > RBN) report.forwardLinks++;
+        }
+    }
+
+    for (LevelReport &levelReport : report.levels) {
+        if (levelReport.nodes > 0) levelReport.averageFill /= levelReport.nodes;
+    }
+    if (spannedLeaves > 0) {
+        report.averageKeySpan = static_cast<double>(keySpans) / spannedLeaves;
+    }
+    return 0;
+}
+
+BTreeNode BTreeFile::makeNode() {
+    return pool.makeNode();
+}
+
+int BTreeFile::allocateRBN(int nearRBN) {
+    lock_guard<mutex> guard(allocMutex);
+    return freeSpace.allocate(nearRBN);
+}
+
+void BTreeFile::freeRBN(int RBN) {
+    lock_guard<mutex> guard(allocMutex);
+    freeSpace.release(RBN);
+}
+
+void BTreeFile::displayNode(Frame* frame, ostream& ostream, int level, const string& prefix) {
+    frame->latch.lock_shared();
 
     ostream << prefix;
     if (level > 0) {
         ostream << "|-- ";
     }
 
-    node->print(ostream);
+    frame->node.print(ostream);
 
-    if (!node->getIsLeaf()) {
-        vector<int> children = node->getChildren();
+    if (!frame->node.getIsLeaf()) {
+        vector<int> children = frame->node.getChildren();
         for (int i = 0; i < children.size(); i++) {
-            BTreeNode * childNode = new BTreeNode(order);
-            childNode->read(file, headerBuffer.headerRecordSize, children[i]);
+            Frame * childFrame = pool.fetch(children[i]);
+            if (childFrame == nullptr) continue;
             string newPrefix = prefix + (i < children.size() - 1 ? "|   " : "    ");
-            displayNode(childNode, ostream, level + 1, newPrefix);
+            displayNode(childFrame, ostream, level + 1, newPrefix);
         }
     }
+
+    releaseFrame(frame, false, false);
 }
 
 bool BTreeFile::flushData() {
-    if (file.is_open()) {
-        file.flush();
-        file.close();
-    } else return false;
+    if (!file.is_open()) {
+        return false;
+    }
 
-    file.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
-    return file.is_open();
+    return pool.flush() != -1 && file.good();
 }
-
-
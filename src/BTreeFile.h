@@ -8,6 +8,14 @@
  * @brief A class for building the Btree File.
  * @details: This class provides methods for working with a file associated with a BlockBuffer.
  * Includes: Methods for opening, closing, reading, creating ,and writing to the file.
+ * Nodes are accessed through a BufferPool whose frames carry reader/writer latches, so insert, remove,
+ * search and the display functions may be called from several threads at once. Descents use latch
+ * crabbing: a child is latched before its parent is released, and writers release every ancestor as
+ * soon as they reach a node that cannot split (insert) or underflow (remove).
+ * In B_LINK mode every node also keeps a high key and a right link, as in Lehman and Yao's B-link tree.
+ * Readers and writers then hold a single latch at a time: a split releases the node before latching
+ * the parent, and anyone who lands on a node whose high key is below their key moves right. Nodes are
+ * never merged in this mode.
  * Assumes:The provided BlockBuffer and HeaderBuffer objects are correctly initialized and valid.
  */
 
@@ -17,20 +25,98 @@
 #include "RecordBuffer.h"
 #include "HeaderBuffer.h"
 #include "BTreeNode.h"
-#include "RecordFile.h"
 #include "StateDatabase.h"
+#include "BufferPool.h"
+#include "FreeSpaceMap.h"
+#include "TreeStats.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+/**
+* @brief What a vacuum changed in the tree file.
+*/
+struct VacuumReport {
+    std::uintmax_t oldSize = 0; /**< Bytes in the tree file before */
+    std::uintmax_t newSize = 0; /**< Bytes in the tree file after */
+    int oldHeight = 0;          /**< Levels before, counting the leaves */
+    int newHeight = 0;          /**< Levels after, counting the leaves */
+    int oldLeaves = 0;          /**< Leaves in the sequence set before */
+    int newLeaves = 0;          /**< Leaves in the sequence set after */
+};
+
+/**
+* @brief What a verify found in the tree file.
+*/
+struct VerifyReport {
+    int blocks = 0;             /**< Blocks checked */
+    std::vector<int> badBlocks; /**< Blocks whose checksum did not match, in file order */
+};
+
+/**
+* @brief The nodes of one level of the tree and how full they are.
+*/
+struct LevelReport {
+    int nodes = 0;                      /**< Nodes on the level */
+    double averageFill = 0;             /**< Mean of the bytes used over the block size */
+    std::array<int, 10> fillHistogram{}; /**< Nodes by fill in steps of 10%, overfilled nodes in the last */
+};
+
+/**
+* @brief What an analyze found in the tree.
+*/
+struct AnalyzeReport {
+    int height = 0;                 /**< Levels, counting the leaves */
+    std::vector<LevelReport> levels; /**< One per level, the leaves first and the root last */
+    int blocks = 0;                 /**< Node blocks in the file, used or free */
+    int freeBlocks = 0;             /**< Blocks in the free space map */
+    long long records = 0;          /**< Records in the leaves, tombstones included */
+    double averageKeySpan = 0;      /**< Mean of the largest key less the smallest over leaves holding records */
+    int leafLinks = 0;              /**< Leaves with a right sibling */
+    int sequentialLinks = 0;        /**< Leaves whose right sibling is in the next block */
+    int forwardLinks = 0;           /**< Leaves whose right sibling is further on in the file */
+};
 
 class BTreeFile
 {
 public:
+    /**
+    * @brief The latching protocol used by insert, remove and search.
+    */
+    enum ConcurrencyMode {
+        LATCH_CRABBING, /**< Latch coupling from the root, merges on underflow */
+        B_LINK          /**< One latch at a time with right links, no merges */
+    };
+
+    /**
+    * @brief What a full node does when its sibling has no room to take entries from it.
+    */
+    enum SplitMode {
+        ONE_TO_TWO,     /**< The node splits in half */
+        TWO_TO_THREE    /**< The node and its full sibling split into three, as in a B* tree */
+    };
+
+    /**
+    * @brief How remove takes a record out of the tree.
+    */
+    enum DeleteMode {
+        EAGER,          /**< The record is removed and an underfilled leaf is rebalanced at once */
+        LAZY            /**< The record is replaced by a tombstone, rebalancing waits for a purge */
+    };
+
     /**
     * @brief This is the constructor for the BtreeFile, it takes int the header buffer object
     * @param HeaderBuffer Object
     * @param order the order of the b tree
+    * @param cacheCapacity the number of nodes to keep in memory
     * @post Class is initialized.
     */
-    BTreeFile(HeaderBuffer &hbuf, int order);
+    BTreeFile(HeaderBuffer &hbuf, int order, int cacheCapacity = 4096);
 
     /**
     * @brief This is the destructor for the btree object.
@@ -48,14 +134,16 @@ public:
     /**
     * @brief inserts a record into the btree
     * @param RecordBuffer record to insert
-    * @return returns location of record inserted or -1 if failed
+    * @return returns 0 if the record was inserted or -1 if failed
     */
     int insert(RecordBuffer& recordBuffer);
 
     /**
     * @brief This removes a certain record
+    * @details In LAZY mode only the leaf is latched and rewritten, with a tombstone in place of the record.
+    * Once the tombstone threshold is crossed, the remove that crossed it purges the whole tree.
     * @param recordBuffer record to remove
-    * @return returns location of record removed, or -1 if failed
+    * @return returns 0 if the record was removed, or -1 if failed or not found
     */
     int remove(RecordBuffer& recordBuffer);
 
@@ -67,6 +155,15 @@ public:
     */
     int search(RecordBuffer& recordBuffer, int key);
 
+    /**
+    * @brief Collects every record whose key lies in a range, walking the sequence set.
+    * @param lowKey the smallest zipcode to return.
+    * @param highKey the largest zipcode to return.
+    * @param results the vector to append the records to, in key order.
+    * @return the number of records found, or -1 if the tree could not be read
+    */
+    int rangeSearch(int lowKey, int highKey, std::vector<RecordBuffer>& results);
+
     /**
     * @brief Display the tree sequence set
     * @param ostream the stream to display too
@@ -88,13 +185,150 @@ public:
     */
     void displayTree(std::ostream& ostream);
 
+    /**
+    * @brief Moves leaves so the sequence set runs front to back through the file, a few at a time.
+    * @details A pass first follows the sequence set to find the blocks its leaves use, then walks it
+    * again giving the leaves those blocks in key order, swapping a leaf with whichever leaf holds the
+    * block it should have. Each call visits at most maxLeaves leaves, holding the root exclusive so
+    * new operations wait, and backs off when a node it needs is latched, so it can be throttled
+    * between other work. Only one thread should call it at a time.
+    * @param maxLeaves the most leaves to visit in this step
+    * @param moved stores how many leaves this step moved
+    * @return 0 once a pass has been through the whole sequence set, -1 in B_LINK mode, where readers do
+    * not hold a parent while following a child link, or if a block could not be read, a positive number
+    * while the pass goes on
+    */
+    int defragmentStep(int maxLeaves, int &moved);
+
+    /**
+    * @brief Removes tombstones left by lazy deletes from a few leaves, rebalancing those left underfilled.
+    * @details A pass follows the sequence set from where the last step stopped, noting the leaves that hold
+    * tombstones, then latches the path down to each of them exclusive as an eager remove would and purges
+    * it. Steps may run alongside other operations, each step waits for one running on another thread.
+    * @param maxLeaves the most leaves to visit in this step
+    * @param purged stores how many tombstones this step removed
+    * @return 0 once a pass has been through the whole sequence set, -1 if a block could not be read, a
+    * positive number while the pass goes on
+    */
+    int purgeStep(int maxLeaves, int &purged);
+
+    /**
+    * @brief Rebuilds the tree into a new, packed file and swaps it in for the current one.
+    * @details The sequence set is streamed into a BTreeBuilder writing a file next to the tree file, and
+    * once that is complete it is renamed over the tree file, so the tree is either the old one or the new
+    * one even if the rebuild fails partway. The tree is then reopened from the new file. No other
+    * operation may run while the tree is rebuilt.
+    * @param fillFactor how full to make each node, from above 0 up to 1
+    * @param report stores the file size, height and leaf count before and after
+    * @return -1 if the fill factor is out of range or the new file could not be written, 0 otherwise
+    */
+    int vacuum(double fillFactor, VacuumReport &report);
+
+    /**
+    * @brief Checks the checksum of every block in the tree file.
+    * @details Cached changes are flushed first. The blocks are then split into one run per thread, and
+    * each thread reads its run through its own stream, bypassing the buffer pool.
+    * @param report stores how many blocks were checked and which ones are damaged
+    * @param threads number of threads to check with, 0 for one per core
+    * @return -1 if the file has no checksums or could not be read, 0 otherwise
+    */
+    int verify(VerifyReport &report, int threads = 0);
+
+    /**
+    * @brief Walks the whole tree once and reports its shape, how full its nodes are and how well the
+    * sequence set is laid out in the file.
+    * @details Cached changes are flushed first and nodes are read through streams of their own, bypassing
+    * the buffer pool, so no other operation may run while the tree is analyzed. The index levels are read
+    * a level at a time, each split among the threads. The leaves are then read by one thread in block
+    * order, so that the reads are sequential whatever order the sequence set is in.
+    * @param report stores the height, the nodes and fill of every level, the free blocks, the average key
+    * span of a leaf and how many leaves link to the next block
+    * @param threads number of threads to read index levels with, 0 for one per core
+    * @return -1 if a block could not be read, 0 otherwise
+    */
+    int analyze(AnalyzeReport &report, int threads = 0);
+
+    /**
+    * @brief Returns the height of the tree
+    * @return number of levels, 1 when the root is a leaf
+    */
+    int getHeight();
+
+    /**
+    * @brief Selects the latching protocol, must be called before the tree is shared between threads
+    * @param mode the protocol to use
+    * @return nothing
+    */
+    void setConcurrencyMode(ConcurrencyMode mode);
+
+    /**
+    * @brief Returns the latching protocol in use
+    * @return the current mode
+    */
+    ConcurrencyMode getConcurrencyMode();
+
+    /**
+    * @brief Selects how full nodes split, must be called before the tree is shared between threads
+    * @param mode the split mode to use
+    * @return nothing
+    */
+    void setSplitMode(SplitMode mode);
+
+    /**
+    * @brief Returns how full nodes split
+    * @return the current mode
+    */
+    SplitMode getSplitMode();
+
+    /**
+    * @brief Selects how records are removed, must be called before the tree is shared between threads
+    * @param mode the delete mode to use
+    * @return nothing
+    */
+    void setDeleteMode(DeleteMode mode);
+
+    /**
+    * @brief Returns how records are removed
+    * @return the current mode
+    */
+    DeleteMode getDeleteMode();
+
+    /**
+    * @brief Sets how many lazy deletes may pile up before one of them purges the tree
+    * @param threshold the number of tombstones, 0 to only purge when purgeStep is called
+    * @return nothing
+    */
+    void setTombstoneThreshold(int threshold);
+
+    /**
+    * @brief  This flushes all the data from the file and places it to btree
+    * @return  Returns False if flush fails, returns True is flush succeeds and file is open
+    */
+    bool flushData();
+
 private:
+    static const int rootRBN = 1; /**< The root always lives in the first block */
+    static const int purgeBatch = 64; /**< Leaves each step of a purge started by the threshold visits */
+
     HeaderBuffer &headerBuffer; /**< Stores the reference to the HeaderBuffer object */
     std::fstream file;          /**< Stores the fstream object to the file */
     std::string filename;       /**< Stores the file name for the Btree */
-    BTreeNode* root;            /**< This is a pointer the the Btree root Node */
+    BufferPool pool;            /**< Caches nodes and their latches */
+    FreeSpaceMap freeSpace;     /**< Blocks free to reuse */
+    std::mutex allocMutex;      /**< Guards block allocation in the header and free space map */
     int order;                  /**< This is the order of the btree*/
-    int height;                 /**< This is the height of the btree*/
+    std::atomic<int> height;    /**< This is the height of the btree*/
+    ConcurrencyMode concurrencyMode = LATCH_CRABBING; /**< The latching protocol in use */
+    SplitMode splitMode = ONE_TO_TWO;                 /**< How full nodes split */
+    DeleteMode deleteMode = EAGER;                    /**< How records are removed */
+    int tombstoneThreshold = 0;         /**< Lazy deletes that start a purge, 0 for never */
+    std::atomic<int> tombstones{0};     /**< Lazy deletes since the last purge pass finished */
+    std::mutex purgeMutex;              /**< Held by the purge step in progress */
+    int purgeKey = 0;                   /**< Key the next purge step starts from */
+    std::vector<int> defragSlots;   /**< Blocks the leaves of the current defragment pass go to, in order */
+    int defragScanRBN = 0;          /**< Next leaf to find while a defragment pass is being planned */
+    int defragPosition = -1;        /**< Leaves placed in the current defragment pass, -1 while planning */
+    int defragPlacedRBN = 0;        /**< Block of the last leaf placed */
 
     /**
     * @brief This function closes the file.
@@ -103,57 +337,260 @@ private:
     bool closeFile();
 
     /**
-    * @brief This function adds key pairs to reference block, but handles split root
-    * @param largestKey, this is the largest key in the block,
-    * @param leaf cantaining first half of records. Is the original block.
-    * @param newLeaf leaf containing other half of records
+    * @brief This function moves the root contents into two new blocks and makes the root their parent.
+    * @param separator the key between the left half and the new node.
+    * @param rootFrame the latched root, holding the first half of records or keys.
+    * @param newNode node containing other half of records or keys
+    */
+    void handleRootSplit(int separator, Frame* rootFrame, BTreeNode* newNode);
+
+    /**
+    * @brief This function adds key pairs to the parent in cases not involving root node.
+    * @param separator the key between the left half and the new node.
+    * @param path latched frames from the highest unsafe ancestor down to the node that split.
+    * @param newNode node containing other half of records or keys
+    * @post every frame in path is released
+    */
+    void handleNonRootSplit(int separator, FramePath& path, BTreeNode* newNode);
+
+    /**
+    * @brief This function merges an underfilled node with a sibling under the same parent.
+    * @param path latched frames from the highest unsafe ancestor down to the underfilled node.
+    * @post every frame in path is released
+    */
+    void handleMerge(FramePath& path);
+
+    /**
+    * @brief This function makes room in an overfilled node, by moving entries to a sibling if it has room
+    * and by splitting otherwise.
+    * @param path latched frames from the highest unsafe ancestor down to the overfilled node.
+    * @param recordSize the size of the record being inserted, which both siblings must still have room for
+    * @post every frame in path is released
+    */
+    void handleOverflow(FramePath& path, int recordSize);
+
+    /**
+    * @brief Latches the sibling of a node under the same parent, the right one if there is one.
+    * @param parent the latched parent
+    * @param frame the latched node
+    * @param onRight stores whether the sibling is to the right of frame
+    * @param separator stores the parent key between the two
+    * @return the sibling, or nullptr if there is none or the left one is busy
     */
-    void handleRootSplit(int largestKey, BTreeNode* leaf, BTreeNode* newLeaf);
+    Frame* latchSibling(Frame* parent, Frame* frame, bool &onRight, int &separator);
 
     /**
-    * @brief This function adds key pairs to reference block in cases not involving root node.
-    * @param largestKey, this is the largest key in the block,
-    * @param leaf cantaining first half of records. Is the original block.
-    * @param newLeaf leaf containing other half of records
+    * @brief Evens out two siblings and updates the separator between them, undoing it if that does not help.
+    * @param parent the latched parent
+    * @param left the latched left sibling
+    * @param right the latched right sibling
+    * @param separator the parent key between the two
+    * @param recordSize after an overflow, the record size both must still have room for, -1 after an
+    * underflow, when both only have to stay above minimum capacity
+    * @return true if the siblings were redistributed
     */
-    void handleNonRootSplit(int largestKey, BTreeNode* leaf, BTreeNode* newLeaf);
+    bool redistributeSiblings(Frame* parent, Frame* left, Frame* right, int separator, int recordSize);
 
     /**
-    * @brief This function handles the merge between a leaf and another leaf.
-    * @param parent the parent of leaf to merge
-    *@param leaf the leaf to merge with another node
+    * @brief Splits two full siblings into three, linking the new node in after the right one.
+    * @param path latched frames from the highest unsafe ancestor down to the overfilled node.
+    * @param left the latched left sibling
+    * @param right the latched right sibling
+    * @param separator the parent key between the two
+    * @return false without changing anything if the parent could overflow with no ancestor held to
+    * split it into, true once the split is done and every frame is released
     */
-    void handleMerge(BTreeNode *parent, BTreeNode *leaf);
+    bool splitThreeWays(FramePath& path, Frame* left, Frame* right, int separator);
 
     /**
-    * @brief Find Parent Node Returns parent node if you place in child node
-    * @param childNode the node of which to  find parent of
-    * @return BtreeNode object, parent node of parameter
+    * @brief Replaces a record with a tombstone, latching only its leaf exclusive, used in LAZY mode.
+    * @param recordBuffer record to remove
+    * @return 0 if the record was marked, -1 if failed or not found
     */
-    BTreeNode* findParentNode(BTreeNode* childNode);
+    int removeLazy(RecordBuffer& recordBuffer);
+
+    /**
+    * @brief Continues the purge pass, the caller holds purgeMutex.
+    * @param maxLeaves the most leaves to visit
+    * @param purged stores how many tombstones were removed
+    * @return the same as purgeStep
+    */
+    int purgeLeaves(int maxLeaves, int &purged);
+
+    /**
+    * @brief Removes the tombstones from one leaf, merging or redistributing it if that leaves it underfilled.
+    * @param key a key in the leaf
+    * @return the number of tombstones removed, -1 if a block could not be read
+    */
+    int purgeLeaf(int key);
+
+    /**
+    * @brief Inserts a record latching one node at a time, used in B_LINK mode.
+    * @param recordBuffer record to insert
+    * @return 0 if the record was inserted, -1 otherwise
+    */
+    int insertBLink(RecordBuffer& recordBuffer);
+
+    /**
+    * @brief Removes a record latching only its leaf, used in B_LINK mode.
+    * @param recordBuffer record to remove
+    * @return 0 if the record was removed, -1 if failed or not found
+    */
+    int removeBLink(RecordBuffer& recordBuffer);
+
+    /**
+    * @brief Splits an overfilled node and posts separators upward, one latch at a time.
+    * @param frame the overfilled node, latched exclusive
+    * @param level the level of the node, 0 for leaves
+    * @post frame and every parent touched are released
+    */
+    void handleBLinkSplit(Frame* frame, int level);
+
+    /**
+    * @brief Descends from the root to the node on a level whose key range holds the key.
+    * @param key the key to look for
+    * @param level the level to stop at, 0 for leaves
+    * @param exclusive true to latch the returned node exclusive, otherwise shared
+    * @return the pinned and latched node, or nullptr on error
+    */
+    Frame* descendToLevel(int key, int level, bool exclusive);
+
+    /**
+    * @brief Follows right links while the key is beyond the node's high key.
+    * @param frame the pinned and latched node to start at
+    * @param key the key to look for
+    * @param exclusive true if the latches are exclusive
+    * @return the pinned and latched node holding the key range, or nullptr on error
+    */
+    Frame* moveRight(Frame* frame, int key, bool exclusive);
+
+    /**
+    * @brief Gives the right half of a split a block and links it in as the right sibling.
+    * @param frame the split node, latched exclusive
+    * @param newNode the right half of the split
+    * @return the RBN of the new node
+    */
+    int linkNewNode(Frame* frame, BTreeNode* newNode);
+
+    /**
+    * @brief Latches a pinned frame.
+    * @param frame the frame to latch
+    * @param exclusive true for an exclusive latch, false for shared
+    * @return nothing
+    */
+    void latchFrame(Frame* frame, bool exclusive);
 
     /**
     * @brief this will find the leaf node based on a key input
     * @param key int, This is a zipcode key
-    * @return Returns the leaf node based on the key parameter
+    * @param exclusive true to latch the leaf exclusive, the index nodes above it are still latched shared
+    * @return Returns the pinned leaf frame latched shared or exclusive, or nullptr on error
+    */
+    Frame* findLeafNode(int key, bool exclusive = false);
+
+    /**
+    * @brief Moves a shared latch from a leaf to the next leaf in the sequence set.
+    * @param leaf the pinned leaf frame latched shared
+    * @return the next leaf latched shared, or nullptr at the end of the sequence set
     */
-    BTreeNode* findLeafNode(int key);
+    Frame* nextLeafNode(Frame* leaf);
+
+    /**
+    * @brief Unlatches and unpins a frame.
+    * @param frame the frame to release
+    * @param exclusive true if the frame is latched exclusive
+    * @param dirty true if the node was modified
+    * @return nothing
+    */
+    void releaseFrame(Frame* frame, bool exclusive, bool dirty);
+
+    /**
+    * @brief Unlatches and unpins every exclusively latched frame in a path, then clears it.
+    * @param path the frames to release
+    * @param dirty true if the nodes were modified
+    * @return nothing
+    */
+    void releasePath(FramePath& path, bool dirty);
+
+    /**
+    * @brief Finds the blocks the leaves of the sequence set use, continuing a defragment pass.
+    * @param maxLeaves the most leaves to visit
+    * @return -1 if a block could not be read, a positive number otherwise
+    */
+    int planDefragment(int maxLeaves);
+
+    /**
+    * @brief Moves leaves into the blocks planned for them, continuing a defragment pass.
+    * @param maxLeaves the most leaves to visit
+    * @param moved stores how many leaves were moved
+    * @return 0 once the pass is done, a positive number otherwise
+    */
+    int placeLeaves(int maxLeaves, int &moved);
+
+    /**
+    * @brief Trades the blocks of two leaves, relinking their parents and neighbors.
+    * @pre The root is latched exclusive and in latched.
+    * @param firstRBN the block of one leaf
+    * @param secondRBN the block of the other leaf
+    * @param latched the frames latched exclusive for the step, by RBN
+    * @param modified stores the RBNs of the frames changed
+    * @return 0 if the leaves were swapped, -1 if a node was busy, -2 if either block is no longer a leaf,
+    * -3 if a parent would no longer fit in its block
+    */
+    int swapLeaves(int firstRBN, int secondRBN, std::map<int, Frame*>& latched, std::set<int>& modified);
+
+    /**
+    * @brief Latches a frame exclusive for a defragment step without waiting.
+    * @param RBN the block to latch
+    * @param latched the frames latched so far, returned again rather than latched twice
+    * @return the frame, or nullptr if it is busy or could not be read
+    */
+    Frame* tryLatch(int RBN, std::map<int, Frame*>& latched);
+
+    /**
+    * @brief Finds the index node that links to a leaf, latching the nodes on the way.
+    * @param leaf the latched leaf
+    * @param latched the frames latched for the step
+    * @param parent stores the parent frame
+    * @return 0 if found, -1 if a node was busy, -2 if the leaf is not reached by its keys
+    */
+    int findParent(Frame* leaf, std::map<int, Frame*>& latched, Frame*& parent);
+
+    /**
+    * @brief Forgets the current defragment pass, so the next step plans a new one.
+    * @return nothing
+    */
+    void resetDefragment();
+
+    /**
+    * @brief Hands out a free block, or the next block past the end of the file if none is free.
+    * @param nearRBN the block the new block will be linked to, free blocks closest to it are used first
+    * @return the RBN of the new block
+    */
+    int allocateRBN(int nearRBN);
+
+    /**
+    * @brief Returns a block that is no longer referenced by the tree, so it can be reused.
+    * @param RBN the block to free
+    * @return nothing
+    */
+    void freeRBN(int RBN);
+
+    /**
+    * @brief Creates an empty leaf laid out as the header describes.
+    * @return the new node
+    */
+    BTreeNode makeNode();
 
     /**
     * @brief Displays the node to the output stream.
-    * @param node, the node to display
+    * @param frame, the pinned frame of the node to display
     * @param ostream, the stream to display too.
     * @param level, the current level the node is on
     * @param prefix, the prefix used to indent node based on level (for tree appearance)
     * @return nothing
     */
-    void displayNode(BTreeNode* node, std::ostream& ostream, int level, const std::string& prefix);
-
-    /**
-    * @brief  This flushes all the data from the file and places it to btree
-    * @return  Returns False if flush fails, returns True is flush succeeds and file is open
-    */
-    bool flushData();
+    void displayNode(Frame* frame, std::ostream& ostream, int level, const std::string& prefix);
 
 };
 
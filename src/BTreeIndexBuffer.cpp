@@ -4,25 +4,44 @@
  */
 
 #include "BTreeIndexBuffer.h"
+#include "HeaderBuffer.h"
+#include "TreeStats.h"
+#include <algorithm>
 using namespace std;
 
+const std::string BTreeIndexBuffer::marker = "I\n";
+
 BTreeIndexBuffer::BTreeIndexBuffer(int blockSz, int minCap) {
     blockSize = blockSz;
     minimumBlockCapacity = minCap;
 }
 
-int BTreeIndexBuffer::read(std::istream &stream, int headerRecordSize, int blockNumber) {
+BTreeIndexBuffer::BTreeIndexBuffer(const BTreeIndexBuffer &other) {
+    *this = other;
+}
+
+BTreeIndexBuffer &BTreeIndexBuffer::operator=(const BTreeIndexBuffer &other) {
+    if (this != &other) {
+        blockSize = other.blockSize;
+        minimumBlockCapacity = other.minimumBlockCapacity;
+        clear();
+        buffer << other.buffer.str();
+    }
+    return *this;
+}
+
+std::streamoff BTreeIndexBuffer::read(std::istream &stream, int headerRecordSize, int blockNumber) {
     // Move to location if needed
     if (blockNumber != -1) {
         stream.clear();
-        stream.seekg((blockNumber-1) * blockSize + headerRecordSize);
+        stream.seekg(HeaderBuffer::blockOffset(blockNumber, blockSize, headerRecordSize));
     }
 
     // check input stream
     if (!stream) return -1;
 
     // Get current location in stream
-    int addr = stream.tellg();
+    std::streamoff addr = stream.tellg();
 
     // Clear current buffer
     clear();
@@ -48,24 +67,18 @@ int BTreeIndexBuffer::read(std::istream &stream, int headerRecordSize, int block
     return addr;
 }
 
-int BTreeIndexBuffer::write(std::ostream &stream, int headerRecordSize, int blockNumber) {
+std::streamoff BTreeIndexBuffer::write(std::ostream &stream, int headerRecordSize, int blockNumber) {
     // Move to location if needed
     if (blockNumber != -1) {
-        stream.seekp((blockNumber-1) * blockSize + headerRecordSize);
+        stream.seekp(HeaderBuffer::blockOffset(blockNumber, blockSize, headerRecordSize));
     }
 
     // Get output location
-    int addr = stream.tellp();
+    std::streamoff addr = stream.tellp();
 
     // Write the buffer
-    string metadata = "I\n";
-    string str = metadata + buffer.str();
-
-    int sz = str.length();
-    int remainingSpace = blockSize - sz;
-    if (remainingSpace > 0) {
-        str += string(remainingSpace-1, ' '); str += '\n';
-    }
+    string str;
+    getImage(str);
     stream.write(str.c_str(), blockSize);
 
     // check stream
@@ -74,61 +87,242 @@ int BTreeIndexBuffer::write(std::ostream &stream, int headerRecordSize, int bloc
     return addr;
 }
 
-int BTreeIndexBuffer::unpack(std::vector<int>& separators, std::vector<int>& RBNs) {
+int BTreeIndexBuffer::getImage(std::string &image) const {
+    image = marker + buffer.str();
+
+    int sz = image.length();
+    int remainingSpace = blockSize - sz;
+    if (remainingSpace > 0) {
+        image += string(remainingSpace-1, ' '); image += '\n';
+    }
+    image.resize(blockSize);
+    return 0;
+}
+
+int BTreeIndexBuffer::unpack(std::vector<int>& separators, std::vector<int>& RBNs, int& nextRBN, int& highKey) {
     std::string buf = buffer.str();
+    TreeStats::add(TreeStats::BYTES_PARSED, buf.size());
 
     size_t semicolonPos = buf.find(';');
     if (semicolonPos == std::string::npos) {
         return -1;
     }
 
-    std::string keysStr = buf.substr(2, semicolonPos);
-    std::string RBNsStr = buf.substr(semicolonPos + 1);
+    // Skip the "I" marker line when present
+    size_t start = buf.compare(0, 2, "I\n") == 0 ? 2 : 0;
+    std::string keysStr = buf.substr(start, semicolonPos - start);
+    // Nodes written before sibling links were kept end after the RBNs
+    size_t linkPos = buf.find(';', semicolonPos + 1);
+    std::string RBNsStr = buf.substr(semicolonPos + 1, linkPos == std::string::npos ? std::string::npos : linkPos - semicolonPos - 1);
 
     auto splitAndConvertToInt = [](const std::string& str, char delimiter) {
         std::vector<int> result;
         std::stringstream ss(str);
         std::string item;
         while (std::getline(ss, item, delimiter)) {
+            if (item.find_first_of("0123456789") == std::string::npos) continue;
             result.push_back(std::stoi(item));
         }
         return result;
     };
 
-    separators = splitAndConvertToInt(keysStr, ',');
+    // Prefix compressed separators start with a marker, see encodeSeparators
+    if (!keysStr.empty() && keysStr[0] == '~') {
+        if (decodeSeparators(keysStr, separators) == -1) return -1;
+    } else {
+        separators = splitAndConvertToInt(keysStr, ',');
+    }
     RBNs = splitAndConvertToInt(RBNsStr, ',');
 
+    nextRBN = 0;
+    highKey = -1;
+    if (linkPos != std::string::npos) {
+        std::vector<int> link = splitAndConvertToInt(buf.substr(linkPos + 1), ',');
+        if (link.size() == 2) {
+            nextRBN = link[0];
+            highKey = link[1];
+        }
+    }
+
     return 0;
 }
 
-int BTreeIndexBuffer::pack(std::vector<int> seperators, std::vector<int> RBNs) {
+int BTreeIndexBuffer::pack(std::vector<int> seperators, std::vector<int> RBNs, int nextRBN, int highKey) {
+    string buf = encode(seperators, RBNs, nextRBN, highKey);
+
+    if (marker.size() + buffer.str().size() + buf.size() <= blockSize) {
+        buffer << buf;
+        return 0;
+    }
+
+    return -1;
+}
+
+int BTreeIndexBuffer::packedSize(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey) const {
+    return marker.size() + encodedSize(separators, RBNs, nextRBN, highKey);
+}
+
+bool BTreeIndexBuffer::canPack(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey) const {
+    return packedSize(separators, RBNs, nextRBN, highKey) <= blockSize;
+}
+
+bool BTreeIndexBuffer::canInsert(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey) const {
+    // The plain encoding bounds the packed size, and one more key and child add at most
+    // two numbers and two commas to it
+    int plainSize = marker.size() + joinedSize(separators) + joinedSize(RBNs)
+                    + intSize(nextRBN) + intSize(highKey) + 4;
+    return plainSize + 2 * (maxIntDigits + 1) <= blockSize;
+}
+
+std::string BTreeIndexBuffer::encode(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey) {
+    string plain = joinInts(separators);
+    string compressed = encodeSeparators(separators);
+    string buf = !compressed.empty() && compressed.size() < plain.size() ? compressed : plain;
+
+    buf += ";" + joinInts(RBNs);
+    buf += ";" + to_string(nextRBN) + "," + to_string(highKey);
+    buf += "\n";
+    return buf;
+}
+
+int BTreeIndexBuffer::encodedSize(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey) {
+    // Sized the way encode builds the line, so checking whether a node fits makes no strings
+    int plain = joinedSize(separators);
+    int compressed = separatorsSize(separators);
+    int size = compressed > 0 && compressed < plain ? compressed : plain;
+
+    return size + 1 + joinedSize(RBNs) + 1 + intSize(nextRBN) + 1 + intSize(highKey) + 1;
+}
+
+int BTreeIndexBuffer::intSize(int value) {
+    long long magnitude = value;
+    int size = 1;
+    if (magnitude < 0) {
+        magnitude = -magnitude;
+        size++;
+    }
+    while (magnitude >= 10) {
+        magnitude /= 10;
+        size++;
+    }
+    return size;
+}
+
+int BTreeIndexBuffer::joinedSize(const std::vector<int>& values) {
+    int size = values.empty() ? 0 : static_cast<int>(values.size()) - 1;
+    for (int value : values) {
+        size += intSize(value);
+    }
+    return size;
+}
+
+int BTreeIndexBuffer::separatorsSize(const std::vector<int>& separators) {
+    if (separators.empty()) return 0;
+
+    int width = 0;
+    for (int separator : separators) {
+        if (separator < 0) return 0;
+        width = std::max(width, intSize(separator));
+    }
+
+    // Digit i of a separator padded to the width, counting from the left
+    auto digitAt = [width](int value, int i) {
+        for (int shift = width - 1 - i; shift > 0; shift--) value /= 10;
+        return value % 10;
+    };
+
+    int prefixLength = 0;
+    while (prefixLength < width &&
+           digitAt(separators.front(), prefixLength) == digitAt(separators.back(), prefixLength)) {
+        prefixLength++;
+    }
+
+    // Each suffix drops its trailing zeros, a separator of all zeros leaves an empty one
+    int size = 1 + intSize(width) + 1 + prefixLength + 1 + static_cast<int>(separators.size()) - 1;
+    for (int separator : separators) {
+        int trailingZeros = 0;
+        int value = separator;
+        while (trailingZeros < width && value % 10 == 0) {
+            value /= 10;
+            trailingZeros++;
+        }
+        size += std::max(0, width - prefixLength - trailingZeros);
+    }
+    return size;
+}
 
+std::string BTreeIndexBuffer::joinInts(const std::vector<int>& values) {
     string buf;
 
-    for (int i = 0; i < seperators.size(); i++) {
-        buf += to_string(seperators[i]);
-        if (i < seperators.size()-1) {
+    for (int i = 0; i < values.size(); i++) {
+        buf += to_string(values[i]);
+        if (i < values.size()-1) {
             buf += ",";
         }
     }
 
-    buf += ";";
+    return buf;
+}
+
+std::string BTreeIndexBuffer::encodeSeparators(const std::vector<int>& separators) {
+    if (separators.empty()) return "";
+
+    // Pad every separator to the same number of digits
+    size_t width = 0;
+    for (int separator : separators) {
+        if (separator < 0) return "";
+        width = std::max(width, to_string(separator).size());
+    }
+    vector<string> padded;
+    for (int separator : separators) {
+        string digits = to_string(separator);
+        padded.push_back(string(width - digits.size(), '0') + digits);
+    }
+
+    // Separators are sorted, so the prefix shared by the first and last is shared by all
+    size_t prefixLength = 0;
+    while (prefixLength < width && padded.front()[prefixLength] == padded.back()[prefixLength]) {
+        prefixLength++;
+    }
 
-    for (int i = 0; i < RBNs.size(); i++) {
-        buf += to_string(RBNs[i]);
-        if (i < RBNs.size()-1) {
+    // Store only what follows the prefix, with trailing zeros dropped since the width restores them
+    string buf = "~" + to_string(width) + ":" + padded.front().substr(0, prefixLength) + ":";
+    for (int i = 0; i < padded.size(); i++) {
+        string suffix = padded[i].substr(prefixLength);
+        suffix.erase(suffix.find_last_not_of('0') + 1);
+        buf += suffix;
+        if (i < padded.size()-1) {
             buf += ",";
         }
     }
 
-    buf += "\n";
+    return buf;
+}
 
-    if (buffer.str().size() +  buf.size() <= blockSize) {
-        buffer << buf;
-        return 0;
+int BTreeIndexBuffer::decodeSeparators(const std::string& keysStr, std::vector<int>& separators) {
+    separators.clear();
+
+    size_t widthEnd = keysStr.find(':');
+    size_t prefixEnd = keysStr.find(':', widthEnd == string::npos ? widthEnd : widthEnd + 1);
+    if (widthEnd == string::npos || prefixEnd == string::npos) return -1;
+
+    size_t width = stoi(keysStr.substr(1, widthEnd - 1));
+    string prefix = keysStr.substr(widthEnd + 1, prefixEnd - widthEnd - 1);
+
+    // Every separator has a suffix, even if it is empty
+    size_t start = prefixEnd + 1;
+    while (true) {
+        size_t end = keysStr.find(',', start);
+        string digits = prefix + keysStr.substr(start, end == string::npos ? string::npos : end - start);
+        if (digits.size() > width) return -1;
+        digits += string(width - digits.size(), '0');
+        separators.push_back(stoi(digits));
+
+        if (end == string::npos) break;
+        start = end + 1;
     }
 
-    return -1;
+    return 0;
 }
 
 void BTreeIndexBuffer::clear() {
@@ -7,6 +7,9 @@
  * @class BTreeIndexBuffer
  * @brief A class for managing a buffer for a files header information.
  * @details: This class provides methods to read and write header information from/to an input/output stream.
+ * Separators are stored prefix compressed when that is shorter: they are padded to a common number
+ * of digits, the digits every separator shares are written once, and each separator keeps only the
+ * digits after them with trailing zeros dropped, e.g. "~5:55:01,1,15" for 55010, 55100 and 55150.
  * Features: Reads and writes header information from/to input/output streams.
  * Assumptions: Assumes the input stream and output stream provided are valid and open.
  */
@@ -16,6 +19,8 @@
 
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
 #include "RecordBuffer.h"
 
 class BTreeIndexBuffer {
@@ -27,6 +32,19 @@ public:
      */
     BTreeIndexBuffer(int blockSz = 512, int minCap = 256);
 
+    /**
+     * @brief Copy constructor, copies the buffered index contents.
+     * @param other The index buffer to copy.
+     */
+    BTreeIndexBuffer(const BTreeIndexBuffer &other);
+
+    /**
+     * @brief Copy assignment, copies the buffered index contents.
+     * @param other The index buffer to copy.
+     * @return Reference to this index buffer.
+     */
+    BTreeIndexBuffer &operator=(const BTreeIndexBuffer &other);
+
     /**
      * @brief Reads index data from an input stream.
      * @param stream The input stream to read from.
@@ -34,7 +52,7 @@ public:
      * @param blockNumber The block number to read.
      * @return The address where the read operation occurred.
      */
-    int read(std::istream & stream, int headerRecordSize, int blockNumber = -1);
+    std::streamoff read(std::istream & stream, int headerRecordSize, int blockNumber = -1);
 
     /**
      * @brief Writes index data to an output stream.
@@ -43,23 +61,56 @@ public:
      * @param blockNumber The block number to write to.
      * @return The address where the write operation occurred.
      */
-    int write(std::ostream & stream, int headerRecordSize, int blockNumber = -1);
+    std::streamoff write(std::ostream & stream, int headerRecordSize, int blockNumber = -1);
+
+    /**
+     * @brief Builds the bytes write would store for the block.
+     * @param image String to store the block in, exactly one block long.
+     * @return 0, an index block always fits.
+     */
+    int getImage(std::string &image) const;
 
     /**
      * @brief Unpacks the buffer content into vectors of separators and RBNs.
      * @param separators Vector to store the separators.
      * @param RBNs Vector to store the RBNs (relative block numbers).
+     * @param nextRBN Stores the right sibling link, 0 if there is none.
+     * @param highKey Stores the largest key that belongs under the node, -1 if unbounded.
      * @return 0 on success, -1 if the format is incorrect.
      */
-    int unpack(std::vector<int>& seperators, std::vector<int>& RBNs);
+    int unpack(std::vector<int>& seperators, std::vector<int>& RBNs, int& nextRBN, int& highKey);
 
     /**
      * @brief Packs vectors of separators and RBNs into the buffer.
      * @param separators Vector of separators.
      * @param RBNs Vector of RBNs.
+     * @param nextRBN The right sibling link, 0 if there is none.
+     * @param highKey The largest key that belongs under the node, -1 if unbounded.
      * @return 0 on success, -1 if the buffer size exceeds the block size.
      */
-    int pack(std::vector<int> seperators, std::vector<int> RBNs);
+    int pack(std::vector<int> seperators, std::vector<int> RBNs, int nextRBN = 0, int highKey = -1);
+
+    /**
+     * @brief Gets the number of bytes an index node takes in a block.
+     * @param separators Vector of separators.
+     * @param RBNs Vector of RBNs.
+     * @param nextRBN The right sibling link.
+     * @param highKey The largest key that belongs under the node.
+     * @return The packed size in bytes, including the index marker.
+     */
+    int packedSize(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey) const;
+
+    /**
+     * @brief Checks whether an index node fits in a block.
+     * @return True if packedSize is at most the block size.
+     */
+    bool canPack(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey) const;
+
+    /**
+     * @brief Checks whether an index node is sure to fit in a block after one more separator and child.
+     * @return True if any separator and child could be inserted without a split.
+     */
+    bool canInsert(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey) const;
 
     /**
      * @brief Clears the buffer.
@@ -73,6 +124,64 @@ private:
     int minimumBlockCapacity; /**< Stores the minimum block size as int */
     int numSeparators;        /**< Stores the number of separators */
     int lengthSeparators;     /**< Stores the length of separators */
+
+    static const std::string marker;     /**< Line that marks a block as an index block */
+    static const int maxIntDigits = 11;  /**< Most characters an int takes as text, with its sign */
+
+    /**
+     * @brief Encodes an index node as its line of text.
+     * @return The separators, RBNs and sibling link, separated by semicolons.
+     */
+    static std::string encode(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey);
+
+    /**
+     * @brief Gets the length of the line encode would make, without making it.
+     * @return The number of characters in the line.
+     */
+    static int encodedSize(const std::vector<int>& separators, const std::vector<int>& RBNs, int nextRBN, int highKey);
+
+    /**
+     * @brief Gets the number of characters an integer takes as text.
+     * @param value The integer.
+     * @return The length of to_string(value).
+     */
+    static int intSize(int value);
+
+    /**
+     * @brief Gets the length of the list joinInts would make.
+     * @param values The integers to join.
+     * @return The number of characters in the list.
+     */
+    static int joinedSize(const std::vector<int>& values);
+
+    /**
+     * @brief Gets the length of the text encodeSeparators would make.
+     * @param separators The separators in ascending order.
+     * @return The number of characters, 0 if the separators cannot be compressed.
+     */
+    static int separatorsSize(const std::vector<int>& separators);
+
+    /**
+     * @brief Joins integers with commas.
+     * @param values The integers to join.
+     * @return The comma separated list.
+     */
+    static std::string joinInts(const std::vector<int>& values);
+
+    /**
+     * @brief Prefix compresses sorted separators.
+     * @param separators The separators in ascending order.
+     * @return The compressed form, or an empty string if the separators cannot be compressed.
+     */
+    static std::string encodeSeparators(const std::vector<int>& separators);
+
+    /**
+     * @brief Decodes separators written by encodeSeparators.
+     * @param keysStr The compressed separators.
+     * @param separators Vector to store the separators.
+     * @return 0 on success, -1 if the format is incorrect.
+     */
+    static int decodeSeparators(const std::string& keysStr, std::vector<int>& separators);
 };
 
 #endif //CSCI331_PROJECT4_BTREEINDEXBUFFER
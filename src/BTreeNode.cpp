@@ -4,64 +4,185 @@
  */
 
 #include "BTreeNode.h"
+#include "HeaderBuffer.h"
+#include "BlockCodec.h"
+#include "BlockChecksum.h"
+#include "TreeStats.h"
 #include <iostream>
+#include <sstream>
 #include <algorithm>
 
 using namespace std;
 
-BTreeNode::BTreeNode(int maxKeys) : maxKeys(maxKeys), minKeys(maxKeys / 2) {
+// Room left in a compressed block for the codec to do slightly worse on a changed leaf
+static const int compressedSlack = 32;
+
+// Room kept in a full compressed leaf, so relinking it to a new neighbor cannot push it out of its block
+static const int linkSlack = 8;
+
+// Bytes a checksummed block keeps for its checksum, the rest holds the node
+static int checksumBytes(bool checksummed) {
+    return checksummed ? BlockChecksum::size : 0;
+}
+
+BTreeNode::BTreeNode(int maxKeys, int blockSize, int minCap, BlockBuffer::Encoding leafEncoding,
+                     int compressedBlockSize, bool checksummed)
+    : blockBuffer(compressedBlockSize > 0 ? blockSize : blockSize - checksumBytes(checksummed), minCap, leafEncoding),
+      bTreeIndexBuffer((compressedBlockSize > 0 ? compressedBlockSize : blockSize) - checksumBytes(checksummed), minCap),
+      curRBN(0), maxKeys(maxKeys), minKeys(maxKeys / 2), numKeys(0),
+      compressedBlockSize(compressedBlockSize > 0 ? compressedBlockSize - checksumBytes(checksummed) : 0),
+      compressedBytes(-1), checksummed(checksummed),
+      diskBlockSize(compressedBlockSize > 0 ? compressedBlockSize : blockSize) {
     isLeaf = true;
+    nextRBN = 0;
+    highKey = -1;
 }
 
-int BTreeNode::read(std::istream& stream, int headerRecordSize, int RBN) {
-    int addr = bTreeIndexBuffer.read(stream, headerRecordSize, RBN);
+std::streamoff BTreeNode::read(std::istream& stream, int headerRecordSize, int RBN) {
+    compressedBytes = -1;
+    TreeStats::add(TreeStats::BLOCK_READS);
+    if (compressedBlockSize == 0 && !checksummed) {
+        return readImage(stream, headerRecordSize, RBN);
+    }
+
+    stream.clear();
+    std::streamoff addr = HeaderBuffer::blockOffset(RBN, diskBlockSize, headerRecordSize);
+    stream.seekg(addr);
+    string block(diskBlockSize, '\0');
+    stream.read(&block[0], diskBlockSize);
+    if (!stream) return -1;
+
+    // A torn or damaged block is refused here, before it can enter the cache
+    if (checksummed) {
+        if (!BlockChecksum::verify(block)) return -1;
+        block.resize(diskBlockSize - BlockChecksum::size);
+    }
+
+    // Index blocks are stored as they are, and blocks never written are all zeros
+    string image;
+    if (compressedBlockSize == 0 || BlockCodec::unpackBlock(block, image) == -1) {
+        image = std::move(block);
+    }
+    image.resize(blockBuffer.getBlockSize(), '\0');
+
+    istringstream in(image);
+    std::streamoff status = readImage(in, 0, 1);
+    setCurRBN(RBN);
+    return status == -1 ? -1 : addr;
+}
+
+std::streamoff BTreeNode::readImage(std::istream& stream, int headerRecordSize, int RBN) {
+    std::streamoff addr = bTreeIndexBuffer.read(stream, headerRecordSize, RBN);
     if (addr != -1) {
-        curRBN = addr / headerRecordSize;
-        bTreeIndexBuffer.unpack(keys, children);
+        curRBN = RBN;
+        bTreeIndexBuffer.unpack(keys, children, nextRBN, highKey);
         numKeys = keys.size();
         isLeaf = false;
+
+        // A node read into again may have been a leaf, which must not show through
+        blockBuffer.clear();
+        blockBuffer.setPrevRBN(0);
+        blockBuffer.setNextRBN(0);
+        blockBuffer.setHighKey(-1);
     } else {
+        isLeaf = true;
+        keys.clear();
+        children.clear();
+        numKeys = 0;
+        nextRBN = 0;
+        highKey = -1;
         return blockBuffer.read(stream, headerRecordSize, RBN);
     }
 
     return addr;
 }
 
-int BTreeNode::write(std::ostream& stream, int headerRecordSize, int RBN) {
+std::streamoff BTreeNode::write(std::ostream& stream, int headerRecordSize, int RBN) {
+    TreeStats::add(TreeStats::BLOCK_WRITES);
+    if (compressedBlockSize == 0 && !checksummed) {
+        if (isLeaf) {
+            return blockBuffer.write(stream, headerRecordSize, RBN);
+        }
+        bTreeIndexBuffer.clear();
+        bTreeIndexBuffer.pack(keys, children, nextRBN, highKey);
+        std::streamoff addr = bTreeIndexBuffer.write(stream, headerRecordSize, RBN);
+        if (RBN != -1) curRBN = RBN;
+        return addr;
+    }
+
+    string block;
     if (isLeaf) {
-        return blockBuffer.write(stream, headerRecordSize, RBN);
+        string image;
+        if (blockBuffer.getImage(image) == -1) return -1;
+        if (compressedBlockSize > 0) {
+            if (BlockCodec::packBlock(image, block) > compressedBlockSize) return -1;
+            block.resize(compressedBlockSize, '\0');
+        } else {
+            block = std::move(image);
+        }
     } else {
         bTreeIndexBuffer.clear();
-        bTreeIndexBuffer.pack(keys, children);
-        int addr = bTreeIndexBuffer.write(stream, headerRecordSize, RBN);
-        curRBN = addr / headerRecordSize;
-        return addr;
+        bTreeIndexBuffer.pack(keys, children, nextRBN, highKey);
+        bTreeIndexBuffer.getImage(block);
+    }
+    if (checksummed) {
+        BlockChecksum::stamp(block);
     }
+
+    std::streamoff addr = HeaderBuffer::blockOffset(RBN, diskBlockSize, headerRecordSize);
+    stream.seekp(addr);
+    stream.write(block.data(), diskBlockSize);
+    if (!stream) return -1;
+    setCurRBN(RBN);
+    return addr;
 }
 
 int BTreeNode::insertRecord(RecordBuffer& recordBuffer) {
-    if (!isLeaf || blockBuffer.pack(recordBuffer) == -1 || blockBuffer.sortBuffer() == -1 || blockBuffer.isOverFilled()) {
+    compressedBytes = -1;
+    if (!isLeaf) {
+        return -1;
+    }
+
+    // The record takes the place of its tombstone, so the two never end up either side of a split
+    blockBuffer.purgeTombstones(recordBuffer.getRecordKey());
+    if (blockBuffer.pack(recordBuffer) == -1 || isOverFilled()) {
         return -1;
     }
     return 0;
 }
 
 int BTreeNode::removeRecord(RecordBuffer& recordBuffer) {
+    compressedBytes = -1;
     if (!isLeaf || blockBuffer.removeRecord(recordBuffer.getRecordKey()) == -1 || blockBuffer.isUnderFilled()) {
         return -1;
     }
     return 0;
 }
 
+int BTreeNode::markDeleted(int key) {
+    compressedBytes = -1;
+    if (!isLeaf || blockBuffer.markDeleted(key) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+int BTreeNode::purgeTombstones() {
+    compressedBytes = -1;
+    return isLeaf ? blockBuffer.purgeTombstones() : 0;
+}
+
+int BTreeNode::getTombstoneBytes() {
+    return isLeaf ? blockBuffer.getTombstoneBytes() : 0;
+}
+
 int BTreeNode::retrieveRecord(RecordBuffer& recordBuffer, int key) {
-    while(blockBuffer.unpack(recordBuffer) != -1) {
-        if (recordBuffer.getRecordKey() == key) {
-            return 0;
-        }
+    if (!isLeaf) {
+        recordBuffer.clear();
+        return -1;
     }
 
-    recordBuffer.clear();
-    return -1;
+    return blockBuffer.findRecord(recordBuffer, key);
 }
 
 int BTreeNode::insertKeyAndChildren(int key, int child1, int child2) {
@@ -94,23 +215,53 @@ int BTreeNode::removeKeyAndChildren(int key, int child) {
         return -1;
     }
 
+    auto childIt = std::find(children.begin(), children.end(), child);
+    if (childIt == children.end()) {
+        return -1;
+    }
+
     keys.erase(it);
+    children.erase(childIt);
     numKeys--;
+    return 0;
+}
+
+int BTreeNode::swapChildren(int firstRBN, int secondRBN) {
+    vector<int> swapped = children;
+    int changed = 0;
+    for (int &child : swapped) {
+        if (child == firstRBN) {
+            child = secondRBN;
+            changed++;
+        } else if (child == secondRBN) {
+            child = firstRBN;
+            changed++;
+        }
+    }
 
-    it = std::find(children.begin(), children.end(), child);
-    if (it == children.end()) {
+    // Index nodes fill by packed size, so a longer RBN may no longer fit
+    if (!bTreeIndexBuffer.canPack(keys, swapped, nextRBN, highKey)) {
         return -1;
     }
+    children = swapped;
+    return changed;
+}
 
-    children.erase(it);
+int BTreeNode::replaceKey(int oldKey, int newKey) {
+    auto it = std::find(keys.begin(), keys.end(), oldKey);
+    if (it == keys.end()) {
+        return -1;
+    }
+
+    *it = newKey;
     return 0;
 }
 
 void BTreeNode::print(std::ostream &stream) {
     if (isLeaf) {
-        cout << "LEAF NODE: LARGEST KEY = " << getLargestKey() << endl;
+        stream << "LEAF NODE: LARGEST KEY = " << getLargestKey() << endl;
     } else {
-        cout << "INDEX NODE: RBN = " << getCurRBN() << ", KEYS = ";
+        stream << "INDEX NODE: RBN = " << getCurRBN() << ", KEYS = ";
         for (int key : keys) {
             stream << key << " ";
         }
@@ -119,22 +270,32 @@ void BTreeNode::print(std::ostream &stream) {
 }
 
 int BTreeNode::split(BTreeNode *newNode) {
+    TreeStats::add(TreeStats::SPLITS);
+    compressedBytes = -1;
+    newNode->compressedBytes = -1;
+
     if (isLeaf) {
         blockBuffer.splitBuffer(newNode->blockBuffer);
+        int separator = shortestSeparator(blockBuffer.getLargestKey(), newNode->blockBuffer.getSmallestKey());
+        newNode->blockBuffer.setHighKey(blockBuffer.getHighKey());
+        blockBuffer.setHighKey(separator);
+        return separator;
     } else {
         int midIndex = keys.size() / 2;
         int splitKey = keys[midIndex];  // The key to move up to the parent
 
-        // Move the right half of the keys to the new node
-        for (int i = midIndex + 1; i < keys.size(); i++) {
-            newNode->keys.push_back(keys[i]);
-            newNode->children.push_back(children[i]);
-        }
-        newNode->children.push_back(children[keys.size()]);
+        // Move the keys right of the split key, and the children they bound, to the new node
+        newNode->isLeaf = false;
+        newNode->keys.assign(keys.begin() + midIndex + 1, keys.end());
+        newNode->children.assign(children.begin() + midIndex + 1, children.end());
+        newNode->numKeys = newNode->keys.size();
+        newNode->highKey = highKey;
+        highKey = splitKey;
 
-        // Adjust the original node
-        keys.erase(keys.begin() + midIndex + 1, keys.end());
+        // Adjust the original node, the split key now lives only in the parent
+        keys.erase(keys.begin() + midIndex, keys.end());
         children.erase(children.begin() + midIndex + 1, children.end());
+        numKeys = keys.size();
 
         return splitKey;
     }
@@ -142,27 +303,89 @@ int BTreeNode::split(BTreeNode *newNode) {
     return -1;
 }
 
-int BTreeNode::merge(BTreeNode *fromNode) {
+int BTreeNode::merge(BTreeNode *fromNode, int separator) {
+    compressedBytes = -1;
+
     if (isLeaf) {
         blockBuffer.mergeBuffer(fromNode->blockBuffer);
+        blockBuffer.setHighKey(fromNode->blockBuffer.getHighKey());
     } else {
+        highKey = fromNode->highKey;
+        // The separator comes down from the parent between the two key ranges
+        keys.push_back(separator);
         for (auto key : fromNode->keys) {
             keys.push_back(key);
         }
         for (auto child : fromNode->children) {
-            keys.push_back(child);
+            children.push_back(child);
         }
+        numKeys = keys.size();
     }
 
     return 0;
 }
 
+int BTreeNode::redistribute(BTreeNode *rightNode, int separator) {
+    compressedBytes = -1;
+    rightNode->compressedBytes = -1;
+
+    if (isLeaf) {
+        BlockBuffer::redistributeBuffers({&blockBuffer, &rightNode->blockBuffer});
+        int newSeparator = shortestSeparator(blockBuffer.getLargestKey(), rightNode->blockBuffer.getSmallestKey());
+        blockBuffer.setHighKey(newSeparator);
+        return newSeparator;
+    }
+
+    // The separator comes down between the two key ranges and a new one goes back up
+    vector<int> allKeys = keys;
+    allKeys.push_back(separator);
+    allKeys.insert(allKeys.end(), rightNode->keys.begin(), rightNode->keys.end());
+    vector<int> allChildren = children;
+    allChildren.insert(allChildren.end(), rightNode->children.begin(), rightNode->children.end());
+
+    vector<int> separators;
+    shareIndexEntries({this, rightNode}, allKeys, allChildren, separators);
+    highKey = separators[0];
+    return separators[0];
+}
+
+int BTreeNode::splitThree(BTreeNode *rightNode, BTreeNode *newNode, int separator, int &newSeparator) {
+    compressedBytes = -1;
+    rightNode->compressedBytes = -1;
+    newNode->compressedBytes = -1;
+
+    if (isLeaf) {
+        BlockBuffer::redistributeBuffers({&blockBuffer, &rightNode->blockBuffer, &newNode->blockBuffer});
+        int firstSeparator = shortestSeparator(blockBuffer.getLargestKey(), rightNode->blockBuffer.getSmallestKey());
+        newSeparator = shortestSeparator(rightNode->blockBuffer.getLargestKey(), newNode->blockBuffer.getSmallestKey());
+        newNode->blockBuffer.setHighKey(rightNode->blockBuffer.getHighKey());
+        rightNode->blockBuffer.setHighKey(newSeparator);
+        blockBuffer.setHighKey(firstSeparator);
+        return firstSeparator;
+    }
+
+    vector<int> allKeys = keys;
+    allKeys.push_back(separator);
+    allKeys.insert(allKeys.end(), rightNode->keys.begin(), rightNode->keys.end());
+    vector<int> allChildren = children;
+    allChildren.insert(allChildren.end(), rightNode->children.begin(), rightNode->children.end());
+
+    vector<int> separators;
+    shareIndexEntries({this, rightNode, newNode}, allKeys, allChildren, separators);
+    newNode->highKey = rightNode->highKey;
+    rightNode->highKey = separators[1];
+    highKey = separators[0];
+    newSeparator = separators[1];
+    return separators[0];
+}
+
 bool BTreeNode::getIsLeaf() {
     return isLeaf;
 }
 
 void BTreeNode::setIsLeaf(bool isL) {
     isLeaf = isL;
+    compressedBytes = -1;
 }
 
 int BTreeNode::getNextChild(int key) {
@@ -184,6 +407,14 @@ std::vector<int> BTreeNode::getChildren() {
     return children;
 }
 
+std::vector<int> BTreeNode::getKeys() {
+    return keys;
+}
+
+const BlockBuffer &BTreeNode::getBlockBuffer() const {
+    return blockBuffer;
+}
+
 int BTreeNode::getLargestKey() {
     if (isLeaf) {
         return blockBuffer.getLargestKey();
@@ -198,11 +429,8 @@ int BTreeNode::getLargestKey() {
 
 
 void BTreeNode::setCurRBN(int rbn) {
-    if (isLeaf) {
-        blockBuffer.setCurRBN(rbn);
-    } else {
-        curRBN = rbn;
-    }
+    blockBuffer.setCurRBN(rbn);
+    curRBN = rbn;
 }
 
 int BTreeNode::getCurRBN() {
@@ -220,6 +448,7 @@ int BTreeNode::getPrevRBN() {
 }
 
 void BTreeNode::setPrevRBN(int rbn) {
+    compressedBytes = -1;
     if (isLeaf) {
         blockBuffer.setPrevRBN(rbn);
     }
@@ -228,17 +457,51 @@ void BTreeNode::setPrevRBN(int rbn) {
 int BTreeNode::getNextRBN() {
     if (isLeaf) {
         return blockBuffer.getNextRBN();
-    } else return -1;
+    } else return nextRBN;
 }
 
 void BTreeNode::setNextRBN(int rbn) {
+    compressedBytes = -1;
     if (isLeaf) {
         blockBuffer.setNextRBN(rbn);
+    } else {
+        nextRBN = rbn;
     }
 }
 
+int BTreeNode::getHighKey() {
+    if (isLeaf) {
+        return blockBuffer.getHighKey();
+    } else return highKey;
+}
+
+void BTreeNode::setHighKey(int key) {
+    compressedBytes = -1;
+    if (isLeaf) {
+        blockBuffer.setHighKey(key);
+    } else {
+        highKey = key;
+    }
+}
+
+bool BTreeNode::isBeyondHighKey(int key) {
+    int high = getHighKey();
+    return high != -1 && key > high && getNextRBN() != 0;
+}
+
 bool BTreeNode::isOverFilled() {
-    return numKeys > maxKeys;
+    bool overFilled;
+    if (isLeaf) {
+        overFilled = blockBuffer.isOverFilled();
+    } else {
+        overFilled = !bTreeIndexBuffer.canPack(keys, children, nextRBN, highKey);
+    }
+
+    // A compressed leaf is also full once it no longer compresses into a block
+    if (!overFilled && compressedBlockSize > 0 && isLeaf) {
+        overFilled = getCompressedSize() + linkSlack > compressedBlockSize;
+    }
+    return overFilled;
 }
 
 bool BTreeNode::isUnderFilled() {
@@ -248,3 +511,111 @@ bool BTreeNode::isUnderFilled() {
         return numKeys < minKeys;
     }
 }
+
+bool BTreeNode::isSafeForInsert(int recordSize) {
+    bool safe;
+    if (isLeaf) {
+        safe = blockBuffer.canPack(recordSize);
+    } else {
+        safe = bTreeIndexBuffer.canInsert(keys, children, nextRBN, highKey);
+    }
+
+    // The new record may not compress at all
+    if (safe && compressedBlockSize > 0 && isLeaf) {
+        safe = getCompressedSize() + recordSize + compressedSlack <= compressedBlockSize;
+    }
+    return safe;
+}
+
+bool BTreeNode::isSafeForRemove(int recordSize) {
+    if (isLeaf) {
+        return blockBuffer.canUnpack(recordSize);
+    } else {
+        return numKeys > minKeys;
+    }
+}
+
+bool BTreeNode::canMerge(BTreeNode *fromNode, int separator) {
+    bool fits;
+    if (isLeaf) {
+        fits = blockBuffer.canMerge(fromNode->blockBuffer);
+    } else {
+        vector<int> mergedKeys = keys;
+        vector<int> mergedChildren = children;
+        mergedKeys.push_back(separator);
+        mergedKeys.insert(mergedKeys.end(), fromNode->keys.begin(), fromNode->keys.end());
+        mergedChildren.insert(mergedChildren.end(), fromNode->children.begin(), fromNode->children.end());
+        fits = bTreeIndexBuffer.canPack(mergedKeys, mergedChildren, fromNode->nextRBN, fromNode->highKey);
+    }
+
+    // Compressing the two together does about as well as compressing each on its own
+    if (fits && compressedBlockSize > 0 && isLeaf) {
+        fits = getCompressedSize() + fromNode->getCompressedSize() + compressedSlack <= compressedBlockSize;
+    }
+    return fits;
+}
+
+double BTreeNode::getFill() {
+    if (!isLeaf) {
+        int indexBlockSize = compressedBlockSize > 0 ? compressedBlockSize : blockBuffer.getBlockSize();
+        return static_cast<double>(bTreeIndexBuffer.packedSize(keys, children, nextRBN, highKey)) / indexBlockSize;
+    }
+
+    // A compressed leaf is measured against the block it is written to
+    if (compressedBlockSize > 0) {
+        return static_cast<double>(getCompressedSize()) / compressedBlockSize;
+    }
+    return blockBuffer.getFill();
+}
+
+int BTreeNode::getCompressedSize() {
+    if (compressedBytes == -1) {
+        string image, block;
+        if (blockBuffer.getImage(image) == -1) {
+            // Too large for even the uncompressed block, so certainly too large to write
+            return compressedBlockSize + 1;
+        }
+        compressedBytes = BlockCodec::packBlock(image, block);
+    }
+    return compressedBytes;
+}
+
+void BTreeNode::shareIndexEntries(const vector<BTreeNode*> &nodes, const vector<int> &allKeys,
+                                  const vector<int> &allChildren, vector<int> &separators) {
+    separators.clear();
+
+    // Earlier nodes take one more child when they do not divide evenly
+    size_t next = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        size_t remaining = nodes.size() - i;
+        size_t share = (allChildren.size() - next + remaining - 1) / remaining;
+
+        BTreeNode *node = nodes[i];
+        node->isLeaf = false;
+        node->children.assign(allChildren.begin() + next, allChildren.begin() + next + share);
+        node->keys.assign(allKeys.begin() + next, allKeys.begin() + next + share - 1);
+        node->numKeys = node->keys.size();
+        next += share;
+
+        // The key between this node's last child and the next node's first moves up
+        if (i + 1 < nodes.size()) {
+            separators.push_back(allKeys[next - 1]);
+        }
+    }
+}
+
+int BTreeNode::shortestSeparator(int largestLeft, int smallestRight) {
+    if (smallestRight <= largestLeft) {
+        return largestLeft;
+    }
+
+    // Round largestLeft up to the coarsest power of ten that still stays below smallestRight
+    for (long long power = 1000000000; power > 1; power /= 10) {
+        long long separator = (largestLeft + power - 1) / power * power;
+        if (separator < smallestRight) {
+            return static_cast<int>(separator);
+        }
+    }
+
+    return largestLeft;
+}
@@ -11,10 +11,20 @@ class BTreeNode {
 public:
     /**
     * @brief This is the constructor for the BtreeNodes
-    * @param maxKeys the maximum number of keys per node
+    * @param maxKeys the order of the tree, index nodes keep at least half this many keys
+    * @param blockSize the size of a block in bytes
+    * @param minCap the minimum number of bytes in a leaf block
+    * @param leafEncoding how leaf blocks are written
+    * @param compressedBlockSize the size of a block on disk when leaf blocks are compressed, 0 if they are not.
+    * blockSize is then the larger size a leaf may grow to in memory, see BlockCodec, and index nodes keep
+    * to compressedBlockSize and are stored as they are
+    * @param checksummed true if every block on disk ends in a checksum, see BlockChecksum. The node then
+    * fills the rest of the block
     * @post class object is initialized
     */
-    BTreeNode(int maxKeys);
+    BTreeNode(int maxKeys, int blockSize = 512, int minCap = 256,
+              BlockBuffer::Encoding leafEncoding = BlockBuffer::TEXT, int compressedBlockSize = 0,
+              bool checksummed = false);
 
     /**
     * @brief This function reads the node from file
@@ -23,7 +33,7 @@ public:
     * @param RBN the block to read
     * @return  Returns -1 if there's an error, otherwise node is filled with data
     */
-    int read(std::istream& stream, int headerRecordSize, int RBN);
+    std::streamoff read(std::istream& stream, int headerRecordSize, int RBN);
 
     /**
     * @brief This function writes the node to the file
@@ -32,7 +42,7 @@ public:
     * @param RBN the block to write to
     * @return  Returns -1 if there's an error, otherwise node is written to stream
     */
-    int write(std::ostream& stream, int headerRecordSize, int RBN);
+    std::streamoff write(std::ostream& stream, int headerRecordSize, int RBN);
 
     /**
     * @brief This function inserts a record into the B tree
@@ -48,6 +58,25 @@ public:
     */
     int removeRecord(RecordBuffer& recordBuffer);
 
+    /**
+    * @brief This function replaces a record in a leaf with a tombstone, leaving the node no larger
+    * @param key the zipcode of the record to mark
+    * @return -1 if the node is not a leaf or holds no such record, 0 otherwise
+    */
+    int markDeleted(int key);
+
+    /**
+    * @brief This function removes the tombstones from a leaf
+    * @return the number of tombstones removed
+    */
+    int purgeTombstones();
+
+    /**
+    * @brief Gets the bytes the tombstones in a leaf take up
+    * @return 0 for index nodes and leaves without tombstones
+    */
+    int getTombstoneBytes();
+
     /**
     * @brief This function retrieves a record from the current buffer
     * @param recordBuffer is the buffer object to store record in.
@@ -73,6 +102,22 @@ public:
     */
     int removeKeyAndChildren(int key, int child);
 
+    /**
+    * @brief Swaps the links to two children whose nodes traded blocks.
+    * @param firstRBN one of the blocks
+    * @param secondRBN the other block
+    * @return -1 if the node would no longer fit in its block, the number of links changed otherwise
+    */
+    int swapChildren(int firstRBN, int secondRBN);
+
+    /**
+    * @brief Replaces a key of an index node with one that falls between the same neighbors.
+    * @param oldKey the key to replace
+    * @param newKey the key to put in its place
+    * @return -1 if the key is not found, 0 otherwise
+    */
+    int replaceKey(int oldKey, int newKey);
+
     /**
     * @brief This function prints the node to the output stream
     * @param stream the stream to print node to
@@ -82,17 +127,38 @@ public:
 
     /**
     * @brief This function shifts a node and it's children toward the root until the B tree becomes balanced
+    * @details A leaf split picks the shortest separator between its two halves rather than its largest key,
+    * see shortestSeparator, so index nodes hold separators with many trailing zeros that compress well.
     * @param newNode the node to place half of data into
-    * @return -1 if failed, 0 otherwise
+    * @return the separator to insert into the parent
     */
     int split(BTreeNode * newNode);
 
     /**
     * @brief This function merges two nodes together
-    * @param fromNode
+    * @param fromNode the right sibling to take keys, children or records from
+    * @param separator the parent key between the two index nodes, unused for leaves
     * @return -1 if failed, 0 otherwise
     */
-    int merge(BTreeNode * fromNode);
+    int merge(BTreeNode * fromNode, int separator = -1);
+
+    /**
+    * @brief This function evens out this node and its right sibling, moving entries across the boundary.
+    * @param rightNode the right sibling
+    * @param separator the parent key between the two nodes, used for index nodes
+    * @return the new separator between the two nodes
+    */
+    int redistribute(BTreeNode * rightNode, int separator = -1);
+
+    /**
+    * @brief This function shares this node and its right sibling out over three nodes, the new one last.
+    * @param rightNode the right sibling
+    * @param newNode the empty node that takes the top third
+    * @param separator the parent key between this node and rightNode, used for index nodes
+    * @param newSeparator stores the separator between rightNode and newNode
+    * @return the new separator between this node and rightNode
+    */
+    int splitThree(BTreeNode * rightNode, BTreeNode * newNode, int separator, int &newSeparator);
 
     /**
     * @brief This function returns the next node down the tree towards specific key
@@ -107,6 +173,18 @@ public:
     */
     std::vector<int> getChildren();
 
+    /**
+    * @brief Returns all stored keys
+    * @return a vector containing all keys
+    */
+    std::vector<int> getKeys();
+
+    /**
+    * @brief Gets the leaf's block buffer, for reading records without changing the node
+    * @return the block buffer of the node, valid while the node's frame is pinned and latched
+    */
+    const BlockBuffer &getBlockBuffer() const;
+
     /**
     * @brief This function returns the largest key in the key vector
     * @return the largest key in node
@@ -165,6 +243,26 @@ public:
     */
     void setNextRBN(int rbn);
 
+    /**
+    * @brief This function returns the node's high key, the largest key that belongs under it
+    * @return the high key, -1 if the node is last on its level
+    */
+    int getHighKey();
+
+    /**
+    * @brief Sets the high key
+    * @param key value to set the high key to, -1 for none
+    * @return nothing
+    */
+    void setHighKey(int key);
+
+    /**
+    * @brief This function returns whether a key has moved to the right sibling after a split
+    * @param key the key being searched for
+    * @return true if the key is larger than the high key and a right sibling exists
+    */
+    bool isBeyondHighKey(int key);
+
     /**
     * @brief This function returns whether a node is overfilled.
     * @return True if its too full, false otherwise
@@ -177,16 +275,83 @@ public:
     */
     bool isUnderFilled();
 
+    /**
+    * @brief This function returns whether an insert can never split this node.
+    * @param recordSize the size of the record being inserted, used for leaves
+    * @return true if the node is safe to release ancestors at, false otherwise
+    */
+    bool isSafeForInsert(int recordSize);
+
+    /**
+    * @brief This function returns whether a remove can never underfill this node.
+    * @param recordSize the size of the record being removed, used for leaves
+    * @return true if the node is safe to release ancestors at, false otherwise
+    */
+    bool isSafeForRemove(int recordSize);
+
+    /**
+    * @brief This function returns whether the right sibling fits in this node.
+    * @param fromNode the right sibling to merge
+    * @param separator the parent key between the two nodes, used for index nodes
+    * @return true if both nodes fit in one block, false otherwise
+    */
+    bool canMerge(BTreeNode * fromNode, int separator = -1);
+
+    /**
+    * @brief This function returns how much of its block on disk the node takes up.
+    * @return the bytes used over the block size, above 1 if the node is overfilled
+    */
+    double getFill();
+
+    /**
+    * @brief Picks the separator with the most trailing zeros between two halves of a split leaf.
+    * @param largestLeft the largest key that stays in the left node
+    * @param smallestRight the smallest key that moves to the right node
+    * @return a separator at least largestLeft and less than smallestRight
+    */
+    static int shortestSeparator(int largestLeft, int smallestRight);
+
 private:
     BlockBuffer blockBuffer;           /**< Stores the reference to a block buffer object */
     BTreeIndexBuffer bTreeIndexBuffer; /**< Stores the reference to a index buffer object */
     int curRBN;                        /**< Current RBN in file */
-    int maxKeys;                       /**< max number of keys to hold */
+    int maxKeys;                       /**< order of the tree, index nodes fill by block size */
     int minKeys;                       /**< min number of keys to hold */
     int numKeys;                       /**< current number of keys stored */
     bool isLeaf;                       /**< stores whether node is a leaf or not */
+    int nextRBN;                       /**< Right sibling of an index node, leaves keep theirs in the block */
+    int highKey;                       /**< High key of an index node, leaves keep theirs in the block */
     std::vector<int> keys;             /**< Stores the keys of node */
     std::vector<int> children;         /**< Stores the children of node */
+    int compressedBlockSize;           /**< Room for a compressed leaf on disk, 0 if leaves are not compressed */
+    int compressedBytes;               /**< Cached size of the leaf once compressed, -1 when it changed */
+    bool checksummed;                  /**< True if blocks on disk end in a checksum */
+    int diskBlockSize;                 /**< Size of a block on disk, checksum included */
+
+    /**
+    * @brief Reads the node from an uncompressed image of its block.
+    * @param stream the stream to read from
+    * @param headerRecordSize the size of header record
+    * @param RBN the block to read
+    * @return -1 if there's an error, the address read from otherwise
+    */
+    std::streamoff readImage(std::istream& stream, int headerRecordSize, int RBN);
+
+    /**
+    * @brief Returns the size of the leaf's block once compressed, caching it until the node changes.
+    * @return the number of bytes the compressed block takes, including its header
+    */
+    int getCompressedSize();
+
+    /**
+    * @brief Shares the children of neighboring index nodes out evenly between them.
+    * @param nodes the index nodes in key order, any of which may start out empty
+    * @param allKeys every key of the nodes, with the separators between them in place
+    * @param allChildren every child of the nodes, in order
+    * @param separators stores the keys left between the nodes, which go to their parent
+    */
+    static void shareIndexEntries(const std::vector<BTreeNode*> &nodes, const std::vector<int> &allKeys,
+                                  const std::vector<int> &allChildren, std::vector<int> &separators);
 };
 
 #endif //CSCI331_PROJECT3_BTREENODE_H
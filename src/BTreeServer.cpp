@@ -0,0 +1,310 @@
+/**
+ * @file BTreeServer.cpp
+ * @brief Implementation file for the BTreeServer class.
+ */
+
+#include "BTreeServer.h"
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Requests larger than this are treated as a protocol error
+static const uint32_t maxRequestSize = 1 << 20;
+
+volatile int BTreeServer::stopRequested = 0;
+
+/**
+ * Appends a 4 byte big endian integer to a string.
+ */
+static void appendUint32(string &out, uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+/**
+ * Reads a 4 byte big endian integer from a buffer.
+ */
+static uint32_t readUint32(const char *in) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(in);
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | bytes[3];
+}
+
+/**
+ * Appends a framed response holding a status and a payload.
+ */
+static void appendResponse(string &response, BTreeServer::Status status, const string &payload = "") {
+    appendUint32(response, payload.size() + 1);
+    response.push_back(static_cast<char>(status));
+    response += payload;
+}
+
+/**
+ * Writes all of a buffer to a non blocking socket, waiting for it to drain when full.
+ */
+static bool writeAll(int fd, const string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd pfd = {fd, POLLOUT, 0};
+            poll(&pfd, 1, 1000);
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+BTreeServer::BTreeServer(BTreeFile &bTreeFile, int threads) : bTreeFile(bTreeFile) {
+    threadCount = threads > 0 ? threads : static_cast<int>(thread::hardware_concurrency());
+    if (threadCount <= 0) threadCount = 4;
+}
+
+BTreeServer::~BTreeServer() {
+    shutdown();
+}
+
+void BTreeServer::stop() {
+    stopRequested = 1;
+}
+
+int BTreeServer::serve(const string &socketPath) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) return -1;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd == -1) return -1;
+
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1 ||
+        listen(listenFd, 128) == -1 || pipe(wakePipe) == -1) {
+        shutdown();
+        return -1;
+    }
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+    stopRequested = 0;
+    shuttingDown = false;
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&BTreeServer::workerLoop, this);
+    }
+
+    vector<pollfd> pollFds;
+    while (!stopRequested) {
+        pollFds.clear();
+        pollFds.push_back({listenFd, POLLIN, 0});
+        pollFds.push_back({wakePipe[0], POLLIN, 0});
+        for (Connection *connection : idle) {
+            pollFds.push_back({connection->fd, POLLIN, 0});
+        }
+
+        // Time out now and then so a stop request is noticed
+        if (poll(pollFds.data(), pollFds.size(), 250) <= 0) continue;
+
+        // Take back connections the workers are done with
+        if (pollFds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(wakePipe[0], drain, sizeof(drain)) > 0) {}
+            lock_guard<mutex> guard(queueMutex);
+            idle.insert(idle.end(), finished.begin(), finished.end());
+            finished.clear();
+        }
+
+        // Hand connections with data to the workers, removing them from the poll set meanwhile
+        vector<Connection*> stillIdle;
+        {
+            lock_guard<mutex> guard(queueMutex);
+            for (size_t i = 2; i < pollFds.size(); i++) {
+                Connection *connection = idle[i - 2];
+                if (pollFds[i].revents != 0) {
+                    ready.push_back(connection);
+                } else {
+                    stillIdle.push_back(connection);
+                }
+            }
+            // Connections taken back above were not polled yet
+            stillIdle.insert(stillIdle.end(), idle.begin() + (pollFds.size() - 2), idle.end());
+        }
+        queueCond.notify_all();
+        idle.swap(stillIdle);
+
+        if (pollFds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listenFd, nullptr, nullptr)) != -1) {
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                idle.push_back(new Connection{fd, ""});
+            }
+        }
+    }
+
+    shutdown();
+    unlink(socketPath.c_str());
+    return 0;
+}
+
+void BTreeServer::workerLoop() {
+    while (true) {
+        Connection *connection;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueCond.wait(lock, [this]() { return shuttingDown || !ready.empty(); });
+            if (shuttingDown) return;
+            connection = ready.front();
+            ready.pop_front();
+        }
+
+        if (!handleConnection(connection)) {
+            close(connection->fd);
+            delete connection;
+            continue;
+        }
+
+        {
+            lock_guard<mutex> guard(queueMutex);
+            finished.push_back(connection);
+        }
+        char wake = 1;
+        if (write(wakePipe[1], &wake, 1) == -1) {
+            // The pipe is full, so the dispatcher already has a wakeup pending
+        }
+    }
+}
+
+bool BTreeServer::handleConnection(Connection *connection) {
+    char chunk[65536];
+    bool open = true;
+
+    // Drain the socket so every request already sent becomes part of one batch
+    while (true) {
+        ssize_t n = recv(connection->fd, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            connection->inbox.append(chunk, n);
+        } else if (n == 0) {
+            open = false;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) open = false;
+            break;
+        }
+    }
+
+    string responses;
+    size_t offset = 0;
+    while (connection->inbox.size() - offset >= 4) {
+        uint32_t length = readUint32(connection->inbox.data() + offset);
+        if (length == 0 || length > maxRequestSize) return false;
+        if (connection->inbox.size() - offset - 4 < length) break;
+
+        execute(connection->inbox.substr(offset + 4, length), responses);
+        offset += 4 + length;
+    }
+    connection->inbox.erase(0, offset);
+
+    if (!responses.empty() && !writeAll(connection->fd, responses)) return false;
+    return open;
+}
+
+void BTreeServer::execute(const string &request, string &response) {
+    uint8_t opcode = static_cast<uint8_t>(request[0]);
+    string payload = request.substr(1);
+    RecordBuffer recordBuffer;
+
+    if (opcode == SEARCH && payload.size() == 4) {
+        int key = static_cast<int>(readUint32(payload.data()));
+        if (bTreeFile.search(recordBuffer, key) == -1) {
+            appendResponse(response, NOT_FOUND);
+        } else {
+            appendResponse(response, OK, recordBuffer.getRecord());
+        }
+    } else if (opcode == RANGE && payload.size() == 8) {
+        int lowKey = static_cast<int>(readUint32(payload.data()));
+        int highKey = static_cast<int>(readUint32(payload.data() + 4));
+        vector<RecordBuffer> results;
+        if (bTreeFile.rangeSearch(lowKey, highKey, results) == -1) {
+            appendResponse(response, ERROR);
+            return;
+        }
+
+        string out;
+        appendUint32(out, results.size());
+        for (auto &result : results) {
+            string record = result.getRecord();
+            out.push_back(static_cast<char>(record.size() >> 8));
+            out.push_back(static_cast<char>(record.size()));
+            out += record;
+        }
+        appendResponse(response, OK, out);
+    } else if (opcode == INSERT && !payload.empty()) {
+        int status = -1;
+        try {
+            if (recordBuffer.packRecord(payload) != -1) {
+                status = bTreeFile.insert(recordBuffer);
+            }
+        } catch (...) {
+            // A record without a numeric key cannot be inserted
+        }
+        appendResponse(response, status == -1 ? ERROR : OK);
+    } else if (opcode == DELETE && payload.size() == 4) {
+        recordBuffer.pack(to_string(static_cast<int>(readUint32(payload.data()))));
+        appendResponse(response, bTreeFile.remove(recordBuffer) == -1 ? NOT_FOUND : OK);
+    } else if (opcode == EXTREMA) {
+        stringstream table;
+        bTreeFile.displayExtrema(table, payload.empty() ? "*" : payload);
+        appendResponse(response, OK, table.str());
+    } else {
+        appendResponse(response, ERROR);
+    }
+}
+
+void BTreeServer::shutdown() {
+    {
+        lock_guard<mutex> guard(queueMutex);
+        shuttingDown = true;
+    }
+    queueCond.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    for (Connection *connection : idle) {
+        close(connection->fd);
+        delete connection;
+    }
+    for (Connection *connection : ready) {
+        close(connection->fd);
+        delete connection;
+    }
+    for (Connection *connection : finished) {
+        close(connection->fd);
+        delete connection;
+    }
+    idle.clear();
+    ready.clear();
+    finished.clear();
+
+    if (listenFd != -1) close(listenFd);
+    if (wakePipe[0] != -1) close(wakePipe[0]);
+    if (wakePipe[1] != -1) close(wakePipe[1]);
+    listenFd = wakePipe[0] = wakePipe[1] = -1;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file BTreeServer.h
+ * @brief Header file for the BTreeServer class.
+ */
+
+/**
+ * @class BTreeServer
+ * @brief Serves requests against an open B+ tree over a Unix domain socket.
+ * @details: The server keeps the BTreeFile and its buffer pool resident, so lookups no longer pay for
+ * opening the file and warming the cache. A dispatcher thread accepts connections and polls them; when
+ * a connection has data it is handed to a worker thread, which reads every request that has arrived,
+ * answers the whole batch and sends all the responses back in a single write.
+ *
+ * Every message is a 4 byte big endian length followed by that many bytes. A request starts with an
+ * Opcode byte and a response with a Status byte. Keys are 4 byte big endian integers.
+ *   SEARCH  key            -> OK record | NOT_FOUND
+ *   RANGE   lowKey highKey -> OK count(4 bytes) then per record a 2 byte length and the record
+ *   INSERT  csv record     -> OK | ERROR
+ *   DELETE  key            -> OK | NOT_FOUND
+ *   EXTREMA state or "*"   -> OK table text
+ * Records are sent as their comma separated fields.
+ * Includes: Serving a socket until stopped, request decoding and dispatch.
+ * Assumes: The BTreeFile is open and outlives the server.
+ */
+
+#ifndef CSCI331_PROJECT4_BTREESERVER_H
+#define CSCI331_PROJECT4_BTREESERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BTreeFile.h"
+
+class BTreeServer {
+public:
+    /**
+    * @brief The request types understood by the server.
+    */
+    enum Opcode : uint8_t {
+        SEARCH = 1,  /**< Point lookup of one key */
+        RANGE = 2,   /**< Every record between two keys */
+        INSERT = 3,  /**< Insert a record */
+        DELETE = 4,  /**< Remove the record with a key */
+        EXTREMA = 5  /**< The extrema table for a state */
+    };
+
+    /**
+    * @brief The outcome sent at the start of every response.
+    */
+    enum Status : uint8_t {
+        OK = 0,        /**< The request succeeded */
+        NOT_FOUND = 1, /**< The key is not in the tree */
+        ERROR = 2      /**< The request was malformed or failed */
+    };
+
+    /**
+    * @brief Constructor for the server.
+    * @param bTreeFile the open tree to serve
+    * @param threads number of worker threads, 0 to use one per core
+    */
+    BTreeServer(BTreeFile &bTreeFile, int threads = 0);
+
+    /**
+    * @brief Destructor, stops the workers and closes every connection.
+    */
+    ~BTreeServer();
+
+    /**
+    * @brief Listens on a socket and answers requests until stop is called.
+    * @param socketPath the filesystem path of the Unix domain socket, replaced if it exists
+    * @return 0 after a clean shutdown, -1 if the socket could not be opened
+    */
+    int serve(const std::string &socketPath);
+
+    /**
+    * @brief Asks a running serve call to return. Safe to call from a signal handler.
+    * @return nothing
+    */
+    static void stop();
+
+private:
+    /**
+    * @brief A client connection and the bytes received from it that are not yet a full request.
+    */
+    struct Connection {
+        int fd;              /**< The connected socket */
+        std::string inbox;   /**< Bytes of a partially received request */
+    };
+
+    static volatile int stopRequested; /**< Set by stop, polled by the dispatcher */
+
+    BTreeFile &bTreeFile;                /**< The tree being served */
+    int threadCount;                     /**< Number of worker threads */
+    int listenFd = -1;                   /**< The listening socket */
+    int wakePipe[2] = {-1, -1};          /**< Workers write here to hand a connection back */
+    std::vector<std::thread> workers;    /**< The worker threads */
+    std::vector<Connection*> idle;       /**< Connections waiting for data, owned by the dispatcher */
+    std::deque<Connection*> ready;       /**< Connections with data, waiting for a worker */
+    std::vector<Connection*> finished;   /**< Connections handed back by workers */
+    std::mutex queueMutex;               /**< Guards ready and finished */
+    std::condition_variable queueCond;   /**< Signals workers that ready is not empty */
+    bool shuttingDown = false;           /**< Tells workers to exit */
+
+    /**
+    * @brief Worker thread body, answers connections from the ready queue.
+    * @return nothing
+    */
+    void workerLoop();
+
+    /**
+    * @brief Reads everything available on a connection and answers each complete request.
+    * @param connection the connection to service
+    * @return false if the connection was closed or broke the protocol
+    */
+    bool handleConnection(Connection *connection);
+
+    /**
+    * @brief Executes one request.
+    * @param request the opcode followed by its payload
+    * @param response the string to append the framed response to
+    * @return nothing
+    */
+    void execute(const std::string &request, std::string &response);
+
+    /**
+    * @brief Closes every connection and the listening socket, and joins the workers.
+    * @return nothing
+    */
+    void shutdown();
+};
+
+#endif //CSCI331_PROJECT4_BTREESERVER_H
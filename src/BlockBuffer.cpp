@@ -4,54 +4,167 @@
  */
 
 #include "BlockBuffer.h"
+#include "HeaderBuffer.h"
+#include "CompactBlockCodec.h"
+#include "ColumnarBlockCodec.h"
+#include "TreeStats.h"
 #include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 using namespace std;
 
-BlockBuffer::BlockBuffer(int blockSz, int minCap) {
+/**
+ * Appends a number as text, without the temporary string of to_string.
+ */
+static void appendInt(string &text, int value) {
+    char digits[12];
+    char *end = to_chars(digits, digits + sizeof(digits), value).ptr;
+    text.append(digits, end - digits);
+}
+
+/**
+ * Parses a number of the block metadata, moving past it and the separator after it.
+ */
+static bool parseInt(string_view text, size_t &pos, int &value) {
+    from_chars_result result = from_chars(text.data() + pos, text.data() + text.size(), value);
+    if (result.ec != errc()) return false;
+    pos = result.ptr - text.data();
+    if (pos < text.size()) pos++;
+    return true;
+}
+
+/**
+ * Orders slots by key, for binary searches.
+ */
+struct SlotKeyLess {
+    template <typename Slot>
+    bool operator()(const Slot &slot, int key) const { return slot.key < key; }
+    template <typename Slot>
+    bool operator()(int key, const Slot &slot) const { return key < slot.key; }
+};
+
+BlockBuffer::BlockBuffer(int blockSz, int minCap, Encoding encoding) {
     blockSize = blockSz;
     minimumBlockCapacity = minCap;
+    this->encoding = encoding;
+    encodedSize = -1;
     prevRBN = 0;
     nextRBN = 0;
     curRBN = 0;
-    numRecords = 0;
+    highKey = -1;
+    liveBytes = 0;
+}
+
+BlockBuffer::BlockBuffer(const BlockBuffer &other) {
+    *this = other;
+}
+
+BlockBuffer &BlockBuffer::operator=(const BlockBuffer &other) {
+    if (this != &other) {
+        blockSize = other.blockSize;
+        minimumBlockCapacity = other.minimumBlockCapacity;
+        prevRBN = other.prevRBN;
+        nextRBN = other.nextRBN;
+        curRBN = other.curRBN;
+        highKey = other.highKey;
+        encoding = other.encoding;
+        // Only the live records are copied, so the copy starts out compacted
+        clear();
+        store.reserve(other.liveBytes);
+        slots.reserve(other.slots.size());
+        for (const Slot &slot : other.slots) {
+            appendRecord(other.getRecord(slot).getText(), slot.key);
+        }
+        encoded = other.encoded;
+        encodedSize = other.encodedSize;
+    }
+    return *this;
+}
+
+BlockBuffer::Encoding BlockBuffer::parseEncoding(const std::string &name) {
+    if (name == "COMPACT") return COMPACT;
+    if (name == "COLUMNAR") return COLUMNAR;
+    return TEXT;
 }
 
-int BlockBuffer::read(std::istream &stream, int headerRecordSize, int blockNumber) {
+std::streamoff BlockBuffer::read(std::istream &stream, int headerRecordSize, int blockNumber) {
     // Move to location if needed
     if (blockNumber != -1) {
         stream.clear();
-        stream.seekg((blockNumber-1) * blockSize + headerRecordSize);
+        stream.seekg(HeaderBuffer::blockOffset(blockNumber, blockSize, headerRecordSize));
     }
 
     // check input stream
     if (!stream) return -1;
 
     // Get current location in stream
-    int addr = stream.tellg();
-    curRBN = (addr + blockSize - headerRecordSize) / blockSize;
+    std::streamoff addr = stream.tellg();
+    curRBN = static_cast<int>((addr + blockSize - headerRecordSize) / blockSize);
 
     // Clear current buffer
     clear();
 
     // Read block into buffer
-    vector<char> buf(blockSize);
-    stream.read(buf.data(), blockSize);
+    Arena::Scope scope;
+    char *data = static_cast<char *>(Arena::local().allocate(blockSize, 1));
+    memset(data, 0, blockSize);
+    string_view buf(data, blockSize);
+    stream.read(data, blockSize);
     // Easy way to check if block is completely empty
     if (buf[0] == '\0') return -1;
-    // Remove end spaces as they are rewritten in write function
-    auto pos = std::find_if_not(buf.rbegin(), buf.rend(), [](char c) { return std::isspace(c) || c == '\n'; }).base();
-    // copy data into internal buffer
-    buffer.write(buf.data(), std::distance(buf.begin(), pos)+1);
-
-    // Get metadata
-    string metadata;
-    getline(buffer, metadata, ',');
-    numRecords = stoi(metadata);
-    std::getline(buffer, metadata, ',');
-    prevRBN = stoi(metadata);
-    std::getline(buffer, metadata);
-    nextRBN = std::stoi(metadata);
-    buffer.seekg(0);
+
+    // Compact and columnar blocks are decoded into the store like text blocks
+    if (buf[0] == CompactBlockCodec::marker || buf[0] == ColumnarBlockCodec::marker) {
+        vector<string> texts;
+        bool columnar = buf[0] == ColumnarBlockCodec::marker;
+        int size = columnar ? ColumnarBlockCodec::decode(buf.data(), blockSize, texts, prevRBN, nextRBN, highKey)
+                            : CompactBlockCodec::decode(buf.data(), blockSize, texts, prevRBN, nextRBN, highKey);
+        if (size == -1) {
+            return -1;
+        }
+        TreeStats::add(TreeStats::BYTES_PARSED, size);
+        for (const string &text : texts) {
+            slots.push_back(Slot{RecordView(text).getKey(), static_cast<int>(store.size()),
+                                 static_cast<int>(text.size())});
+            store += text;
+            liveBytes += text.size();
+        }
+
+        // Keep the encoding while it is the one this buffer writes
+        if (encoding == (columnar ? COLUMNAR : COMPACT)) {
+            encoded.assign(buf.data(), size);
+            encodedSize = size;
+        }
+    } else {
+        // Get metadata, blocks written before high keys were kept end the line at the next RBN
+        size_t pos = 0;
+        int numRecords = 0;
+        size_t lineEnd = min(buf.find('\n'), buf.size());
+        if (!parseInt(buf, pos, numRecords) || !parseInt(buf, pos, prevRBN) || !parseInt(buf, pos, nextRBN)) {
+            return -1;
+        }
+        highKey = -1;
+        if (pos < lineEnd && buf[pos - 1] == ',') parseInt(buf, pos, highKey);
+        pos = min(lineEnd + 1, buf.size());
+
+        // Each record is a two digit length followed by its text
+        while (static_cast<int>(slots.size()) < numRecords && pos + 2 <= buf.size()) {
+            int recordSize = (buf[pos] - '0') * 10 + (buf[pos + 1] - '0');
+            if (recordSize < 0 || static_cast<size_t>(recordSize) > buf.size() - pos - 2) break;
+            string_view text = buf.substr(pos + 2, recordSize);
+            slots.push_back(Slot{RecordView(text).getKey(), static_cast<int>(store.size()), recordSize});
+            store.append(text);
+            liveBytes += recordSize;
+            pos += 2 + recordSize;
+        }
+        TreeStats::add(TreeStats::BYTES_PARSED, pos);
+    }
+
+    // Blocks are written sorted, but a stable sort keeps any that were not in the order packing expects
+    if (!is_sorted(slots.begin(), slots.end(), [](const Slot &a, const Slot &b) { return a.key < b.key; })) {
+        stable_sort(slots.begin(), slots.end(), [](const Slot &a, const Slot &b) { return a.key < b.key; });
+    }
 
     // check stream
     if (stream.bad()) {
@@ -62,29 +175,19 @@ int BlockBuffer::read(std::istream &stream, int headerRecordSize, int blockNumbe
     return addr;
 }
 
-int BlockBuffer::write(std::ostream &stream, int headerRecordSize, int blockNumber) {
+std::streamoff BlockBuffer::write(std::ostream &stream, int headerRecordSize, int blockNumber) {
 
     // Move to location if needed
     if (blockNumber != -1) {
-        stream.seekp((blockNumber-1) * blockSize + headerRecordSize);
+        stream.seekp(HeaderBuffer::blockOffset(blockNumber, blockSize, headerRecordSize));
     }
 
     // Get output location
-    int addr = stream.tellp();
-    curRBN = (addr + blockSize - headerRecordSize) / blockSize;
-
-    // Write the buffer - always rewrite metadata
-    string str = buffer.str();
-    int pos = str.find_first_of('\n');
-    if (pos > 0) str = str.substr(pos+1);
-    str = to_string(numRecords) + "," + to_string(prevRBN) + "," + to_string(nextRBN) + "\n" + str;
-
+    std::streamoff addr = stream.tellp();
+    curRBN = static_cast<int>((addr + blockSize - headerRecordSize) / blockSize);
 
-    int sz = str.length();
-    int remainingSpace = blockSize - sz;
-    if (remainingSpace > 0) {
-        str += string(remainingSpace-1, ' '); str += '\n';
-    }
+    string str;
+    if (getImage(str) == -1) return -1;
     stream.write(str.c_str(), blockSize);
 
     // check stream
@@ -93,48 +196,69 @@ int BlockBuffer::write(std::ostream &stream, int headerRecordSize, int blockNumb
     return addr;
 }
 
-int BlockBuffer::unpack(RecordBuffer &rBuf) {
-    numRecords--;
-    if (numRecords < 0) {
-        numRecords = 0;
-        return -1;
+int BlockBuffer::getImage(std::string &image) const {
+    // Encoded blocks are padded with zeros, as their encoding may end in any byte
+    if (encoding != TEXT) {
+        if (encode() == -1 || encodedSize > blockSize) return -1;
+        image = encoded;
+        image.resize(blockSize, '\0');
+        return 0;
     }
 
-    // Ignore block metadata
-    string buf = buffer.str();
-    int pos = buf.find_first_of('\n');
-    if (pos > 0) buf = buf.substr(pos+1);
-    buffer.seekg(pos+1);
+    // Build the text form, a metadata line and then each record behind its length
+    image.clear();
+    image.reserve(blockSize);
+    appendInt(image, slots.size());
+    image += ',';
+    appendInt(image, prevRBN);
+    image += ',';
+    appendInt(image, nextRBN);
+    image += ',';
+    appendInt(image, highKey);
+    image += '\n';
+    for (const Slot &slot : slots) {
+        image += static_cast<char>('0' + slot.length / 10);
+        image += static_cast<char>('0' + slot.length % 10);
+        image.append(store, slot.offset, slot.length);
+    }
 
-    // Read the record into record buffer, than remove from block buffer
-    int recordAddr = rBuf.read(buffer);
-    int curAddr = buffer.tellg();
-    buf.erase(0, curAddr - recordAddr);
-    clear();
+    int remainingSpace = blockSize - static_cast<int>(image.size());
+    if (remainingSpace > 0) {
+        image.append(remainingSpace - 1, ' ');
+        image += '\n';
+    }
+    image.resize(blockSize);
+    return 0;
+}
 
-    // Rewrite new block buffer
-    buffer << numRecords << "," << prevRBN << "," << nextRBN << endl;
-    buffer << buf;
+int BlockBuffer::unpack(RecordBuffer &rBuf) {
+    if (slots.empty()) return -1;
 
-    return recordAddr;
+    rBuf.assign(getRecord(slots.front()).getText());
+    eraseSlots(slots.begin(), slots.begin() + 1);
+    return 0;
 }
 
 int BlockBuffer::pack(RecordBuffer &rBuf) {
-    numRecords++;
-    string buf = buffer.str();
-    // Get the buffer without the current block metadata as it will be rewritten
-    int pos = buf.find_first_of('\n');
-    if (pos > 0) buf = buf.substr(pos+1);
-    clear();
-    buffer << numRecords << "," << prevRBN << "," << nextRBN << endl;
-    buffer << buf;
-
-    return rBuf.write(buffer);
+    RecordView record = rBuf.getView();
+    string_view text = record.getText();
+    if (text.size() > maxRecordSize) return -1;
+
+    // The slots after the record's place shift along, its text goes on the end of the store
+    int key = record.getKey();
+    auto position = upper_bound(slots.begin(), slots.end(), key, SlotKeyLess());
+    slots.insert(position, Slot{key, static_cast<int>(store.size()), static_cast<int>(text.size())});
+    store.append(text);
+    liveBytes += text.size();
+    encodedSize = -1;
+    return 0;
 }
 
 void BlockBuffer::clear() {
-    buffer.clear();
-    buffer.str("");
+    store.clear();
+    slots.clear();
+    liveBytes = 0;
+    encodedSize = -1;
 }
 
 int BlockBuffer::getNextRBN() {
@@ -149,134 +273,324 @@ int BlockBuffer::getCurRBN() {
     return curRBN;
 }
 
+int BlockBuffer::getColumns(LeafColumns &columns) const {
+    if (encoding != COLUMNAR || encode() == -1) {
+        return -1;
+    }
+    return ColumnarBlockCodec::readColumns(encoded.data(), encodedSize, columns);
+}
+
+int BlockBuffer::getBlockSize() {
+    return blockSize;
+}
+
 int BlockBuffer::getNumRecords() {
-    return numRecords;
+    return slots.size();
 }
 
 void BlockBuffer::setNextRBN(int rbn) {
     nextRBN = rbn;
+    encodedSize = -1;
 }
 
 void BlockBuffer::setPrevRBN(int rbn) {
     prevRBN = rbn;
+    encodedSize = -1;
 }
 
 void BlockBuffer::setCurRBN(int rbn) {
     curRBN = rbn;
 }
 
-void BlockBuffer::setNumRecords(int num) {
-    numRecords = num;
+int BlockBuffer::getHighKey() {
+    return highKey;
+}
+
+void BlockBuffer::setHighKey(int key) {
+    highKey = key;
+    encodedSize = -1;
 }
 
 bool BlockBuffer::isOverFilled() {
-    return buffer.str().length() > blockSize;
+    return getUsedBytes() > blockSize;
 }
 
 bool BlockBuffer::isUnderFilled() {
-    return buffer.str().length() < minimumBlockCapacity;
+    return getUsedBytes() < minimumBlockCapacity;
 }
 
 void BlockBuffer::splitBuffer(BlockBuffer &newBlockBuffer) {
-    RecordBuffer rBuf;
-    BlockBuffer tmpBuffer1;
-    BlockBuffer tmpBuffer2;
+    Arena::Scope scope;
+    ArenaVector<RecordView> views = getRecordViews();
 
     // Assuming splitting the records evenly between the current and new block
-    int recordsToMove = numRecords / 2.0;
-
-    // Move the records to the new block buffer
-    int num = numRecords;
-    for (int i = 0; i < num; i++) {
-        unpack(rBuf);
-        if (i < recordsToMove) tmpBuffer1.pack(rBuf);
-        else tmpBuffer2.pack(rBuf);
+    int recordsToKeep = views.size() / 2;
+
+    newBlockBuffer.setRecords(ArenaVector<RecordView>(views.begin() + recordsToKeep, views.end()));
+    eraseSlots(slots.begin() + recordsToKeep, slots.end());
+}
+
+void BlockBuffer::mergeBuffer(BlockBuffer &newBlockBuffer) {
+    // Move the records to the end of the current block buffer
+    for (const Slot &slot : newBlockBuffer.slots) {
+        appendRecord(newBlockBuffer.getRecord(slot).getText(), slot.key);
     }
+    newBlockBuffer.clear();
+}
 
-    clear();
+void BlockBuffer::redistributeBuffers(const vector<BlockBuffer*> &buffers) {
+    // The views point into copies of the records, as each buffer's own records are replaced below
+    Arena::Scope scope;
+    ArenaVector<RecordView> records;
+    size_t totalBytes = 0;
+    for (BlockBuffer *blockBuffer : buffers) {
+        for (const Slot &slot : blockBuffer->slots) {
+            records.emplace_back(Arena::local().copy(blockBuffer->getRecord(slot).getText()));
+            totalBytes += slot.length;
+        }
+    }
+
+    // Each buffer takes records up to its share of the bytes, the last one whatever is left
+    size_t next = 0;
+    size_t placedBytes = 0;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        size_t target = totalBytes * (i + 1) / buffers.size();
+        size_t laterBuffers = buffers.size() - i - 1;
+        size_t end = next;
+        while (end + laterBuffers < records.size() &&
+               (end == next || laterBuffers == 0 || placedBytes + records[end].getText().size() / 2 <= target)) {
+            placedBytes += records[end].getText().size();
+            end++;
+        }
 
-    while(tmpBuffer1.unpack(rBuf) != -1) {
-        pack(rBuf);
+        buffers[i]->setRecords(ArenaVector<RecordView>(records.begin() + next, records.begin() + end));
+        next = end;
     }
+}
 
-    while(tmpBuffer2.unpack(rBuf) != -1) {
-        newBlockBuffer.pack(rBuf);
+int BlockBuffer::getLargestKey() {
+    return slots.empty() ? -1 : slots.back().key;
+}
+
+int BlockBuffer::getSmallestKey() {
+    return slots.empty() ? -1 : slots.front().key;
+}
+
+void BlockBuffer::print(std::ostream &stream) const {
+    stream << slots.size() << "," << prevRBN << "," << nextRBN << "," << highKey << "\n";
+    for (const Slot &slot : slots) {
+        stream << static_cast<char>('0' + slot.length / 10) << static_cast<char>('0' + slot.length % 10);
+        stream.write(store.data() + slot.offset, slot.length);
     }
+}
 
+int BlockBuffer::removeRecord(int key) {
+    auto found = findSlots(key);
+    eraseSlots(found.first, found.second);
+    return 0;
 }
 
-void BlockBuffer::mergeBuffer(BlockBuffer &newBlockBuffer) {
-    // Move the records to the new block buffer
-    int count = newBlockBuffer.getNumRecords();
-    for (int i = 0; i < count; ++i) {
-        RecordBuffer rBuf;
-        newBlockBuffer.unpack(rBuf);
-        pack(rBuf);
+int BlockBuffer::markDeleted(int key) {
+    auto found = findSlots(key);
+    for (auto slot = found.first; slot != found.second; ++slot) {
+        if (getRecord(*slot).isTombstone()) continue;
+
+        // Ending in a newline like a record loaded from a file keeps the padding of a text block off it
+        size_t start = store.size();
+        appendInt(store, key);
+        store += RecordView::tombstoneMark;
+        store += '\n';
+        int tombstoneSize = store.size() - start;
+
+        if (slot->length <= tombstoneSize) {
+            store.resize(start);
+            eraseSlots(slot, slot + 1);
+        } else {
+            liveBytes += tombstoneSize - slot->length;
+            slot->offset = start;
+            slot->length = tombstoneSize;
+            encodedSize = -1;
+            compact();
+        }
+        return 0;
     }
+
+    return -1;
 }
 
-void BlockBuffer::redistributeBuffer(BlockBuffer &newBlockBuffer) {
-    while (isUnderFilled()) {
-        RecordBuffer rBuf;
-        newBlockBuffer.unpack(rBuf);
-        pack(rBuf);
+int BlockBuffer::purgeTombstones(int key) {
+    // Only the slots of the key need looking at when there is one
+    auto first = slots.begin();
+    auto last = slots.end();
+    if (key != -1) {
+        tie(first, last) = findSlots(key);
     }
+
+    // Swapping the records kept forward leaves them in order with the tombstones after them
+    auto kept = first;
+    for (auto slot = first; slot != last; ++slot) {
+        if (!getRecord(*slot).isTombstone()) swap(*kept++, *slot);
+    }
+    int count = last - kept;
+    eraseSlots(kept, last);
+
+    return count;
 }
 
-int BlockBuffer::getLargestKey() {
-    // Create a copy of the current buffer
-    std::stringstream bufferCopy(this->buffer.str());
-
-    RecordBuffer rbuf;
-    int largestKey = -1;
-    BlockBuffer tmpBuffer;
-    tmpBuffer.read(bufferCopy, 0);
-
-    while (tmpBuffer.unpack(rbuf) != -1) {
-        int key = rbuf.getRecordKey();
-        if (key > largestKey) {
-            largestKey = key;
+int BlockBuffer::getTombstoneBytes() const {
+    int bytes = 0;
+    forEachRecord([&bytes](const RecordView &record) {
+        if (record.isTombstone()) bytes += 2 + record.getText().size();
+        return true;
+    });
+    return bytes;
+}
+
+int BlockBuffer::findRecord(RecordBuffer &rBuf, int key) const {
+    auto first = lower_bound(slots.begin(), slots.end(), key, SlotKeyLess());
+    for (auto slot = first; slot != slots.end() && slot->key == key; ++slot) {
+        RecordView record = getRecord(*slot);
+        if (!record.isTombstone()) {
+            return rBuf.assign(record.getText());
         }
     }
 
-    return largestKey;
+    rBuf.clear();
+    return -1;
 }
 
-int BlockBuffer::sortBuffer() {
-    vector<RecordBuffer> recordBuffers;
-    RecordBuffer recordBuffer;
+int BlockBuffer::forEachRecord(const std::function<bool(const RecordView &)> &visit) const {
+    int visited = 0;
+    for (const Slot &slot : slots) {
+        visited++;
+        if (!visit(getRecord(slot))) break;
+    }
+    return visited;
+}
 
-    while(unpack(recordBuffer) != -1) {
-        recordBuffers.push_back(recordBuffer);
+int BlockBuffer::getRecordBytes() const {
+    // Each record is stored behind a two digit length indicator
+    return liveBytes + 2 * static_cast<int>(slots.size());
+}
+
+bool BlockBuffer::canPack(int recordSize) const {
+    return getUsedBytes() + recordSize + getSlack() <= blockSize;
+}
+
+bool BlockBuffer::canUnpack(int recordSize) const {
+    return getUsedBytes() - recordSize - getSlack() >= minimumBlockCapacity;
+}
+
+bool BlockBuffer::canMerge(const BlockBuffer &other) const {
+    // Merged encoded blocks share one metadata header and dictionary, so they never grow
+    if (encoding != TEXT) {
+        return getUsedBytes() + other.getUsedBytes() <= blockSize;
     }
+    return getRecordBytes() + other.getRecordBytes() + metadataReserve <= blockSize;
+}
 
-    std::sort(recordBuffers.begin(), recordBuffers.end(),
-              [](RecordBuffer& a, RecordBuffer& b) {
-                  return a.getRecordKey() < b.getRecordKey();
-              });
+double BlockBuffer::getFill() const {
+    return static_cast<double>(getUsedBytes()) / blockSize;
+}
 
-    clear();
+int BlockBuffer::getUsedBytes() const {
+    if (encoding == TEXT) {
+        return getRecordBytes() + metadataReserve;
+    }
+
+    // Records the encoding cannot hold never fit
+    if (encode() == -1) {
+        return blockSize + 1;
+    }
+    // Columnar metadata is fixed width, so it needs no room to grow
+    return encoding == COMPACT ? encodedSize + compactReserve : encodedSize;
+}
 
-    for (auto rBuf : recordBuffers) {
-        pack(rBuf);
+int BlockBuffer::encode() const {
+    if (encodedSize == -1) {
+        if (encoding == COMPACT) {
+            encodedSize = CompactBlockCodec::encode(getRecordTexts(), prevRBN, nextRBN, highKey, encoded);
+        } else {
+            encodedSize = ColumnarBlockCodec::encode(getRecordTexts(), prevRBN, nextRBN, highKey, encoded);
+        }
     }
+    return encodedSize;
+}
 
+int BlockBuffer::getSlack() const {
+    if (encoding == COMPACT) return compactSlack;
+    if (encoding == COLUMNAR) return columnarSlack;
     return 0;
 }
 
-int BlockBuffer::removeRecord(int key) {
-    vector<RecordBuffer> recordBuffers;
-    RecordBuffer recordBuffer;
+vector<string> BlockBuffer::getRecordTexts() const {
+    vector<string> texts;
+    texts.reserve(slots.size());
+    for (const Slot &slot : slots) {
+        texts.emplace_back(getRecord(slot).getText());
+    }
+    return texts;
+}
 
-    while(unpack(recordBuffer) != -1) {
-        if (recordBuffer.getRecordKey() != key) {
-            recordBuffers.push_back(recordBuffer);
-        }
+RecordView BlockBuffer::getRecord(const Slot &slot) const {
+    return RecordView(string_view(store.data() + slot.offset, slot.length));
+}
+
+pair<vector<BlockBuffer::Slot>::iterator, vector<BlockBuffer::Slot>::iterator> BlockBuffer::findSlots(int key) {
+    return equal_range(slots.begin(), slots.end(), key, SlotKeyLess());
+}
+
+void BlockBuffer::appendRecord(string_view text, int key) {
+    slots.push_back(Slot{key, static_cast<int>(store.size()), static_cast<int>(text.size())});
+    store.append(text);
+    liveBytes += text.size();
+    encodedSize = -1;
+}
+
+void BlockBuffer::eraseSlots(vector<Slot>::iterator first, vector<Slot>::iterator last) {
+    if (first == last) return;
+
+    for (auto slot = first; slot != last; ++slot) {
+        liveBytes -= slot->length;
     }
+    slots.erase(first, last);
+    encodedSize = -1;
+    compact();
+}
 
-    clear();
+void BlockBuffer::compact() {
+    // Small stores are left alone, rewriting them would cost more than the bytes it frees
+    int deadBytes = static_cast<int>(store.size()) - liveBytes;
+    if (static_cast<int>(store.size()) <= blockSize || deadBytes <= liveBytes) return;
+
+    Arena::Scope scope;
+    string_view old = Arena::local().copy(store);
+    store.clear();
+    for (Slot &slot : slots) {
+        int offset = store.size();
+        store.append(old.substr(slot.offset, slot.length));
+        slot.offset = offset;
+    }
+}
 
-    for (auto rBuf : recordBuffers) {
-        pack(rBuf);
+ArenaVector<RecordView> BlockBuffer::getRecordViews() const {
+    ArenaVector<RecordView> views;
+    views.reserve(slots.size());
+    for (const Slot &slot : slots) {
+        views.push_back(getRecord(slot));
     }
-}
\ No newline at end of file
+    return views;
+}
+
+void BlockBuffer::setRecords(const ArenaVector<RecordView> &records) {
+    clear();
+    size_t bytes = 0;
+    for (const RecordView &record : records) {
+        bytes += record.getText().size();
+    }
+    store.reserve(bytes);
+    slots.reserve(records.size());
+    for (const RecordView &record : records) {
+        appendRecord(record.getText(), record.getKey());
+    }
+}
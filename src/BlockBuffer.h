@@ -6,7 +6,15 @@
 /**
  * @class BlockBuffer
  * @brief A class that has functions to read, write, pack, and unpack block files.
- * @details:
+ * @details: In memory a block is kept decoded, its record texts appended one after another to a
+ * store and a list of slots, sorted by key, saying where each record is. Packing a record finds its
+ * place by binary search, shifts the slots after it and appends its text, so it costs O(log n) plus
+ * the record, and lookups by key are binary searches too. Removed records leave their text behind
+ * until the dead bytes outweigh the live ones and the store is compacted. The text form, a metadata
+ * line followed by length indicated records, is only built when the block is written or printed.
+ * Blocks are written either as that text or encoded by CompactBlockCodec or ColumnarBlockCodec,
+ * in which case fullness is measured by the encoded size. The encoding of a block read from disk is kept
+ * until the block changes, so columnar scans can read its columns without encoding it again.
  * Includes: The ability to read and write blocks one block at a time.
  * Assumes: all references to other buffers to be correct and working.
  */
@@ -14,28 +22,66 @@
 #ifndef CSCI331_PROJECT2_P2_BLOCKBUFFER_H
 #define CSCI331_PROJECT2_P2_BLOCKBUFFER_H
 
+#include <functional>
 #include <iostream>
-#include <sstream>
+#include <string>
+#include <vector>
 #include "RecordBuffer.h"
+#include "ColumnarBlockCodec.h"
+#include "Arena.h"
 
 class BlockBuffer {
 public:
+    static const int maxRecordSize = 99; /**< Longest record a two digit length indicator can hold */
+
+    /**
+    * @brief How a block is written to disk.
+    */
+    enum Encoding {
+        TEXT,     /**< The text form as it is */
+        COMPACT,  /**< Encoded by CompactBlockCodec */
+        COLUMNAR  /**< Encoded by ColumnarBlockCodec */
+    };
+
     /**
     * @brief BlockBuffer Constructor.
     * @param blockSz Size as an integer.
     * @param minCap minimum block capacity
+    * @param encoding how the block is written
     * @post Class is initialized
     */
-    BlockBuffer(int blockSz = 512, int minCap = 256);
+    BlockBuffer(int blockSz = 512, int minCap = 256, Encoding encoding = TEXT);
+
+    /**
+    * @brief Looks up an encoding by the name it has in the file header.
+    * @param name TEXT, COMPACT or COLUMNAR
+    * @return the encoding, TEXT for names not known
+    */
+    static Encoding parseEncoding(const std::string &name);
+
+    /**
+    * @brief Copy Constructor, copies the buffered block contents and metadata.
+    * @param other the block buffer to copy.
+    * @post Class is initialized with the same contents as other.
+    */
+    BlockBuffer(const BlockBuffer &other);
+
+    /**
+    * @brief Copy Assignment, copies the buffered block contents and metadata.
+    * @param other the block buffer to copy.
+    * @return reference to this block buffer.
+    */
+    BlockBuffer &operator=(const BlockBuffer &other);
 
     /**
     * @brief Read Function, reads one block of data and stores it in the buffer at a time.
+    * Blocks in every encoding are understood, whichever way this buffer writes.
     * @param  stream the input to read from.
     * @param  headerRecordSize the size of the header record of file reading from.
     * @param  blockNumber the relative blocknumber to read the block from.
     * @return -1 if error, non error the address of of stream location.
     */
-    int read(std::istream & stream, int headerRecordSize, int blockNumber = -1);
+    std::streamoff read(std::istream & stream, int headerRecordSize, int blockNumber = -1);
 
     /**
     * @brief Write Function, writes the data currently stored in buffer.
@@ -44,24 +90,31 @@ public:
     * @param  blockNumber the relative blocknumber to write the block to.
     * @return -1 if error, non error the address of of stream location.
     */
-    int write(std::ostream & stream, int headerRecordSize, int blockNumber = -1);
+    std::streamoff write(std::ostream & stream, int headerRecordSize, int blockNumber = -1);
 
     /**
-    * @brief Unpack Function.
+    * @brief Builds the bytes write would store for the block.
+    * @param image string to store the block in, exactly one block long.
+    * @return -1 if the records do not fit in a block, 0 otherwise.
+    */
+    int getImage(std::string &image) const;
+
+    /**
+    * @brief Unpack Function, takes the record with the smallest key out of the buffer.
     * @param rBuf The record buffer to unpack data into.
-    * @return int value of address where record is read.
+    * @return -1 if the buffer is empty, 0 otherwise.
     */
     int unpack(RecordBuffer &rBuf);
 
     /**
-    * @brief Pack Function.
+    * @brief Pack Function, inserts the record in key order, after any records with the same key.
     * @param rBuf The record buffer to pack data from.
-    * @return int value of address of where the record was written.
+    * @return -1 if the record is too long for a length indicator, 0 otherwise.
     */
     int pack(RecordBuffer &rBuf);
 
     /**
-    * @brief Clear Function, clears buffer.
+    * @brief Clear Function, removes every record from the buffer, keeping its metadata.
     * @return nothing.
     */
     void clear();
@@ -84,6 +137,19 @@ public:
     */
     int getCurRBN();
 
+    /**
+    * @brief Reads the key, State and coordinate columns of a columnar block.
+    * @param columns stores the columns
+    * @return -1 if the block is not written in columns, the number of records otherwise
+    */
+    int getColumns(LeafColumns &columns) const;
+
+    /**
+    * @brief Getter Function for blockSize variable.
+    * @return integer value of blockSize variable.
+    */
+    int getBlockSize();
+
     /**
     * @brief Getter Function for NumRecords variable.
     * @return integer value of NumRecords variable.
@@ -109,13 +175,21 @@ public:
     void setCurRBN(int rbn);
 
     /**
-    * @brief Setter Function for NumRecords variable.
-    * @return integer value of NumRecords variable.
+    * @brief Getter Function for the high key, the upper bound on keys that belong in this block.
+    * @return integer value of the high key, -1 if the block is last in the sequence set.
+    */
+    int getHighKey();
+
+    /**
+    * @brief Setter Function for the high key.
+    * @param key the upper bound on keys that belong in this block, -1 for none.
     */
-    void setNumRecords(int num);
+    void setHighKey(int key);
 
     /**
     * @brief Checks if buffer is too full.
+    * @details Room for the metadata line is reserved at its widest, since neighbouring blocks can
+    * change the stored RBNs after the block was last checked.
     * @return true if buffer contains more bytes than specified block size, false otherwise.
     */
     bool isOverFilled();
@@ -141,11 +215,11 @@ public:
     void mergeBuffer(BlockBuffer &newBlockBuffer);
 
     /**
-    * @brief Redistributes the records from passed in buffer into the current buffer until min capacity is reached.
-    * @param newBlockBuffer the new block buffer to get data to redistribute.
+    * @brief Shares the records of neighboring buffers out between them by size, keeping them in key order.
+    * @param buffers the buffers in key order, any of which may start out empty.
     * @return nothing.
     */
-    void redistributeBuffer(BlockBuffer &newBlockBuffer);
+    static void redistributeBuffers(const std::vector<BlockBuffer*> &buffers);
 
     /**
     * @brief Gets the largest key from the buffer.
@@ -154,10 +228,17 @@ public:
     int getLargestKey();
 
     /**
-    * @brief Sorts the buffer based on key
-    * @return -1 on error, 0 otherwise
+    * @brief Gets the smallest key from the buffer.
+    * @return The int value of the smallest key in buffer, -1 if it is empty.
+    */
+    int getSmallestKey();
+
+    /**
+    * @brief Prints the block as text, a metadata line followed by the length indicated records.
+    * @param stream the output to print to.
+    * @return nothing
     */
-    int sortBuffer();
+    void print(std::ostream &stream) const;
 
     /**
     * @brief Removes a record from the buffer
@@ -166,14 +247,179 @@ public:
     */
     int removeRecord(int key);
 
+    /**
+    * @brief Replaces a record with a tombstone holding only its key, which reads skip until it is purged.
+    * @details A record no longer than its tombstone is removed outright, so marking never grows the block.
+    * @param key The record to mark, the first one with the key that is not already a tombstone
+    * @return -1 if there is no such record, 0 otherwise
+    */
+    int markDeleted(int key);
+
+    /**
+    * @brief Removes tombstones from the buffer.
+    * @param key only the tombstone of this key is removed, -1 for every tombstone
+    * @return the number of tombstones removed
+    */
+    int purgeTombstones(int key = -1);
+
+    /**
+    * @brief Gets the bytes the tombstones in the buffer take up, length indicators included.
+    * @return 0 if the buffer holds no tombstones
+    */
+    int getTombstoneBytes() const;
+
+    /**
+    * @brief Finds a record by key without consuming the buffer, safe to call from concurrent readers.
+    * Tombstones are skipped.
+    * @param rBuf The record buffer to store the record in.
+    * @param key The key to search for.
+    * @return -1 if not found, 0 otherwise
+    */
+    int findRecord(RecordBuffer &rBuf, int key) const;
+
+    /**
+    * @brief Visits the records in key order without copying them out of the buffer.
+    * @param visit called with a view of each record, which is only valid during the call; returning
+    * false stops the scan.
+    * @return the number of records visited.
+    */
+    int forEachRecord(const std::function<bool(const RecordView &)> &visit) const;
+
+    /**
+    * @brief Gets the number of record bytes held in the buffer, metadata excluded.
+    * @return length of the records in bytes.
+    */
+    int getRecordBytes() const;
+
+    /**
+    * @brief Checks if a record can be packed without overfilling the block.
+    * @param recordSize the size of the record in bytes.
+    * @return true if the record fits, false otherwise.
+    */
+    bool canPack(int recordSize) const;
+
+    /**
+    * @brief Checks if a record can be removed without underfilling the block.
+    * @param recordSize the size of the record in bytes.
+    * @return true if the block stays above minimum capacity, false otherwise.
+    */
+    bool canUnpack(int recordSize) const;
+
+    /**
+    * @brief Checks if the records of the passed in buffer fit in the current buffer.
+    * @param other the block buffer to merge from.
+    * @return true if both buffers fit in one block, false otherwise.
+    */
+    bool canMerge(const BlockBuffer &other) const;
+
+    /**
+    * @brief Gets how much of the block the records and metadata take up.
+    * @return the bytes used over the block size, above 1 if the block is overfilled.
+    */
+    double getFill() const;
+
 private:
-    std::stringstream buffer; /**< Used to help in the pack and unpack functions */
+    static const int metadataReserve = 36; /**< Widest metadata line, four digit count, nine digit RBNs and high key */
+    static const int compactReserve = 20;  /**< Room for the varint metadata of a compact block to grow */
+    static const int compactSlack = 8;     /**< Most a record can grow when compacted, from its key delta */
+    static const int columnarSlack = 20;   /**< Most a record can grow in columns, from its fixed width fields */
+
+    /**
+    * @brief Where a record is in the store.
+    */
+    struct Slot {
+        int key;     /**< Key of the record, parsed once when it is stored */
+        int offset;  /**< Where the text of the record starts in the store */
+        int length;  /**< Length of the text of the record */
+    };
+
+    std::string store;        /**< Texts of the records, without length indicators, in the order they were stored */
+    std::vector<Slot> slots;  /**< Where each live record is in the store, sorted by key */
+    int liveBytes;            /**< Length of the texts of the live records */
     int blockSize;            /**< Stores the block size as int */
     int minimumBlockCapacity; /**< Stores the minimum block size as int */
-    int numRecords;           /**< Stores the Number of Records as int */
     int prevRBN;              /**< Keeps state of block next block number to read */
     int nextRBN;              /**< Keeps state of block previous block number read */
     int curRBN;               /**< Keeps state of block current block number */
+    int highKey;              /**< Largest key that belongs in this block, -1 when unbounded */
+    Encoding encoding;            /**< How the block is written */
+    mutable std::string encoded;  /**< Cached compact or columnar encoding of the block */
+    mutable int encodedSize;      /**< Size of the cached encoding, -1 when out of date */
+
+    /**
+    * @brief Gets the bytes the block takes when written, with room for its metadata.
+    * @return the text size plus metadataReserve, or the encoded size plus its reserve.
+    */
+    int getUsedBytes() const;
+
+    /**
+    * @brief Fills the cached encoding if the block changed since it was made.
+    * @return -1 if the records cannot be encoded, the encoded size otherwise
+    */
+    int encode() const;
+
+    /**
+    * @brief Gets the most a record can grow by when encoded, over its size as text.
+    * @return the slack of the encoding, 0 for text
+    */
+    int getSlack() const;
+
+    /**
+    * @brief Gets the text of every record, without length indicators.
+    * @return the records in key order.
+    */
+    std::vector<std::string> getRecordTexts() const;
+
+    /**
+    * @brief Gets a view of a record in the store.
+    * @param slot where the record is.
+    * @return the view, valid until the buffer changes.
+    */
+    RecordView getRecord(const Slot &slot) const;
+
+    /**
+    * @brief Finds the slots of the records with a key.
+    * @param key the key to look for.
+    * @return the first slot with the key and the slot after the last, equal if there are none.
+    */
+    std::pair<std::vector<Slot>::iterator, std::vector<Slot>::iterator> findSlots(int key);
+
+    /**
+    * @brief Stores a record after every record already in the buffer.
+    * @param text the record, which must not point into this buffer.
+    * @param key the key of the record, no smaller than any key already stored.
+    * @return nothing.
+    */
+    void appendRecord(std::string_view text, int key);
+
+    /**
+    * @brief Takes slots out of the buffer, compacting the store if it is mostly dead bytes.
+    * @param first the first slot to remove.
+    * @param last the slot after the last one to remove.
+    * @return nothing.
+    */
+    void eraseSlots(std::vector<Slot>::iterator first, std::vector<Slot>::iterator last);
+
+    /**
+    * @brief Moves the live records to the front of the store once the bytes removed records left
+    * behind outweigh them, so the store never grows past about twice what it holds.
+    * @return nothing.
+    */
+    void compact();
+
+    /**
+    * @brief Gets a view of every record, in a vector taken from the calling thread's arena.
+    * @pre An Arena::Scope is open, the vector lasts until it ends.
+    * @return the records in key order, valid until the buffer changes.
+    */
+    ArenaVector<RecordView> getRecordViews() const;
+
+    /**
+    * @brief Replaces the records of the buffer.
+    * @param records the records to store, in key order, which must not point into this buffer.
+    * @return nothing.
+    */
+    void setRecords(const ArenaVector<RecordView> &records);
 };
 
 
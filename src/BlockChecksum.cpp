@@ -0,0 +1,99 @@
+/**
+ * @file BlockChecksum.cpp
+ * @brief Implementation file for the BlockChecksum class.
+ */
+
+#include "BlockChecksum.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define BLOCKCHECKSUM_SSE42
+#endif
+
+using namespace std;
+
+static const uint32_t polynomial = 0x82F63B78;  // The Castagnoli polynomial, bit reversed
+
+/**
+ * Builds the table for checksumming a byte at a time.
+ */
+static array<uint32_t, 256> makeTable() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+static uint32_t computeSoftware(uint32_t crc, const char *data, size_t length) {
+    static const array<uint32_t, 256> table = makeTable();
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef BLOCKCHECKSUM_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t computeHardware(uint32_t crc, const char *data, size_t length) {
+    uint64_t crc64 = crc;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; i < length; i++) {
+        crc = _mm_crc32_u8(crc, static_cast<unsigned char>(data[i]));
+    }
+    return crc;
+}
+#endif
+
+bool BlockChecksum::isHardwareAccelerated() {
+#ifdef BLOCKCHECKSUM_SSE42
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+uint32_t BlockChecksum::compute(const char *data, size_t length) {
+#ifdef BLOCKCHECKSUM_SSE42
+    if (isHardwareAccelerated()) {
+        return ~computeHardware(0xFFFFFFFF, data, length);
+    }
+#endif
+    return ~computeSoftware(0xFFFFFFFF, data, length);
+}
+
+void BlockChecksum::stamp(std::string &block) {
+    uint32_t crc = compute(block.data(), block.size());
+    for (int i = 0; i < size; i++) {
+        block.push_back(static_cast<char>((crc >> (8 * i)) & 0xFF));
+    }
+}
+
+bool BlockChecksum::verify(const std::string &block) {
+    if (block.size() < static_cast<size_t>(size)) return false;
+
+    size_t length = block.size() - size;
+    uint32_t stored = 0;
+    for (int i = 0; i < size; i++) {
+        stored |= static_cast<uint32_t>(static_cast<unsigned char>(block[length + i])) << (8 * i);
+    }
+    if (stored == compute(block.data(), length)) return true;
+
+    // A block past the end of what was ever written reads back as zeros
+    return all_of(block.begin(), block.end(), [](char c) { return c == '\0'; });
+}
@@ -0,0 +1,56 @@
+/**
+ * @file BlockChecksum.h
+ * @brief Header file for the BlockChecksum class.
+ */
+
+/**
+ * @class BlockChecksum
+ * @brief CRC32C checksums kept at the end of every block.
+ * @details: A checksummed block is the block image followed by the CRC32C of the image as four little
+ * endian bytes, so the image is four bytes smaller than the block on disk. The checksum is computed
+ * with the SSE4.2 crc32 instruction when the processor has it, and with a lookup table otherwise,
+ * which gives the same result.
+ * Includes: Computing checksums, stamping them onto blocks and checking them.
+ * Assumes: Blocks that are all zeros were never written, and are not checked.
+ */
+
+#ifndef CSCI331_PROJECT4_BLOCKCHECKSUM_H
+#define CSCI331_PROJECT4_BLOCKCHECKSUM_H
+
+#include <cstdint>
+#include <string>
+
+class BlockChecksum {
+public:
+    static const int size = 4;     /**< Bytes taken by the checksum at the end of a block */
+
+    /**
+    * @brief Computes the CRC32C of bytes.
+    * @param data the bytes to checksum
+    * @param length number of bytes in data
+    * @return the checksum
+    */
+    static uint32_t compute(const char *data, size_t length);
+
+    /**
+    * @brief Appends the checksum of a block image to it.
+    * @param block the block image, which becomes size bytes longer
+    * @return nothing
+    */
+    static void stamp(std::string &block);
+
+    /**
+    * @brief Checks the checksum at the end of a block.
+    * @param block the block as read from disk, checksum included
+    * @return true if the checksum matches or the block was never written
+    */
+    static bool verify(const std::string &block);
+
+    /**
+    * @brief Tells whether checksums are computed with the crc32 instruction.
+    * @return true if the processor supports it
+    */
+    static bool isHardwareAccelerated();
+};
+
+#endif //CSCI331_PROJECT4_BLOCKCHECKSUM_H
@@ -0,0 +1,162 @@
+/**
+ * @file BlockCodec.cpp
+ * @brief Implementation file for the BlockCodec class.
+ */
+
+#include "BlockCodec.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+static const int minMatch = 4;       // Shortest match worth a sequence
+static const int hashBits = 12;      // Size of the match finder table
+static const int maxOffset = 65535;  // Farthest a match may reach back
+
+/**
+ * Reads four bytes for hashing and comparing.
+ */
+static uint32_t read32(const char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash32(uint32_t value) {
+    return (value * 2654435761u) >> (32 - hashBits);
+}
+
+/**
+ * Appends the bytes of a length past the 15 that fits in a token.
+ */
+static void putLength(string &out, int length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+/**
+ * Adds the extra bytes of a length to the count from a token, returns false if the data ends first.
+ */
+static bool getLength(const char *data, int size, int &pos, int &length) {
+    unsigned char byte;
+    do {
+        if (pos >= size) return false;
+        byte = static_cast<unsigned char>(data[pos++]);
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/**
+ * Appends one sequence, a run of literals and optionally a match.
+ */
+static void putSequence(string &out, const char *literals, int literalCount, int offset, int matchLength) {
+    int matchCode = matchLength > 0 ? matchLength - minMatch : 0;
+    char token = static_cast<char>((min(literalCount, 15) << 4) | min(matchCode, 15));
+    out.push_back(token);
+    if (literalCount >= 15) putLength(out, literalCount - 15);
+    out.append(literals, literalCount);
+
+    if (matchLength > 0) {
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (matchCode >= 15) putLength(out, matchCode - 15);
+    }
+}
+
+int BlockCodec::compress(const char *data, int size, string &out) {
+    vector<int> table(1 << hashBits, -1);
+    out.clear();
+
+    int anchor = 0;
+    int pos = 0;
+    while (pos + minMatch <= size) {
+        uint32_t sequence = read32(data + pos);
+        uint32_t slot = hash32(sequence);
+        int candidate = table[slot];
+        table[slot] = pos;
+
+        if (candidate < 0 || pos - candidate > maxOffset || read32(data + candidate) != sequence) {
+            pos++;
+            continue;
+        }
+
+        int length = minMatch;
+        while (pos + length < size && data[candidate + length] == data[pos + length]) {
+            length++;
+        }
+
+        putSequence(out, data + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+
+    // Whatever is left over goes out as literals
+    putSequence(out, data + anchor, size - anchor, 0, 0);
+    return out.size();
+}
+
+int BlockCodec::decompress(const char *data, int size, string &out) {
+    out.clear();
+
+    int pos = 0;
+    while (pos < size) {
+        unsigned char token = static_cast<unsigned char>(data[pos++]);
+
+        int literalCount = token >> 4;
+        if (literalCount == 15 && !getLength(data, size, pos, literalCount)) return -1;
+        if (literalCount > size - pos) return -1;
+        out.append(data + pos, literalCount);
+        pos += literalCount;
+
+        // The last sequence ends after its literals
+        if (pos == size) break;
+
+        if (size - pos < 2) return -1;
+        int offset = static_cast<unsigned char>(data[pos]) | (static_cast<unsigned char>(data[pos + 1]) << 8);
+        pos += 2;
+        int matchLength = token & 0x0F;
+        if (matchLength == 15 && !getLength(data, size, pos, matchLength)) return -1;
+        matchLength += minMatch;
+        if (offset == 0 || offset > static_cast<int>(out.size())) return -1;
+
+        // Copy one byte at a time, a match may overlap the bytes it produces
+        size_t from = out.size() - offset;
+        for (int i = 0; i < matchLength; i++) {
+            out.push_back(out[from + i]);
+        }
+    }
+
+    return out.size();
+}
+
+int BlockCodec::packBlock(const string &image, string &block) {
+    string compressed;
+    compress(image.data(), image.size(), compressed);
+
+    uint32_t length = compressed.size();
+    block.clear();
+    block.push_back(marker);
+    block.push_back(static_cast<char>(length >> 24));
+    block.push_back(static_cast<char>(length >> 16));
+    block.push_back(static_cast<char>(length >> 8));
+    block.push_back(static_cast<char>(length));
+    block += compressed;
+
+    return block.size();
+}
+
+int BlockCodec::unpackBlock(const string &block, string &image) {
+    if (block.size() < headerSize || block[0] != marker) return -1;
+
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(block.data());
+    uint32_t length = (uint32_t(bytes[1]) << 24) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 8) | bytes[4];
+    if (length > block.size() - headerSize) return -1;
+
+    return decompress(block.data() + headerSize, length, image);
+}
@@ -0,0 +1,69 @@
+/**
+ * @file BlockCodec.h
+ * @brief Header file for the BlockCodec class.
+ */
+
+/**
+ * @class BlockCodec
+ * @brief A small LZ77 compressor for whole blocks.
+ * @details: The compressed data is a series of sequences, each a token byte holding a literal count in
+ * its high four bits and a match length less four in its low four bits, any extra length bytes for the
+ * literal count, the literals, a two byte little endian offset back into the output, and any extra length
+ * bytes for the match. A count of 15 in the token is followed by bytes that are added to it until one is
+ * below 255. The last sequence has literals only. Matches are found with a hash of the next four bytes.
+ *
+ * A compressed block on disk is the marker byte 'Z', the compressed length as four big endian bytes,
+ * the compressed data, and zero padding. Leaves in a compressed file may grow pageFactor times larger in
+ * memory than a block on disk and are split once they no longer compress into one. Index blocks are not
+ * compressed, a changed key can shift how the rest of the block compresses by more than the key itself.
+ * Includes: Compressing and decompressing byte strings, framing them as blocks.
+ * Assumes: Matches reach back at most 64 KB, so every offset fits in two bytes; larger pages still compress.
+ */
+
+#ifndef CSCI331_PROJECT4_BLOCKCODEC_H
+#define CSCI331_PROJECT4_BLOCKCODEC_H
+
+#include <string>
+
+class BlockCodec {
+public:
+    static const char marker = 'Z';      /**< First byte of every compressed block */
+    static const int headerSize = 5;     /**< The marker and the compressed length */
+    static const int pageFactor = 4;     /**< How many times larger a node may be than its compressed block */
+
+    /**
+    * @brief Compresses bytes.
+    * @param data the bytes to compress
+    * @param size number of bytes in data
+    * @param out string to store the compressed bytes in
+    * @return the number of compressed bytes
+    */
+    static int compress(const char *data, int size, std::string &out);
+
+    /**
+    * @brief Decompresses bytes written by compress.
+    * @param data the compressed bytes
+    * @param size number of compressed bytes
+    * @param out string to store the original bytes in
+    * @return -1 if the data is corrupt, the number of bytes in out otherwise
+    */
+    static int decompress(const char *data, int size, std::string &out);
+
+    /**
+    * @brief Compresses a block image and frames it for disk.
+    * @param image the uncompressed block
+    * @param block string to store the framed block in, not padded
+    * @return the number of bytes in block
+    */
+    static int packBlock(const std::string &image, std::string &block);
+
+    /**
+    * @brief Unframes and decompresses a block written by packBlock.
+    * @param block the block as read from disk
+    * @param image string to store the uncompressed block in
+    * @return -1 if the block is not compressed or is corrupt, the size of image otherwise
+    */
+    static int unpackBlock(const std::string &block, std::string &image);
+};
+
+#endif //CSCI331_PROJECT4_BLOCKCODEC_H
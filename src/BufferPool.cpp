@@ -0,0 +1,178 @@
+/**
+ * @file BufferPool.cpp
+ * @brief Implementation file for the BufferPool class.
+ */
+
+#include "BufferPool.h"
+#include "BlockCodec.h"
+#include "TreeStats.h"
+#include <vector>
+
+using namespace std;
+
+Frame::Frame(const BTreeNode &node, int RBN) : node(node), rbn(RBN), pinCount(0), dirty(false) {
+
+}
+
+BufferPool::BufferPool(std::fstream &file, HeaderBuffer &hbuf, int order, int capacity)
+    : file(file), headerBuffer(hbuf), order(order), capacity(capacity) {
+
+}
+
+BufferPool::~BufferPool() {
+    clear();
+}
+
+Frame* BufferPool::fetch(int RBN) {
+    lock_guard<mutex> guard(poolMutex);
+
+    auto it = frames.find(RBN);
+    if (it != frames.end()) {
+        Frame* frame = it->second;
+        frame->pinCount++;
+        lru.splice(lru.begin(), lru, frame->lruPosition);
+        TreeStats::add(TreeStats::CACHE_HITS);
+        return frame;
+    }
+
+    // Miss, read the node from file straight into a frame
+    Frame* frame = takeFrame(RBN);
+    if (frame->node.read(file, headerBuffer.headerRecordSize, RBN) == -1) {
+        file.clear();
+        spareFrames.push_back(frame);
+        return nullptr;
+    }
+    frame->node.setCurRBN(RBN);
+
+    return install(frame);
+}
+
+Frame* BufferPool::create(int RBN) {
+    lock_guard<mutex> guard(poolMutex);
+
+    BTreeNode node = makeNode();
+    node.setCurRBN(RBN);
+
+    // A stale copy of a reused block must not survive
+    auto it = frames.find(RBN);
+    if (it != frames.end()) {
+        Frame* frame = it->second;
+        frame->node = node;
+        frame->pinCount++;
+        frame->dirty = true;
+        lru.splice(lru.begin(), lru, frame->lruPosition);
+        return frame;
+    }
+
+    Frame* frame = takeFrame(RBN);
+    frame->node = node;
+    install(frame);
+    frame->dirty = true;
+    return frame;
+}
+
+void BufferPool::unpin(Frame* frame, bool dirty) {
+    lock_guard<mutex> guard(poolMutex);
+
+    if (dirty) frame->dirty = true;
+    frame->pinCount--;
+
+    if (static_cast<int>(frames.size()) > capacity) {
+        evict();
+    }
+}
+
+int BufferPool::flush() {
+    vector<Frame*> dirtyFrames;
+
+    // Pin the dirty frames so they stay put while the pool is unlocked
+    {
+        lock_guard<mutex> guard(poolMutex);
+        for (auto &entry : frames) {
+            if (entry.second->dirty) {
+                entry.second->pinCount++;
+                dirtyFrames.push_back(entry.second);
+            }
+        }
+    }
+
+    int status = 0;
+    for (Frame* frame : dirtyFrames) {
+        // Latch the frame so a writer still holding it finishes first
+        unique_lock<shared_timed_mutex> latch(frame->latch);
+        lock_guard<mutex> guard(poolMutex);
+        if (frame->node.write(file, headerBuffer.headerRecordSize, frame->rbn) == -1) {
+            status = -1;
+        }
+        frame->dirty = false;
+        frame->pinCount--;
+    }
+
+    lock_guard<mutex> guard(poolMutex);
+    file.flush();
+    return status;
+}
+
+void BufferPool::clear() {
+    lock_guard<mutex> guard(poolMutex);
+
+    for (auto &entry : frames) {
+        delete entry.second;
+    }
+    for (Frame* frame : spareFrames) {
+        delete frame;
+    }
+    frames.clear();
+    spareFrames.clear();
+    lru.clear();
+}
+
+void BufferPool::evict() {
+    auto it = lru.end();
+    while (static_cast<int>(frames.size()) > capacity && it != lru.begin()) {
+        --it;
+        Frame* frame = *it;
+        if (frame->pinCount > 0) continue;
+
+        if (frame->dirty) {
+            frame->node.write(file, headerBuffer.headerRecordSize, frame->rbn);
+        }
+
+        frames.erase(frame->rbn);
+        it = lru.erase(it);
+        spareFrames.push_back(frame);
+    }
+}
+
+BTreeNode BufferPool::makeNode() {
+    bool checksummed = headerBuffer.blockChecksum == "CRC32C";
+
+    // Compressed nodes grow larger in memory than the block they are written to
+    if (headerBuffer.blockCodec == "LZ") {
+        return BTreeNode(order, headerBuffer.blockSize * BlockCodec::pageFactor, headerBuffer.minimumBlockCapacity,
+                         BlockBuffer::parseEncoding(headerBuffer.leafEncoding), headerBuffer.blockSize, checksummed);
+    }
+    return BTreeNode(order, headerBuffer.blockSize, headerBuffer.minimumBlockCapacity,
+                     BlockBuffer::parseEncoding(headerBuffer.leafEncoding), 0, checksummed);
+}
+
+Frame* BufferPool::install(Frame* frame) {
+    lru.push_front(frame);
+    frame->lruPosition = lru.begin();
+    frame->pinCount = 1;
+    frames[frame->rbn] = frame;
+    return frame;
+}
+
+Frame* BufferPool::takeFrame(int RBN) {
+    if (spareFrames.empty()) {
+        return new Frame(makeNode(), RBN);
+    }
+
+    Frame* frame = spareFrames.back();
+    spareFrames.pop_back();
+    frame->rbn = RBN;
+    frame->pinCount = 0;
+    frame->dirty = false;
+    return frame;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file BufferPool.h
+ * @brief Header file for the BufferPool class.
+ */
+
+/**
+ * @class BufferPool
+ * @brief A cache of B+ tree nodes kept in memory between operations.
+ * @details: Nodes are read from the file once and kept in frames keyed by their relative block number.
+ * Each frame carries a reader/writer latch that callers take while they use the node, and a pin count
+ * that keeps it from being evicted while latched. Dirty frames are written back on eviction or flush.
+ * Evicted frames are kept and read the next missing node into, so a miss does not build a node and a
+ * warm pool reads without allocating frames. There are never more frames than the most the pool has
+ * cached at once.
+ * Includes: Fetching, creating, unpinning and flushing frames, least recently used eviction.
+ * Assumes: The file stream is open and only accessed through this pool while the tree is in use.
+ */
+
+#ifndef CSCI331_PROJECT4_BUFFERPOOL_H
+#define CSCI331_PROJECT4_BUFFERPOOL_H
+
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include "Arena.h"
+#include "BTreeNode.h"
+#include "HeaderBuffer.h"
+
+/**
+ * @struct Frame
+ * @brief A cached node along with its latch and bookkeeping.
+ */
+struct Frame {
+    /**
+    * @brief Constructor for a frame.
+    * @param node the node to cache
+    * @param RBN the block the node belongs to
+    */
+    Frame(const BTreeNode &node, int RBN);
+
+    BTreeNode node;                          /**< The cached node */
+    std::shared_timed_mutex latch;           /**< Shared for readers, exclusive for writers */
+    int rbn;                                 /**< The relative block number of the node */
+    int pinCount;                            /**< Number of users currently holding the frame */
+    bool dirty;                              /**< True if the node must be written before eviction */
+    std::list<Frame*>::iterator lruPosition; /**< Position of the frame in the recently used list */
+};
+
+typedef ArenaVector<Frame*> FramePath; /**< Frames latched on the way down the tree, kept in the arena */
+
+class BufferPool {
+public:
+    /**
+    * @brief Constructor for the buffer pool.
+    * @param file the open tree file to read and write nodes from
+    * @param hbuf the header of the tree file
+    * @param order the order of the b tree
+    * @param capacity the number of frames to keep before evicting
+    */
+    BufferPool(std::fstream &file, HeaderBuffer &hbuf, int order, int capacity = 4096);
+
+    /**
+    * @brief Destructor, frees all frames without writing them.
+    */
+    ~BufferPool();
+
+    /**
+    * @brief Pins the frame for a block, reading it from file if it is not cached.
+    * @param RBN the block to fetch
+    * @return the pinned frame, or nullptr if the block could not be read
+    */
+    Frame* fetch(int RBN);
+
+    /**
+    * @brief Pins a frame for a freshly allocated block holding an empty leaf.
+    * @param RBN the block to create
+    * @return the pinned frame, marked dirty
+    */
+    Frame* create(int RBN);
+
+    /**
+    * @brief Releases a pin on a frame.
+    * @param frame the frame to unpin
+    * @param dirty true if the caller modified the node
+    * @return nothing
+    */
+    void unpin(Frame* frame, bool dirty);
+
+    /**
+    * @brief Writes all dirty frames to file.
+    * @return -1 if a write failed, 0 otherwise
+    */
+    int flush();
+
+    /**
+    * @brief Drops every cached frame without writing it.
+    * @pre No frames are pinned.
+    * @return nothing
+    */
+    void clear();
+
+    /**
+    * @brief Creates an empty leaf laid out as the header describes.
+    * @return the new node
+    */
+    BTreeNode makeNode();
+
+private:
+    std::fstream &file;                         /**< The tree file */
+    HeaderBuffer &headerBuffer;                 /**< The header of the tree file */
+    int order;                                  /**< The order of the b tree */
+    int capacity;                               /**< Number of frames to keep before evicting */
+    std::unordered_map<int, Frame*> frames;     /**< Cached frames keyed by RBN */
+    std::vector<Frame*> spareFrames;            /**< Evicted frames waiting to be reused */
+    std::list<Frame*> lru;                      /**< Frames from most to least recently used */
+    std::mutex poolMutex;                       /**< Guards the frame table and the file stream */
+
+    /**
+    * @brief Writes and frees unpinned frames until the pool is within capacity.
+    * @pre poolMutex is held.
+    * @return nothing
+    */
+    void evict();
+
+    /**
+    * @brief Adds a frame to the table and pins it.
+    * @pre poolMutex is held.
+    * @param frame the frame to add
+    * @return the pinned frame
+    */
+    Frame* install(Frame* frame);
+
+    /**
+    * @brief Takes a spare frame, or makes one if there is none.
+    * @pre poolMutex is held.
+    * @param RBN the block the frame is for
+    * @return an unpinned, clean frame whose node holds whatever it last held
+    */
+    Frame* takeFrame(int RBN);
+};
+
+#endif //CSCI331_PROJECT4_BUFFERPOOL_H
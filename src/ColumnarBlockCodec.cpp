@@ -0,0 +1,301 @@
+/**
+ * @file ColumnarBlockCodec.cpp
+ * @brief Implementation file for the ColumnarBlockCodec class.
+ */
+
+#include "ColumnarBlockCodec.h"
+#include <cstdint>
+#include <cstdlib>
+
+using namespace std;
+
+// Bytes each record takes in the fixed width minipages: key, kind, State, Lat, Long, decimals, two offsets
+static const int fixedRecordBytes = 4 + 1 + 1 + 4 + 4 + 1 + 4;
+// Most decimals and whole degree digits a coordinate may have and still fit in millionths
+static const int maxDecimals = 6;
+static const int maxWholeDigits = 3;
+
+static void putUint16(string &out, unsigned int value) {
+    out.push_back(static_cast<char>(value));
+    out.push_back(static_cast<char>(value >> 8));
+}
+
+static void putInt32(string &out, int value) {
+    uint32_t bits = static_cast<uint32_t>(value);
+    out.push_back(static_cast<char>(bits));
+    out.push_back(static_cast<char>(bits >> 8));
+    out.push_back(static_cast<char>(bits >> 16));
+    out.push_back(static_cast<char>(bits >> 24));
+}
+
+static unsigned int getUint16(const char *in) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(in);
+    return bytes[0] | (bytes[1] << 8);
+}
+
+static int getInt32(const char *in) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(in);
+    return static_cast<int>(uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) |
+                            (uint32_t(bytes[3]) << 24));
+}
+
+int ColumnarBlockCodec::encode(const vector<string> &records, int prevRBN, int nextRBN, int highKey, string &out) {
+    int count = records.size();
+    if (count > 0xFFFF) return -1;
+
+    vector<string> stateNames;
+    string keys, kinds, states, lat, lon, decimals, offsets, heap;
+
+    // A block holds a few states, so a linear search beats hashing
+    auto lookup = [&](const string &text) {
+        for (int i = 0; i < stateNames.size(); i++) {
+            if (stateNames[i] == text) return i;
+        }
+        if (stateNames.size() == rawState || text.size() > 0xFF) return static_cast<int>(rawState);
+        stateNames.push_back(text);
+        return static_cast<int>(stateNames.size() - 1);
+    };
+
+    for (const string &record : records) {
+        int key = atoi(record.c_str());
+        putInt32(keys, key);
+
+        // Split off the character the text ended with, then the fields
+        RecordKind kind = STRUCTURED_PLAIN;
+        size_t end = record.size();
+        if (end > 0 && record[end - 1] == '\n') {
+            kind = STRUCTURED_NEWLINE;
+            end--;
+        } else if (end > 0 && record[end - 1] == ',') {
+            kind = STRUCTURED_DELIMITER;
+            end--;
+        }
+
+        vector<string> fields;
+        size_t start = 0;
+        while (fields.size() < 7) {
+            size_t comma = record.find(',', start);
+            if (comma == string::npos || comma >= end) {
+                fields.push_back(record.substr(start, end - start));
+                break;
+            }
+            fields.push_back(record.substr(start, comma - start));
+            start = comma + 1;
+        }
+
+        int latValue, lonValue, latDecimals, lonDecimals;
+        bool structured = fields.size() == 6 && to_string(key) == fields[0]
+                          && encodeCoordinate(fields[4], latValue, latDecimals)
+                          && encodeCoordinate(fields[5], lonValue, lonDecimals);
+        int state = structured ? lookup(fields[2]) : rawState;
+
+        putUint16(offsets, heap.size());
+        if (state == rawState) {
+            kinds.push_back(static_cast<char>(RAW));
+            states.push_back(static_cast<char>(rawState));
+            putInt32(lat, 0);
+            putInt32(lon, 0);
+            decimals.push_back(0);
+            heap += record;
+            putUint16(offsets, heap.size());
+            continue;
+        }
+
+        kinds.push_back(static_cast<char>(kind));
+        states.push_back(static_cast<char>(state));
+        putInt32(lat, latValue);
+        putInt32(lon, lonValue);
+        decimals.push_back(static_cast<char>(latDecimals << 4 | lonDecimals));
+        heap += fields[1];
+        putUint16(offsets, heap.size());
+        heap += fields[3];
+    }
+    putUint16(offsets, heap.size());
+    if (heap.size() > 0xFFFF) return -1;
+
+    out.clear();
+    out.push_back(marker);
+    putUint16(out, count);
+    putInt32(out, prevRBN);
+    putInt32(out, nextRBN);
+    putInt32(out, highKey);
+    out.push_back(static_cast<char>(stateNames.size()));
+    for (const string &name : stateNames) {
+        out.push_back(static_cast<char>(name.size()));
+        out += name;
+    }
+    out += keys;
+    out += kinds;
+    out += states;
+    out += lat;
+    out += lon;
+    out += decimals;
+    out += offsets;
+    out += heap;
+
+    return out.size();
+}
+
+bool ColumnarBlockCodec::readHeader(const char *data, int size, int &count, int &prevRBN, int &nextRBN,
+                                    int &highKey, vector<string> &stateNames, int &pos) {
+    if (size < 16 || data[0] != marker) return false;
+
+    count = getUint16(data + 1);
+    prevRBN = getInt32(data + 3);
+    nextRBN = getInt32(data + 7);
+    highKey = getInt32(data + 11);
+    int stateCount = static_cast<unsigned char>(data[15]);
+
+    pos = 16;
+    stateNames.clear();
+    for (int i = 0; i < stateCount; i++) {
+        if (pos >= size) return false;
+        int length = static_cast<unsigned char>(data[pos++]);
+        if (length > size - pos) return false;
+        stateNames.emplace_back(data + pos, length);
+        pos += length;
+    }
+
+    // The fixed width minipages and the offset past the end of the heap
+    return static_cast<long long>(count) * fixedRecordBytes + 2 <= size - pos;
+}
+
+int ColumnarBlockCodec::decode(const char *data, int size, vector<string> &records, int &prevRBN, int &nextRBN,
+                               int &highKey) {
+    int count, pos;
+    vector<string> stateNames;
+    if (!readHeader(data, size, count, prevRBN, nextRBN, highKey, stateNames, pos)) return -1;
+
+    const char *keys = data + pos;
+    const char *kinds = keys + 4 * count;
+    const char *states = kinds + count;
+    const char *lat = states + count;
+    const char *lon = lat + 4 * count;
+    const char *decimals = lon + 4 * count;
+    const char *offsets = decimals + count;
+    const char *heap = offsets + 2 * (2 * count + 1);
+    int heapSize = getUint16(offsets + 4 * count);
+    if (heapSize > size - (heap - data)) return -1;
+
+    records.clear();
+    records.reserve(count);
+    for (int i = 0; i < count; i++) {
+        unsigned int first = getUint16(offsets + 4 * i);
+        unsigned int second = getUint16(offsets + 4 * i + 2);
+        unsigned int third = getUint16(offsets + 4 * i + 4);
+        if (first > second || second > third || third > static_cast<unsigned int>(heapSize)) return -1;
+
+        records.emplace_back();
+        string &record = records.back();
+        RecordKind kind = static_cast<RecordKind>(kinds[i]);
+        if (kind == RAW) {
+            record.assign(heap + first, second - first);
+            continue;
+        }
+
+        unsigned char state = static_cast<unsigned char>(states[i]);
+        if (state >= stateNames.size()) return -1;
+        unsigned char places = static_cast<unsigned char>(decimals[i]);
+
+        record = to_string(getInt32(keys + 4 * i));
+        record.push_back(',');
+        record.append(heap + first, second - first);
+        record.push_back(',');
+        record += stateNames[state];
+        record.push_back(',');
+        record.append(heap + second, third - second);
+        record.push_back(',');
+        decodeCoordinate(getInt32(lat + 4 * i), places >> 4, record);
+        record.push_back(',');
+        decodeCoordinate(getInt32(lon + 4 * i), places & 0x0F, record);
+
+        if (kind == STRUCTURED_NEWLINE) {
+            record.push_back('\n');
+        } else if (kind == STRUCTURED_DELIMITER) {
+            record.push_back(',');
+        }
+    }
+
+    return (heap - data) + heapSize;
+}
+
+int ColumnarBlockCodec::readColumns(const char *data, int size, LeafColumns &columns) {
+    int count, pos, prevRBN, nextRBN, highKey;
+    if (!readHeader(data, size, count, prevRBN, nextRBN, highKey, columns.stateNames, pos)) return -1;
+
+    const char *keys = data + pos;
+    const char *states = keys + 5 * count;
+    const char *lat = states + count;
+    const char *lon = lat + 4 * count;
+
+    columns.keys.resize(count);
+    columns.states.assign(states, states + count);
+    columns.lat.resize(count);
+    columns.lon.resize(count);
+    for (int i = 0; i < count; i++) {
+        columns.keys[i] = getInt32(keys + 4 * i);
+        columns.lat[i] = getInt32(lat + 4 * i);
+        columns.lon[i] = getInt32(lon + 4 * i);
+    }
+
+    return count;
+}
+
+bool ColumnarBlockCodec::encodeCoordinate(const string &text, int &value, int &decimals) {
+    size_t i = 0;
+    bool negative = i < text.size() && text[i] == '-';
+    if (negative) i++;
+
+    int whole = 0;
+    int wholeDigits = 0;
+    int fraction = 0;
+    decimals = -1;
+    for (; i < text.size(); i++) {
+        if (text[i] == '.' && decimals == -1 && wholeDigits > 0) {
+            decimals = 0;
+        } else if (text[i] >= '0' && text[i] <= '9' && decimals == -1 && wholeDigits < maxWholeDigits) {
+            whole = whole * 10 + (text[i] - '0');
+            wholeDigits++;
+        } else if (text[i] >= '0' && text[i] <= '9' && decimals >= 0 && decimals < maxDecimals) {
+            fraction = fraction * 10 + (text[i] - '0');
+            decimals++;
+        } else {
+            return false;
+        }
+    }
+    if (wholeDigits == 0 || decimals == 0) return false;
+    if (decimals == -1) decimals = 0;
+
+    for (int d = decimals; d < maxDecimals; d++) {
+        fraction *= 10;
+    }
+    value = whole * coordinateScale + fraction;
+    if (negative) value = -value;
+
+    // Leading zeros and "-0" do not survive, keep those records raw
+    string check;
+    decodeCoordinate(value, decimals, check);
+    return check == text;
+}
+
+void ColumnarBlockCodec::decodeCoordinate(int value, int decimals, string &text) {
+    if (decimals > maxDecimals) decimals = maxDecimals;
+    if (value < 0) {
+        text.push_back('-');
+        value = -value;
+    }
+
+    // Drop the decimals the text did not have, they are zeros
+    for (int d = decimals; d < maxDecimals; d++) {
+        value /= 10;
+    }
+
+    string number = to_string(value);
+    if (static_cast<int>(number.size()) <= decimals) {
+        number.insert(0, decimals + 1 - number.size(), '0');
+    }
+    if (decimals > 0) {
+        number.insert(number.size() - decimals, 1, '.');
+    }
+    text += number;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file ColumnarBlockCodec.h
+ * @brief Header file for the ColumnarBlockCodec class.
+ */
+
+/**
+ * @class ColumnarBlockCodec
+ * @brief Encodes the records of a leaf block column by column.
+ * @details: A columnar block keeps each field of its records together in a minipage, so a scan that
+ * needs a few fields reads only those. It starts with the marker byte 'P', then:
+ *   header: 2 byte record count, 4 byte prevRBN, nextRBN and highKey, 1 byte State count
+ *   State dictionary: for each entry a 1 byte length and its bytes
+ *   minipages, each count entries long: 4 byte keys, 1 byte kinds, 1 byte State codes,
+ *     4 byte Lat and 4 byte Long in millionths of a degree, 1 byte decimal counts (Lat high, Long low),
+ *     2 byte heap offsets, two per record and one past the end
+ *   heap: the place name and County of each record, or for RAW records the record text and nothing
+ * Numbers are little endian. Records whose text would not come back byte for byte from the columns,
+ * such as a coordinate with more than six decimals, are RAW, with State code rawState and zero coordinates.
+ * Includes: Encoding and decoding record text, reading the key, State and coordinate columns alone.
+ * Assumes: Records are comma separated with an integer key first and are given in key order.
+ */
+
+#ifndef CSCI331_PROJECT4_COLUMNARBLOCKCODEC_H
+#define CSCI331_PROJECT4_COLUMNARBLOCKCODEC_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @struct LeafColumns
+ * @brief The key, State and coordinate columns of a columnar block.
+ */
+struct LeafColumns {
+    std::vector<int> keys;                  /**< Key of each record */
+    std::vector<unsigned char> states;      /**< Index into stateNames of each record, rawState for RAW records */
+    std::vector<int> lat;                   /**< Latitude of each record, in millionths of a degree */
+    std::vector<int> lon;                   /**< Longitude of each record, in millionths of a degree */
+    std::vector<std::string> stateNames;    /**< The State dictionary of the block */
+};
+
+class ColumnarBlockCodec {
+public:
+    static const char marker = 'P';                 /**< First byte of every columnar block */
+    static const unsigned char rawState = 0xFF;     /**< State code of records kept as text */
+    static const int coordinateScale = 1000000;     /**< Coordinates are stored in millionths */
+
+    /**
+    * @brief Encodes records and block metadata.
+    * @param records the text of each record, without length indicators, in key order
+    * @param prevRBN the previous block in the sequence set
+    * @param nextRBN the next block in the sequence set
+    * @param highKey the largest key that belongs in the block, -1 when unbounded
+    * @param out string to store the encoded block in
+    * @return -1 if the records do not fit the format, the number of bytes in out otherwise
+    */
+    static int encode(const std::vector<std::string> &records, int prevRBN, int nextRBN, int highKey,
+                      std::string &out);
+
+    /**
+    * @brief Decodes a block written by encode.
+    * @param data the encoded block, starting with the marker
+    * @param size number of bytes available in data
+    * @param records vector to store the text of each record in
+    * @param prevRBN stores the previous block in the sequence set
+    * @param nextRBN stores the next block in the sequence set
+    * @param highKey stores the largest key that belongs in the block
+    * @return -1 if the data is not a valid columnar block, the number of bytes decoded otherwise
+    */
+    static int decode(const char *data, int size, std::vector<std::string> &records, int &prevRBN,
+                      int &nextRBN, int &highKey);
+
+    /**
+    * @brief Reads the key, State and coordinate columns without touching the heap.
+    * @param data the encoded block, starting with the marker
+    * @param size number of bytes available in data
+    * @param columns stores the columns
+    * @return -1 if the data is not a valid columnar block, the number of records otherwise
+    */
+    static int readColumns(const char *data, int size, LeafColumns &columns);
+
+private:
+    /**
+    * @brief How a record is stored, including the character that ended its text.
+    */
+    enum RecordKind : unsigned char {
+        RAW = 0,                  /**< The text as it was */
+        STRUCTURED_NEWLINE = 1,   /**< Fields, text ended in a newline (loaded from a file) */
+        STRUCTURED_DELIMITER = 2, /**< Fields, text ended in a comma (packed field by field) */
+        STRUCTURED_PLAIN = 3      /**< Fields, nothing after the last field */
+    };
+
+    /**
+    * @brief Converts a coordinate to millionths of a degree.
+    * @param text the coordinate as written in the record
+    * @param value stores the coordinate in millionths
+    * @param decimals stores how many decimals the text had
+    * @return false if the text would not come back the same, and so must be kept raw
+    */
+    static bool encodeCoordinate(const std::string &text, int &value, int &decimals);
+
+    /**
+    * @brief Converts a coordinate in millionths back to text.
+    * @param value the coordinate in millionths
+    * @param decimals how many decimals to write
+    * @param text string to append the coordinate to
+    * @return nothing
+    */
+    static void decodeCoordinate(int value, int decimals, std::string &text);
+
+    /**
+    * @brief Reads the header and State dictionary, and checks every minipage fits in the data.
+    * @param data the encoded block, starting with the marker
+    * @param size number of bytes available in data
+    * @param count stores the number of records
+    * @param prevRBN stores the previous block in the sequence set
+    * @param nextRBN stores the next block in the sequence set
+    * @param highKey stores the largest key that belongs in the block
+    * @param stateNames stores the State dictionary
+    * @param pos stores where the key minipage starts
+    * @return false if the data is not a valid columnar block
+    */
+    static bool readHeader(const char *data, int size, int &count, int &prevRBN, int &nextRBN, int &highKey,
+                           std::vector<std::string> &stateNames, int &pos);
+};
+
+#endif //CSCI331_PROJECT4_COLUMNARBLOCKCODEC_H
@@ -0,0 +1,257 @@
+/**
+ * @file CompactBlockCodec.cpp
+ * @brief Implementation file for the CompactBlockCodec class.
+ */
+
+#include "CompactBlockCodec.h"
+#include <cstdlib>
+
+using namespace std;
+
+// Most decimals a fixed point coordinate keeps, they share a 4 bit field with the digits
+static const int maxDecimals = 15;
+
+/**
+ * Appends an unsigned integer seven bits at a time, low bits first.
+ */
+static void putVarint(string &out, unsigned long long value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/**
+ * Reads an integer written by putVarint, returns false if the data ends first.
+ */
+static bool getVarint(const char *data, int size, int &pos, unsigned long long &value) {
+    value = 0;
+    for (int shift = 0; pos < size && shift < 64; shift += 7) {
+        unsigned char byte = static_cast<unsigned char>(data[pos++]);
+        value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * Maps signed values to unsigned ones so small negative numbers stay short.
+ */
+static unsigned long long zigzag(long long value) {
+    return (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63);
+}
+
+static long long unzigzag(unsigned long long value) {
+    return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+}
+
+/**
+ * Appends a length and the bytes of a string.
+ */
+static void putString(string &out, const string &text) {
+    putVarint(out, text.size());
+    out += text;
+}
+
+/**
+ * Appends a string written by putString, returns false if the data ends first.
+ */
+static bool getString(const char *data, int size, int &pos, string &text) {
+    unsigned long long length;
+    if (!getVarint(data, size, pos, length) || length > static_cast<unsigned long long>(size - pos)) {
+        return false;
+    }
+    text.append(data + pos, length);
+    pos += length;
+    return true;
+}
+
+int CompactBlockCodec::encode(const vector<string> &records, int prevRBN, int nextRBN, int highKey, string &out) {
+    vector<string> dictionary;
+    string body;
+    long long previousKey = 0;
+
+    // A block holds a few states and counties, so a linear search beats hashing
+    auto lookup = [&](const string &text) {
+        for (int i = 0; i < dictionary.size(); i++) {
+            if (dictionary[i] == text) return i;
+        }
+        dictionary.push_back(text);
+        return static_cast<int>(dictionary.size() - 1);
+    };
+
+    for (const string &record : records) {
+        long long key = atol(record.c_str());
+        putVarint(body, zigzag(key - previousKey));
+        previousKey = key;
+
+        // Split off the character the text ended with, then the fields
+        RecordKind kind = STRUCTURED_PLAIN;
+        size_t end = record.size();
+        if (end > 0 && record[end - 1] == '\n') {
+            kind = STRUCTURED_NEWLINE;
+            end--;
+        } else if (end > 0 && record[end - 1] == ',') {
+            kind = STRUCTURED_DELIMITER;
+            end--;
+        }
+
+        vector<string> fields;
+        size_t start = 0;
+        while (fields.size() < 7) {
+            size_t comma = record.find(',', start);
+            if (comma == string::npos || comma >= end) {
+                fields.push_back(record.substr(start, end - start));
+                break;
+            }
+            fields.push_back(record.substr(start, comma - start));
+            start = comma + 1;
+        }
+
+        unsigned long long lat, lon;
+        bool structured = fields.size() == 6 && to_string(key) == fields[0]
+                          && encodeCoordinate(fields[4], lat) && encodeCoordinate(fields[5], lon);
+
+        if (!structured) {
+            body.push_back(static_cast<char>(RAW));
+            putString(body, record);
+            continue;
+        }
+
+        body.push_back(static_cast<char>(kind));
+        putString(body, fields[1]);
+        putVarint(body, lookup(fields[2]));
+        putVarint(body, lookup(fields[3]));
+        putVarint(body, lat);
+        putVarint(body, lon);
+    }
+
+    out.clear();
+    out.push_back(marker);
+    putVarint(out, records.size());
+    putVarint(out, prevRBN);
+    putVarint(out, nextRBN);
+    putVarint(out, zigzag(highKey));
+    putVarint(out, dictionary.size());
+    for (const string &entry : dictionary) {
+        putString(out, entry);
+    }
+    out += body;
+
+    return out.size();
+}
+
+int CompactBlockCodec::decode(const char *data, int size, vector<string> &records, int &prevRBN, int &nextRBN,
+                              int &highKey) {
+    if (size < 1 || data[0] != marker) return -1;
+
+    int pos = 1;
+    unsigned long long count, prev, next, high, dictionarySize;
+    if (!getVarint(data, size, pos, count) || !getVarint(data, size, pos, prev) ||
+        !getVarint(data, size, pos, next) || !getVarint(data, size, pos, high) ||
+        !getVarint(data, size, pos, dictionarySize) || dictionarySize > static_cast<unsigned long long>(size)) {
+        return -1;
+    }
+    prevRBN = prev;
+    nextRBN = next;
+    highKey = unzigzag(high);
+
+    vector<string> dictionary(dictionarySize);
+    for (auto &entry : dictionary) {
+        if (!getString(data, size, pos, entry)) return -1;
+    }
+
+    records.clear();
+    if (count > static_cast<unsigned long long>(size)) return -1;
+    records.reserve(count);
+    long long key = 0;
+
+    for (unsigned long long i = 0; i < count; i++) {
+        unsigned long long delta;
+        if (!getVarint(data, size, pos, delta) || pos >= size) return -1;
+        key += unzigzag(delta);
+        RecordKind kind = static_cast<RecordKind>(data[pos++]);
+
+        records.emplace_back();
+        string &record = records.back();
+        if (kind == RAW) {
+            if (!getString(data, size, pos, record)) return -1;
+            continue;
+        }
+
+        unsigned long long state, county, lat, lon;
+        record = to_string(key);
+        record.push_back(',');
+        if (!getString(data, size, pos, record) || !getVarint(data, size, pos, state) ||
+            !getVarint(data, size, pos, county) || !getVarint(data, size, pos, lat) ||
+            !getVarint(data, size, pos, lon) || state >= dictionarySize || county >= dictionarySize) {
+            return -1;
+        }
+        record.push_back(',');
+        record += dictionary[state];
+        record.push_back(',');
+        record += dictionary[county];
+        record.push_back(',');
+        decodeCoordinate(lat, record);
+        record.push_back(',');
+        decodeCoordinate(lon, record);
+
+        if (kind == STRUCTURED_NEWLINE) {
+            record.push_back('\n');
+        } else if (kind == STRUCTURED_DELIMITER) {
+            record.push_back(',');
+        }
+    }
+
+    return pos;
+}
+
+bool CompactBlockCodec::encodeCoordinate(const string &text, unsigned long long &value) {
+    size_t i = 0;
+    bool negative = i < text.size() && text[i] == '-';
+    if (negative) i++;
+
+    long long digits = 0;
+    int digitCount = 0;
+    int decimals = -1;
+    for (; i < text.size(); i++) {
+        if (text[i] == '.' && decimals == -1 && digitCount > 0) {
+            decimals = 0;
+        } else if (text[i] >= '0' && text[i] <= '9' && digitCount < 18) {
+            digits = digits * 10 + (text[i] - '0');
+            digitCount++;
+            if (decimals != -1) decimals++;
+        } else {
+            return false;
+        }
+    }
+    if (digitCount == 0 || decimals == 0 || decimals > maxDecimals) return false;
+    if (decimals == -1) decimals = 0;
+
+    value = zigzag(negative ? -digits : digits) << 4 | decimals;
+
+    // Leading zeros and "-0" do not survive, keep those records raw
+    string check;
+    decodeCoordinate(value, check);
+    return check == text;
+}
+
+void CompactBlockCodec::decodeCoordinate(unsigned long long value, string &text) {
+    int decimals = value & 0xF;
+    long long digits = unzigzag(value >> 4);
+
+    if (digits < 0) {
+        text.push_back('-');
+        digits = -digits;
+    }
+
+    string number = to_string(digits);
+    if (static_cast<int>(number.size()) <= decimals) {
+        number.insert(0, decimals + 1 - number.size(), '0');
+    }
+    if (decimals > 0) {
+        number.insert(number.size() - decimals, 1, '.');
+    }
+    text += number;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file CompactBlockCodec.h
+ * @brief Header file for the CompactBlockCodec class.
+ */
+
+/**
+ * @class CompactBlockCodec
+ * @brief Encodes the records of a leaf block in a compact binary form.
+ * @details: A compact block starts with the marker byte 'C', followed by the block metadata and a
+ * dictionary of the State and County strings used in the block, then the records in key order:
+ *   varint numRecords, prevRBN, nextRBN, zigzag highKey
+ *   varint dictionary size, then for each entry a varint length and its bytes
+ *   per record: zigzag varint difference from the previous key, a kind byte, then
+ *     for STRUCTURED_* kinds: varint place name length and bytes, varint State and County
+ *     dictionary indexes, and Lat and Long as fixed point values (zigzag digits << 4 | decimals)
+ *     for the RAW kind: varint length and the record text as it was
+ * Records whose text would not come back byte for byte from the structured form, such as a
+ * coordinate written as ".5", are kept RAW, so decoding always returns exactly what was encoded.
+ * Includes: Encoding and decoding record text, varint helpers.
+ * Assumes: Records are comma separated with an integer key first and are given in key order.
+ */
+
+#ifndef CSCI331_PROJECT4_COMPACTBLOCKCODEC_H
+#define CSCI331_PROJECT4_COMPACTBLOCKCODEC_H
+
+#include <string>
+#include <vector>
+
+class CompactBlockCodec {
+public:
+    static const char marker = 'C'; /**< First byte of every compact block */
+
+    /**
+    * @brief Encodes records and block metadata.
+    * @param records the text of each record, without length indicators, in key order
+    * @param prevRBN the previous block in the sequence set
+    * @param nextRBN the next block in the sequence set
+    * @param highKey the largest key that belongs in the block, -1 when unbounded
+    * @param out string to store the encoded block in
+    * @return the number of bytes in out
+    */
+    static int encode(const std::vector<std::string> &records, int prevRBN, int nextRBN, int highKey,
+                      std::string &out);
+
+    /**
+    * @brief Decodes a block written by encode.
+    * @param data the encoded block, starting with the marker
+    * @param size number of bytes available in data
+    * @param records vector to store the text of each record in
+    * @param prevRBN stores the previous block in the sequence set
+    * @param nextRBN stores the next block in the sequence set
+    * @param highKey stores the largest key that belongs in the block
+    * @return -1 if the data is not a valid compact block, the number of bytes decoded otherwise
+    */
+    static int decode(const char *data, int size, std::vector<std::string> &records, int &prevRBN,
+                      int &nextRBN, int &highKey);
+
+private:
+    /**
+    * @brief How a record is stored, including the character that ended its text.
+    */
+    enum RecordKind : unsigned char {
+        RAW = 0,                  /**< The text as it was */
+        STRUCTURED_NEWLINE = 1,   /**< Fields, text ended in a newline (loaded from a file) */
+        STRUCTURED_DELIMITER = 2, /**< Fields, text ended in a comma (packed field by field) */
+        STRUCTURED_PLAIN = 3      /**< Fields, nothing after the last field */
+    };
+
+    /**
+    * @brief Converts a coordinate to fixed point.
+    * @param text the coordinate as written in the record
+    * @param value stores the encoded value
+    * @return false if the text would not come back the same, and so must be kept raw
+    */
+    static bool encodeCoordinate(const std::string &text, unsigned long long &value);
+
+    /**
+    * @brief Converts a fixed point coordinate back to text.
+    * @param value the encoded value
+    * @param text string to append the coordinate to
+    * @return nothing
+    */
+    static void decodeCoordinate(unsigned long long value, std::string &text);
+};
+
+#endif //CSCI331_PROJECT4_COMPACTBLOCKCODEC_H
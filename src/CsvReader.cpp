@@ -0,0 +1,106 @@
+/**
+ * @file CsvReader.cpp
+ * @brief Implementation file for the CsvReader class.
+ */
+
+#include "CsvReader.h"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+using namespace std;
+
+CsvReader::CsvReader(int bufferSize) : buffer(bufferSize > 0 ? bufferSize : defaultBufferSize) {
+    begin = 0;
+    end = 0;
+    atEnd = true;
+    recordCount = 0;
+}
+
+bool CsvReader::openFile(const string &csvFile) {
+    file.open(csvFile.c_str(), ios::in | ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    begin = 0;
+    end = 0;
+    atEnd = false;
+    recordCount = 0;
+
+    // Skip the header line
+    size_t length;
+    if (nextLine(length)) {
+        begin += length;
+    }
+
+    return true;
+}
+
+int CsvReader::read(RecordBuffer &recordBuffer) {
+    size_t length;
+    while (nextLine(length)) {
+        string_view line(buffer.data() + begin, length);
+        begin += length;
+
+        if (line.find_first_not_of("\r\n") == string_view::npos) continue;
+        if (recordBuffer.assign(line) == -1) continue;
+
+        recordCount++;
+        return length;
+    }
+
+    recordBuffer.clear();
+    return -1;
+}
+
+int CsvReader::getRecordCount() const {
+    return recordCount;
+}
+
+bool CsvReader::fill() {
+    if (atEnd) return false;
+
+    // Keep the start of a line that runs past the bytes read so far
+    if (begin > 0) {
+        move(buffer.begin() + begin, buffer.begin() + end, buffer.begin());
+        end -= begin;
+        begin = 0;
+    }
+    // A line longer than the whole buffer needs a bigger one
+    if (end == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+
+    file.read(buffer.data() + end, buffer.size() - end);
+    size_t bytesRead = file.gcount();
+    end += bytesRead;
+    if (bytesRead == 0 || !file) {
+        atEnd = true;
+    }
+
+    return bytesRead > 0;
+}
+
+bool CsvReader::nextLine(size_t &length) {
+    size_t scanned = begin;
+    while (true) {
+        const void *newline = memchr(buffer.data() + scanned, '\n', end - scanned);
+        if (newline != nullptr) {
+            length = static_cast<const char *>(newline) - (buffer.data() + begin) + 1;
+            return true;
+        }
+
+        size_t pending = end - begin;
+        if (!fill()) {
+            if (end == begin) return false;
+
+            // The last line has no newline, give it one like every other record
+            if (end == buffer.size()) buffer.resize(end + 1);
+            buffer[end++] = '\n';
+            length = end - begin;
+            return true;
+        }
+        scanned = begin + pending;
+    }
+}
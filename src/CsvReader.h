@@ -0,0 +1,76 @@
+/**
+ * @file CsvReader.h
+ * @brief Header file for the CsvReader class.
+ */
+
+/**
+ * @class CsvReader
+ * @brief Streams the records of a CSV file straight into record buffers.
+ * @details CsvReader class: Reads the file in large chunks and hands out one line at a time, so records
+ * go from the input file to the tree without an intermediate file. Each record is the text of its line
+ * followed by a newline, the same bytes a record loaded from a file has always been stored with.
+ * Includes: Opening a CSV file and skipping its header line, reading records in order, counting them.
+ * Assumes: The first line of the file is a header, and records are one per line.
+ */
+
+#ifndef CSCI331_PROJECT4_CSVREADER_H
+#define CSCI331_PROJECT4_CSVREADER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "RecordBuffer.h"
+
+class CsvReader {
+public:
+    static const int defaultBufferSize = 1 << 20; /**< Bytes read from the file at a time */
+
+    /**
+    * @brief Constructor for CsvReader class.
+    * @param bufferSize how many bytes to read from the file at a time.
+    */
+    explicit CsvReader(int bufferSize = defaultBufferSize);
+
+    /**
+    * @brief Opens a CSV file and moves past its header line.
+    * @param csvFile the name of the file to open.
+    * @return true if the file is opened successfully, false otherwise.
+    */
+    bool openFile(const std::string &csvFile);
+
+    /**
+    * @brief Reads the next record, skipping blank lines and lines too long for the record buffer.
+    * @param recordBuffer the record buffer to store the record in.
+    * @return -1 at the end of the file, the record size otherwise.
+    */
+    int read(RecordBuffer &recordBuffer);
+
+    /**
+    * @brief Gets the number of records read so far.
+    * @return the record count.
+    */
+    int getRecordCount() const;
+
+private:
+    std::ifstream file;         /**< The CSV file being read */
+    std::vector<char> buffer;   /**< Bytes read from the file and not yet handed out */
+    size_t begin;               /**< Start of the next line in buffer */
+    size_t end;                 /**< End of the bytes read into buffer */
+    bool atEnd;                 /**< Whether the whole file has been read into buffer */
+    int recordCount;            /**< Records handed out so far */
+
+    /**
+    * @brief Moves the unread bytes to the front of the buffer and reads more of the file after them.
+    * @return false if nothing more could be read.
+    */
+    bool fill();
+
+    /**
+    * @brief Finds the next line, reading more of the file as needed.
+    * @param length stores the length of the line, including its newline.
+    * @return false at the end of the file.
+    */
+    bool nextLine(size_t &length);
+};
+
+#endif //CSCI331_PROJECT4_CSVREADER_H
@@ -0,0 +1,88 @@
+/**
+ * @file FreeSpaceMap.cpp
+ * @brief Implementation file for the FreeSpaceMap class.
+ */
+
+#include "FreeSpaceMap.h"
+#include <iterator>
+#include <string>
+
+using namespace std;
+
+FreeSpaceMap::FreeSpaceMap(HeaderBuffer &hbuf) : headerBuffer(hbuf) {
+
+}
+
+int FreeSpaceMap::allocate(int nearRBN) {
+    if (freeBlocks.empty()) {
+        return headerBuffer.rbnAvail++;
+    }
+
+    // Take whichever free block on either side of nearRBN is closer
+    auto it = freeBlocks.lower_bound(nearRBN);
+    if (it == freeBlocks.end()) {
+        --it;
+    } else if (it != freeBlocks.begin()) {
+        auto before = prev(it);
+        if (nearRBN - *before <= *it - nearRBN) it = before;
+    }
+
+    int RBN = *it;
+    freeBlocks.erase(it);
+    return RBN;
+}
+
+void FreeSpaceMap::release(int RBN) {
+    if (RBN <= 0 || RBN >= headerBuffer.rbnAvail) return;
+    freeBlocks.insert(RBN);
+
+    // Free blocks at the end of the file are given back rather than kept
+    while (!freeBlocks.empty() && *freeBlocks.rbegin() == headerBuffer.rbnAvail - 1) {
+        freeBlocks.erase(prev(freeBlocks.end()));
+        headerBuffer.rbnAvail--;
+    }
+}
+
+int FreeSpaceMap::getFreeCount() const {
+    return freeBlocks.size();
+}
+
+int FreeSpaceMap::read(istream &stream) {
+    freeBlocks.clear();
+    if (headerBuffer.freeMapBlocks <= 0) return 0;
+
+    string bitmap(headerBuffer.freeMapBlocks * headerBuffer.blockSize, '\0');
+    stream.seekg(HeaderBuffer::blockOffset(headerBuffer.rbnAvail, headerBuffer.blockSize, headerBuffer.headerRecordSize));
+    stream.read(&bitmap[0], bitmap.size());
+    if (stream.gcount() != static_cast<streamsize>(bitmap.size())) {
+        stream.clear();
+        return -1;
+    }
+
+    for (int RBN = 1; RBN < headerBuffer.rbnAvail && RBN / 8 < static_cast<int>(bitmap.size()); RBN++) {
+        if (bitmap[RBN / 8] >> (RBN % 8) & 1) {
+            freeBlocks.insert(RBN);
+        }
+    }
+
+    return 0;
+}
+
+int FreeSpaceMap::write(ostream &stream) {
+    headerBuffer.freeMapBlocks = 0;
+    if (freeBlocks.empty()) return 0;
+
+    int bitmapBytes = headerBuffer.rbnAvail / 8 + 1;
+    int blocks = (bitmapBytes + headerBuffer.blockSize - 1) / headerBuffer.blockSize;
+    string bitmap(blocks * headerBuffer.blockSize, '\0');
+    for (int RBN : freeBlocks) {
+        bitmap[RBN / 8] |= 1 << (RBN % 8);
+    }
+
+    stream.seekp(HeaderBuffer::blockOffset(headerBuffer.rbnAvail, headerBuffer.blockSize, headerBuffer.headerRecordSize));
+    stream.write(bitmap.data(), bitmap.size());
+    if (!stream) return -1;
+
+    headerBuffer.freeMapBlocks = blocks;
+    return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file FreeSpaceMap.h
+ * @brief Header file for the FreeSpaceMap class.
+ */
+
+/**
+ * @class FreeSpaceMap
+ * @brief Tracks the blocks of a tree file that are free to reuse.
+ * @details FreeSpaceMap class: Blocks below the header's rbnAvail are either in use or free. A new block
+ * is the free block nearest the block it will sit beside, so neighbors in the tree stay close in the file,
+ * and only when none is free does rbnAvail grow. Freeing the last block in use lowers rbnAvail instead.
+ * On disk the map is a bitmap, one bit per block below rbnAvail with the lowest bit of each byte first,
+ * written to the freeMapBlocks blocks that start at rbnAvail. Blocks handed out later overwrite it, so it
+ * is read once when the file is opened and written again when it is closed.
+ * Includes: Allocating and freeing blocks, reading and writing the bitmap.
+ * Assumes: Callers serialize allocate and release.
+ */
+
+#ifndef CSCI331_PROJECT4_FREESPACEMAP_H
+#define CSCI331_PROJECT4_FREESPACEMAP_H
+
+#include <iostream>
+#include <set>
+#include "HeaderBuffer.h"
+
+class FreeSpaceMap {
+public:
+    /**
+    * @brief Constructor for the free space map.
+    * @param hbuf the header of the tree file, which holds rbnAvail and freeMapBlocks
+    */
+    explicit FreeSpaceMap(HeaderBuffer &hbuf);
+
+    /**
+    * @brief Hands out a block, reusing the free block nearest nearRBN when there is one.
+    * @param nearRBN the block the new block will be linked to
+    * @return the RBN of the block
+    */
+    int allocate(int nearRBN);
+
+    /**
+    * @brief Returns a block that is no longer referenced.
+    * @param RBN the block to free
+    * @return nothing
+    */
+    void release(int RBN);
+
+    /**
+    * @brief Gets how many blocks below rbnAvail are free.
+    * @return the number of free blocks
+    */
+    int getFreeCount() const;
+
+    /**
+    * @brief Reads the bitmap written by write, replacing the blocks the map holds.
+    * @param stream the tree file
+    * @return -1 if the bitmap could not be read, 0 otherwise
+    */
+    int read(std::istream &stream);
+
+    /**
+    * @brief Writes the bitmap after the last block in use and records its size in the header.
+    * @param stream the tree file
+    * @return -1 if the bitmap could not be written, 0 otherwise
+    */
+    int write(std::ostream &stream);
+
+private:
+    HeaderBuffer &headerBuffer; /**< The header of the tree file */
+    std::set<int> freeBlocks;   /**< Free blocks below rbnAvail, in file order */
+};
+
+#endif //CSCI331_PROJECT4_FREESPACEMAP_H
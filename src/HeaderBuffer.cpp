@@ -10,7 +10,7 @@ using namespace std;
 
 HeaderBuffer::HeaderBuffer() {
     this->fileType = "";
-    this->version = "2.0";
+    this->version = to_string(formatVersion) + ".0";
     this->headerRecordSize = 512;
     this->recordSizeDigits = 2;
     this->recordSizeFormat = "ASCII";
@@ -25,12 +25,19 @@ HeaderBuffer::HeaderBuffer() {
     this->rbnAvail = 2;
     this->rbnActive = 1;
     this->stale = "true";
+    this->leafEncoding = "TEXT";
+    this->blockCodec = "NONE";
+    this->freeMapBlocks = 0;
+    this->blockChecksum = "CRC32C";
 }
 
-int HeaderBuffer::readHeader(std::istream &stream)
+std::streamoff HeaderBuffer::readHeader(std::istream &stream)
 {
     string line;
 
+    // Files from before checksums have no BLOCK_CHECKSUM line
+    blockChecksum = "NONE";
+
     while (std::getline(stream, line) && line != "END")
     {
 
@@ -104,6 +111,22 @@ int HeaderBuffer::readHeader(std::istream &stream)
             {
                 stale = value;
             }
+            else if (key == "LEAF_ENCODING")
+            {
+                leafEncoding = value;
+            }
+            else if (key == "BLOCK_CODEC")
+            {
+                blockCodec = value;
+            }
+            else if (key == "FREE_MAP_BLOCKS")
+            {
+                freeMapBlocks = stoi(value);
+            }
+            else if (key == "BLOCK_CHECKSUM")
+            {
+                blockChecksum = value;
+            }
             else
             {
                 return -1;
@@ -115,10 +138,25 @@ int HeaderBuffer::readHeader(std::istream &stream)
         }
     }
 
+    // Refuse files written by a newer format, and upgrade older ones, whose blocks read the same
+    int major = 0;
+    try {
+        major = stoi(version);
+    }
+    catch (...) {
+        return -1;
+    }
+    if (major > formatVersion || blockSize <= 0 || blockSize > maxBlockSize) return -1;
+    version = to_string(formatVersion) + ".0";
+
     // Return the stream position after reading the header
     return stream.tellg();
 }
 
+std::streamoff HeaderBuffer::blockOffset(int RBN, int blockSize, int headerRecordSize) {
+    return static_cast<std::streamoff>(RBN - 1) * blockSize + headerRecordSize;
+}
+
 int HeaderBuffer::writeHeader(std::ostream &stream) const
 {
     string buffer;
@@ -140,6 +178,10 @@ int HeaderBuffer::writeHeader(std::ostream &stream) const
     buffer += "RBN_AVAIL="; buffer += to_string(rbnAvail); buffer += '\n';
     buffer += "RBN_ACTIVE="; buffer += to_string(rbnActive); buffer += '\n';
     buffer += "STALE="; buffer += stale; buffer += '\n';
+    buffer += "LEAF_ENCODING="; buffer += leafEncoding; buffer += '\n';
+    buffer += "BLOCK_CODEC="; buffer += blockCodec; buffer += '\n';
+    buffer += "FREE_MAP_BLOCKS="; buffer += to_string(freeMapBlocks); buffer += '\n';
+    buffer += "BLOCK_CHECKSUM="; buffer += blockChecksum; buffer += '\n';
     buffer += "END"; buffer += '\n';
 
     int remainingSpace = headerRecordSize - buffer.length() - 1;
@@ -28,9 +28,9 @@ public:
     /**
      * @brief Read the header information from the given input stream.
      * @param stream The input stream from which to read the header.
-     * @return 0 if successful, -1 if an error occurs.
+     * @return The position after the header, or -1 if it is malformed or from a newer version.
      */
-    int readHeader(std::istream &stream);
+    std::streamoff readHeader(std::istream &stream);
 
     /**
      * @brief Write the header information to the given output stream.
@@ -39,6 +39,18 @@ public:
      */
     int writeHeader(std::ostream &stream) const;
 
+    /**
+     * @brief Compute the byte address of a block, in 64 bits so files past 2 GB do not wrap.
+     * @param RBN The relative block number, starting at 1.
+     * @param blockSize The size of each block in the file.
+     * @param headerRecordSize The size of the header before the first block.
+     * @return The offset of the block from the start of the file.
+     */
+    static std::streamoff blockOffset(int RBN, int blockSize, int headerRecordSize);
+
+    static const int formatVersion = 3;     /**< Major version written, older files are upgraded on open. */
+    static const int maxBlockSize = 65536;  /**< Largest block size, the LZ codec's match offsets are 16 bits. */
+
     std::string fileType;           /**< The structure of the file */
     std::string version;            /**< The version of the file format. */
     int headerRecordSize;           /**< The size of header record. */
@@ -52,9 +64,13 @@ public:
     std::string recordFieldsType;   /**< The data type of record fields. */
     std::string recordFormat;       /**< The format of the record fields. */
     int recordPrimaryKey;           /**< The primary key of the records. */
-    int rbnAvail;                   /**< Link to beginning of available sequence set. */
+    int rbnAvail;                   /**< The block after the last block in use. */
     int rbnActive;                  /**< Link to beginning of active sequence set. */
     std::string stale;              /**< Indicates if data is stale. */
+    std::string leafEncoding;       /**< How leaf blocks are written, TEXT or COMPACT. */
+    std::string blockCodec;         /**< How whole blocks are compressed, NONE or LZ. */
+    int freeMapBlocks;              /**< Blocks from rbnAvail on holding the free space bitmap. */
+    std::string blockChecksum;      /**< What ends every node block, NONE or CRC32C. */
 };
 
 #endif // PROJECT2_PART1_HEADERBUFFER_H
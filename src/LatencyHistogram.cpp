@@ -0,0 +1,87 @@
+/**
+ * @file LatencyHistogram.cpp
+ * @brief Implementation file for the LatencyHistogram class.
+ */
+
+#include "LatencyHistogram.h"
+#include <cmath>
+
+using namespace std;
+
+int LatencyHistogram::getBucket(long long nanoseconds) {
+    if (nanoseconds < subBucketCount) {
+        return nanoseconds < 0 ? 0 : static_cast<int>(nanoseconds);
+    }
+
+    int exponent = 63 - __builtin_clzll(static_cast<unsigned long long>(nanoseconds));
+    if (exponent > maxExponent) return bucketCount - 1;
+
+    // The bits just below the top one pick the bucket within the power of two
+    int subBucket = static_cast<int>(nanoseconds >> (exponent - subBucketBits)) & (subBucketCount - 1);
+    return (exponent - subBucketBits + 1) * subBucketCount + subBucket;
+}
+
+long long LatencyHistogram::getBucketValue(int bucket) {
+    if (bucket < subBucketCount) return bucket;
+
+    int exponent = bucket / subBucketCount + subBucketBits - 1;
+    long long subBucket = bucket % subBucketCount;
+    int shift = exponent - subBucketBits;
+    return ((subBucketCount + subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(long long nanoseconds) {
+    addBucket(getBucket(nanoseconds), 1, nanoseconds);
+}
+
+void LatencyHistogram::addBucket(int bucket, long long count, long long nanoseconds) {
+    counts[bucket] += count;
+    this->count += count;
+    totalNanoseconds += nanoseconds;
+}
+
+void LatencyHistogram::add(const LatencyHistogram &other) {
+    for (int i = 0; i < bucketCount; i++) {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    totalNanoseconds += other.totalNanoseconds;
+}
+
+void LatencyHistogram::subtract(const LatencyHistogram &other) {
+    for (int i = 0; i < bucketCount; i++) {
+        counts[i] -= other.counts[i];
+    }
+    count -= other.count;
+    totalNanoseconds -= other.totalNanoseconds;
+}
+
+long long LatencyHistogram::getCount() const {
+    return count;
+}
+
+double LatencyHistogram::getMean() const {
+    return count == 0 ? 0.0 : static_cast<double>(totalNanoseconds) / count;
+}
+
+long long LatencyHistogram::getPercentile(double percentile) const {
+    if (count == 0) return 0;
+
+    // The rank of the latency wanted, counting from one
+    long long rank = static_cast<long long>(ceil(percentile / 100.0 * count));
+    if (rank < 1) rank = 1;
+
+    long long seen = 0;
+    for (int i = 0; i < bucketCount; i++) {
+        seen += counts[i];
+        if (seen >= rank) return getBucketValue(i);
+    }
+    return getMax();
+}
+
+long long LatencyHistogram::getMax() const {
+    for (int i = bucketCount - 1; i >= 0; i--) {
+        if (counts[i] > 0) return getBucketValue(i);
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file LatencyHistogram.h
+ * @brief Header file for the LatencyHistogram class.
+ */
+
+/**
+ * @class LatencyHistogram
+ * @brief A histogram of latencies in nanoseconds, with buckets spaced on a log scale.
+ * @details: Latencies below 32 ns each get a bucket of their own. Above that, every power of two is
+ * split into 32 buckets of equal width, so a bucket is never wider than 1/32 of the values in it and a
+ * percentile read from it is within about 3% of the true value, however long the tail. Latencies from
+ * 2^41 ns (about 36 minutes) up all land in the last bucket. Finding the bucket of a latency is a few
+ * shifts, which keeps recording cheap.
+ * Includes: Recording latencies, adding histograms together, and reading counts, the mean and percentiles.
+ */
+
+#ifndef CSCI331_PROJECT4_LATENCYHISTOGRAM_H
+#define CSCI331_PROJECT4_LATENCYHISTOGRAM_H
+
+#include <array>
+
+class LatencyHistogram {
+public:
+    static const int subBucketBits = 5;                             /**< log2 of the buckets per power of two */
+    static const int subBucketCount = 1 << subBucketBits;           /**< Buckets per power of two */
+    static const int maxExponent = 40;                              /**< log2 of the largest latency told apart */
+    static const int bucketCount = (maxExponent - subBucketBits + 2) * subBucketCount; /**< Number of buckets */
+
+    /**
+    * @brief Finds the bucket a latency is counted in.
+    * @param nanoseconds the latency
+    * @return the bucket, from 0 to bucketCount - 1
+    */
+    static int getBucket(long long nanoseconds);
+
+    /**
+    * @brief Gets the largest latency counted in a bucket.
+    * @param bucket the bucket
+    * @return the latency in nanoseconds
+    */
+    static long long getBucketValue(int bucket);
+
+    /**
+    * @brief Counts one latency.
+    * @param nanoseconds the latency
+    * @return nothing
+    */
+    void record(long long nanoseconds);
+
+    /**
+    * @brief Adds to the count of a bucket, for building a histogram from counts kept elsewhere.
+    * @param bucket the bucket
+    * @param count the latencies to add to it
+    * @param nanoseconds the sum of those latencies
+    * @return nothing
+    */
+    void addBucket(int bucket, long long count, long long nanoseconds);
+
+    /**
+    * @brief Adds every count of another histogram to this one.
+    * @param other the histogram to add
+    * @return nothing
+    */
+    void add(const LatencyHistogram &other);
+
+    /**
+    * @brief Takes every count of another histogram, recorded earlier into the same counts, from this one.
+    * @param other the histogram to take away
+    * @return nothing
+    */
+    void subtract(const LatencyHistogram &other);
+
+    /**
+    * @brief Gets the number of latencies counted.
+    * @return the count
+    */
+    long long getCount() const;
+
+    /**
+    * @brief Gets the mean latency.
+    * @return the mean in nanoseconds, or 0 if nothing was counted
+    */
+    double getMean() const;
+
+    /**
+    * @brief Gets the latency that a percentage of the counted latencies are at or below.
+    * @param percentile the percentage, from 0 to 100
+    * @return the largest latency of the bucket holding the percentile in nanoseconds, or 0 if nothing was counted
+    */
+    long long getPercentile(double percentile) const;
+
+    /**
+    * @brief Gets the largest latency counted.
+    * @return the largest latency of the highest bucket in use in nanoseconds, or 0 if nothing was counted
+    */
+    long long getMax() const;
+
+private:
+    std::array<long long, bucketCount> counts{}; /**< Latencies counted in each bucket */
+    long long count = 0;                         /**< Latencies counted in every bucket */
+    long long totalNanoseconds = 0;              /**< Sum of the latencies counted */
+};
+
+#endif //CSCI331_PROJECT4_LATENCYHISTOGRAM_H
@@ -0,0 +1,209 @@
+/**
+ * @file ParallelCsvReader.cpp
+ * @brief Implementation file for the ParallelCsvReader class.
+ */
+
+#include "ParallelCsvReader.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+ParallelCsvReader::ParallelCsvReader(int threads, size_t chunkSize) {
+    if (threads <= 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    this->threads = threads;
+    this->chunkSize = max<size_t>(chunkSize, 1);
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    recordCount = 0;
+}
+
+ParallelCsvReader::~ParallelCsvReader() {
+    closeFile();
+}
+
+bool ParallelCsvReader::openFile(const string &csvFile) {
+    closeFile();
+    recordCount = 0;
+
+    int fd = open(csvFile.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    // Only regular files can be mapped, anything else is streamed
+    struct stat info;
+    if (fstat(fd, &info) == -1 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return stream.openFile(csvFile);
+    }
+
+    size = info.st_size;
+    if (size > 0) {
+        void *region = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (region == MAP_FAILED) {
+            close(fd);
+            size = 0;
+            return stream.openFile(csvFile);
+        }
+        madvise(region, size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(region);
+    }
+    close(fd);
+
+    mapped = true;
+    return true;
+}
+
+int ParallelCsvReader::readBatches(const function<void(vector<RecordBuffer> &)> &deliver) {
+    if (!mapped) {
+        return readStreamed(deliver);
+    }
+
+    vector<pair<size_t, size_t>> chunks = splitChunks();
+    vector<vector<RecordBuffer>> batches(chunks.size());
+    vector<bool> parsed(chunks.size(), false);
+
+    // Workers take chunks in order, staying at most a few chunks ahead of the batch being loaded
+    size_t window = 2 * threads;
+    size_t nextChunk = 0;
+    size_t delivered = 0;
+    mutex lock;
+    condition_variable changed;
+
+    auto worker = [&]() {
+        while (true) {
+            size_t index;
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&] { return nextChunk >= chunks.size() || nextChunk < delivered + window; });
+                if (nextChunk >= chunks.size()) return;
+                index = nextChunk++;
+            }
+
+            vector<RecordBuffer> records;
+            parseChunk(data + chunks[index].first, data + chunks[index].second, records);
+
+            {
+                lock_guard<mutex> guard(lock);
+                batches[index] = std::move(records);
+                parsed[index] = true;
+            }
+            changed.notify_all();
+        }
+    };
+
+    vector<thread> pool;
+    int workers = min<size_t>(threads, chunks.size());
+    for (int i = 0; i < workers; i++) {
+        pool.emplace_back(worker);
+    }
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+        vector<RecordBuffer> batch;
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&] { return parsed[i]; });
+            batch = std::move(batches[i]);
+            delivered = i + 1;
+        }
+        changed.notify_all();
+
+        recordCount += batch.size();
+        deliver(batch);
+    }
+
+    for (thread &t : pool) {
+        t.join();
+    }
+
+    return recordCount;
+}
+
+int ParallelCsvReader::getRecordCount() const {
+    return recordCount;
+}
+
+vector<pair<size_t, size_t>> ParallelCsvReader::splitChunks() const {
+    vector<pair<size_t, size_t>> chunks;
+
+    // Skip the header line
+    const void *newline = size > 0 ? memchr(data, '\n', size) : nullptr;
+    size_t start = newline != nullptr ? static_cast<const char *>(newline) - data + 1 : size;
+
+    while (start < size) {
+        size_t end = start + min(chunkSize, size - start);
+
+        // Move the end past the newline that finishes the line it falls in
+        if (end < size) {
+            newline = memchr(data + end - 1, '\n', size - end + 1);
+            end = newline != nullptr ? static_cast<const char *>(newline) - data + 1 : size;
+        }
+
+        chunks.emplace_back(start, end);
+        start = end;
+    }
+
+    return chunks;
+}
+
+void ParallelCsvReader::parseChunk(const char *begin, const char *end, vector<RecordBuffer> &records) {
+    const char *line = begin;
+    while (line < end) {
+        const char *newline = static_cast<const char *>(memchr(line, '\n', end - line));
+        const char *lineEnd = newline != nullptr ? newline + 1 : end;
+        string_view text(line, lineEnd - line);
+        line = lineEnd;
+
+        if (text.find_first_not_of("\r\n") == string_view::npos) continue;
+
+        // Records keep the newline they were read with, the last line of a file is given one
+        records.emplace_back();
+        int status = newline != nullptr ? records.back().assign(text)
+                                        : records.back().assign(string(text) + '\n');
+        if (status == -1) {
+            records.pop_back();
+        }
+    }
+}
+
+int ParallelCsvReader::readStreamed(const function<void(vector<RecordBuffer> &)> &deliver) {
+    vector<RecordBuffer> batch;
+    RecordBuffer recordBuffer;
+
+    while (stream.read(recordBuffer) != -1) {
+        batch.push_back(recordBuffer);
+        if (batch.size() == streamedBatchSize) {
+            recordCount += batch.size();
+            deliver(batch);
+            batch.clear();
+        }
+    }
+
+    if (!batch.empty()) {
+        recordCount += batch.size();
+        deliver(batch);
+    }
+
+    return recordCount;
+}
+
+void ParallelCsvReader::closeFile() {
+    if (data != nullptr) {
+        munmap(const_cast<char *>(data), size);
+        data = nullptr;
+    }
+    size = 0;
+    mapped = false;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file ParallelCsvReader.h
+ * @brief Header file for the ParallelCsvReader class.
+ */
+
+/**
+ * @class ParallelCsvReader
+ * @brief Parses a CSV file on several threads and hands the records out in batches, in file order.
+ * @details ParallelCsvReader class: Maps the file into memory and cuts it into chunks that end on a
+ * newline. A pool of threads parses the chunks, each into one batch of records, while the caller loads
+ * the batches in order, so the tree sees the records exactly as a single reader would give them. Lines
+ * are found with memchr, which the C library scans many bytes at a time. A few chunks are parsed ahead
+ * of the caller at most, so memory stays bounded however large the file is. Files that cannot be mapped,
+ * such as pipes, are read with a CsvReader instead.
+ * Includes: Opening a CSV file, reading all of its records in batches, counting them.
+ * Assumes: The first line of the file is a header, records are one per line, and the file does not
+ * change while it is read.
+ */
+
+#ifndef CSCI331_PROJECT4_PARALLELCSVREADER_H
+#define CSCI331_PROJECT4_PARALLELCSVREADER_H
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "CsvReader.h"
+#include "RecordBuffer.h"
+
+class ParallelCsvReader {
+public:
+    static const size_t defaultChunkSize = 4 << 20; /**< Bytes of the file in each chunk */
+    static const int streamedBatchSize = 4096;      /**< Records in each batch when the file is not mapped */
+
+    /**
+    * @brief Constructor for ParallelCsvReader class.
+    * @param threads how many threads parse chunks, 0 for one per hardware thread.
+    * @param chunkSize how many bytes of the file each chunk holds, before moving its end to a newline.
+    */
+    explicit ParallelCsvReader(int threads = 0, size_t chunkSize = defaultChunkSize);
+
+    /**
+    * @brief This is the destructor for the reader.
+    * @post The file is unmapped.
+    */
+    ~ParallelCsvReader();
+
+    ParallelCsvReader(const ParallelCsvReader &) = delete;
+    ParallelCsvReader &operator=(const ParallelCsvReader &) = delete;
+
+    /**
+    * @brief Opens a CSV file, mapping it into memory when it can.
+    * @param csvFile the name of the file to open.
+    * @return true if the file is opened successfully, false otherwise.
+    */
+    bool openFile(const std::string &csvFile);
+
+    /**
+    * @brief Parses every record after the header line and passes them to deliver, batch by batch.
+    * Blank lines, and lines too long for a record buffer, are skipped.
+    * @param deliver called on the calling thread with each batch, in file order.
+    * @return the number of records delivered, -1 if no file is open.
+    */
+    int readBatches(const std::function<void(std::vector<RecordBuffer> &)> &deliver);
+
+    /**
+    * @brief Gets the number of records delivered so far.
+    * @return the record count.
+    */
+    int getRecordCount() const;
+
+private:
+    int threads;            /**< Threads parsing chunks */
+    size_t chunkSize;       /**< Bytes of the file in each chunk */
+    const char *data;       /**< The mapped file, nullptr when it is streamed or empty */
+    size_t size;            /**< Bytes in the mapped file */
+    bool mapped;            /**< Whether the open file is mapped, rather than read by stream */
+    CsvReader stream;       /**< Reads files that could not be mapped */
+    int recordCount;        /**< Records delivered so far */
+
+    /**
+    * @brief Cuts the mapped file after its header line into chunks ending on a newline.
+    * @return the start and end offset of each chunk.
+    */
+    std::vector<std::pair<size_t, size_t>> splitChunks() const;
+
+    /**
+    * @brief Parses the lines of one chunk.
+    * @param begin the first byte of the chunk.
+    * @param end one past the last byte of the chunk.
+    * @param records vector to add the records to.
+    * @return nothing.
+    */
+    static void parseChunk(const char *begin, const char *end, std::vector<RecordBuffer> &records);
+
+    /**
+    * @brief Reads the records of a file that is not mapped.
+    * @param deliver called with each batch.
+    * @return the number of records delivered.
+    */
+    int readStreamed(const std::function<void(std::vector<RecordBuffer> &)> &deliver);
+
+    /**
+    * @brief Unmaps the file if it is mapped.
+    * @return nothing.
+    */
+    void closeFile();
+};
+
+#endif //CSCI331_PROJECT4_PARALLELCSVREADER_H
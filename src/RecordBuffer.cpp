@@ -4,6 +4,8 @@
  */
 
 #include "RecordBuffer.h"
+#include <charconv>
+#include <stdexcept>
 
 using namespace std;
 
@@ -13,7 +15,7 @@ RecordBuffer::RecordBuffer(int maxSize) {
     nextByte = 0;
 }
 
-int RecordBuffer::read(istream &stream, int recaddr) {
+std::streamoff RecordBuffer::read(istream &stream, std::streamoff recaddr) {
     // Move to location if needed
     if (recaddr != -1) {
         stream.clear();
@@ -25,12 +27,13 @@ int RecordBuffer::read(istream &stream, int recaddr) {
     if (!stream) return -1;
 
     // Get current location in stream
-    int addr = stream.tellg();
+    std::streamoff addr = stream.tellg();
 
     clear();
 
     char rsz[3]; // Make sure it can hold 2 characters and a null character
     stream.read(rsz, 2);
+    if (stream.gcount() != 2) return -1;
     rsz[2] = '\0'; // Null-terminate the string
     int recordSize = 0;
     try {
@@ -45,6 +48,10 @@ int RecordBuffer::read(istream &stream, int recaddr) {
     // read the record into recordBuffer
     buffer.resize(recordSize);
     stream.read(buffer.data(), recordSize);
+    if (stream.gcount() != recordSize) {
+        buffer.clear();
+        return -1;
+    }
 
     // check stream
     if (stream.bad()) {
@@ -55,7 +62,7 @@ int RecordBuffer::read(istream &stream, int recaddr) {
     return addr;
 }
 
-int RecordBuffer::write(ostream &stream, int recaddr) {
+std::streamoff RecordBuffer::write(ostream &stream, std::streamoff recaddr) {
 
     // Move to location if needed
     if (recaddr != -1) {
@@ -64,7 +71,7 @@ int RecordBuffer::write(ostream &stream, int recaddr) {
     }
 
     // Get output location
-    int addr = stream.tellp();
+    std::streamoff addr = stream.tellp();
 
     // Write the recordBuffer (record) size
     int recordSize;
@@ -112,6 +119,33 @@ int RecordBuffer::pack(string field) {
     return (int)field.length();
 }
 
+int RecordBuffer::packRecord(const string &line) {
+    int fields = 0;
+    size_t start = 0;
+
+    while (start <= line.size()) {
+        size_t end = line.find(deliminator, start);
+        if (end == string::npos) end = line.size();
+        if (pack(line.substr(start, end - start)) == -1) return -1;
+        fields++;
+        start = end + 1;
+    }
+
+    return fields;
+}
+
+int RecordBuffer::assign(string_view record) {
+    if (record.size() > maxBufferSize) return -1;
+
+    buffer.assign(record.begin(), record.end());
+    nextByte = 0;
+    return (int)record.size();
+}
+
+RecordView RecordBuffer::getView() const {
+    return RecordView(string_view(buffer.data(), buffer.size()));
+}
+
 void RecordBuffer::clear() {
     buffer.clear();
     nextByte = 0;
@@ -122,15 +156,21 @@ int RecordBuffer::getBufferSize() {
 }
 
 int RecordBuffer::getRecordKey() {
-    string key;
-    int i = 0;
-
-    while (i < buffer.size() && buffer[i] != deliminator) {
-        key.push_back(buffer[i]);
-        i++;
+    // Parse in place, this runs on every comparison
+    int key;
+    if (from_chars(buffer.data(), buffer.data() + buffer.size(), key).ec != errc()) {
+        throw invalid_argument("getRecordKey");
     }
-
-    return stoi(key);
+    return key;
 }
 
+string RecordBuffer::getRecord() {
+    string record(buffer.begin(), buffer.end());
+
+    // Records loaded from a file end in a newline, packed records in the deliminator
+    while (!record.empty() && (record.back() == '\n' || record.back() == '\r' || record.back() == deliminator)) {
+        record.pop_back();
+    }
 
+    return record;
+}
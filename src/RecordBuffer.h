@@ -14,8 +14,10 @@
 #define ZIPCODE_BUFFER_H
 
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <vector>
+#include "RecordView.h"
 
 class RecordBuffer {
 public:
@@ -30,14 +32,14 @@ public:
     * @param stream the input file stream.
     * @return -1 if error or the current byte address.
     */
-    int read(std::istream & stream, int recaddr = -1);
+    std::streamoff read(std::istream & stream, std::streamoff recaddr = -1);
 
     /**
     * @brief Write an entire record into the buffer.
     * @param stream the outout file stream.
     * @return -1 if error or the number of bytes written.
     */
-    int write(std::ostream & stream, int recaddr = -1);
+    std::streamoff write(std::ostream & stream, std::streamoff recaddr = -1);
 
     /**
     * @brief Read one field from the buffer.
@@ -53,6 +55,26 @@ public:
     */
     int pack(std::string field);
 
+    /**
+    * @brief Packs every field of a comma separated line.
+    * @param line the record as a line of text.
+    * @return -1 if the record does not fit in the buffer, the number of fields packed otherwise.
+    */
+    int packRecord(const std::string &line);
+
+    /**
+    * @brief Replaces the buffer with the text of a stored record.
+    * @param record the record text, without its length indicator.
+    * @return -1 if the record does not fit in the buffer, its size otherwise.
+    */
+    int assign(std::string_view record);
+
+    /**
+    * @brief Gets a view of the record in the buffer, valid until the buffer changes.
+    * @return the view.
+    */
+    RecordView getView() const;
+
     /**
     * @brief Clear all buffer data.
     * @return nothing.
@@ -68,9 +90,16 @@ public:
     /**
     * @brief Gets the record key (zipcode).
     * @return key as an integer.
+    * @throw std::invalid_argument if the record does not start with a number.
     */
     int getRecordKey();
 
+    /**
+    * @brief Gets the record as a comma separated line, without the length indicator.
+    * @return the fields of the record, without a trailing deliminator or newline.
+    */
+    std::string getRecord();
+
 private:
     std::vector<char> buffer; /**< The buffer object */
     int maxBufferSize;        /**< The max buffer size */
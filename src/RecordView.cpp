@@ -0,0 +1,67 @@
+/**
+ * @file RecordView.cpp
+ * @brief Implementation file for the RecordView class.
+ */
+
+#include "RecordView.h"
+#include <charconv>
+
+using namespace std;
+
+RecordView::RecordView(string_view text) : text(text) {
+}
+
+string_view RecordView::getText() const {
+    return text;
+}
+
+string_view RecordView::getField(int index) const {
+    size_t start = 0;
+    for (int i = 0; i < index; i++) {
+        size_t comma = text.find(',', start);
+        if (comma == string_view::npos) return string_view();
+        start = comma + 1;
+    }
+
+    size_t end = text.find(',', start);
+    if (end != string_view::npos) {
+        return text.substr(start, end - start);
+    }
+
+    // Records loaded from a file end in a newline rather than the deliminator
+    string_view field = text.substr(start);
+    while (!field.empty() && (field.back() == '\n' || field.back() == '\r')) {
+        field.remove_suffix(1);
+    }
+    return field;
+}
+
+int RecordView::getKey() const {
+    int key = -1;
+    string_view field = getField(0);
+    if (from_chars(field.data(), field.data() + field.size(), key).ec != errc()) {
+        return -1;
+    }
+    return key;
+}
+
+bool RecordView::isTombstone() const {
+    string_view key = getField(0);
+    return !key.empty() && key.back() == tombstoneMark;
+}
+
+double RecordView::getLat() const {
+    return parseDouble(getField(4));
+}
+
+double RecordView::getLong() const {
+    return parseDouble(getField(5));
+}
+
+double RecordView::parseDouble(string_view field) {
+    double value = 0;
+    if (from_chars(field.data(), field.data() + field.size(), value).ec != errc()) {
+        return 0;
+    }
+    return value;
+}
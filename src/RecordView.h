@@ -0,0 +1,84 @@
+/**
+ * @file RecordView.h
+ * @brief Header file for the RecordView class.
+ */
+
+/**
+ * @class RecordView
+ * @brief A read only view of a zip code record where it is stored.
+ * @details RecordView class: Looks at the text of one record, without its length indicator, in a buffer
+ * owned by someone else. Fields are found when asked for and returned as views into that buffer, and
+ * numbers are parsed with std::from_chars, so reading a record never allocates.
+ * Includes: Zipcode, PlaceName, State, County, Latitude, and Longitude, and the key as a number.
+ * Assumes: The buffer outlives the view and does not change while it is used.
+ */
+
+#ifndef CSCI331_PROJECT4_RECORDVIEW_H
+#define CSCI331_PROJECT4_RECORDVIEW_H
+
+#include <string_view>
+
+class RecordView {
+public:
+    static const char tombstoneMark = '~'; /**< Follows the key of a deleted record, the only field it keeps */
+
+    /**
+    * @brief Constructor for RecordView class.
+    * @param text the record, comma separated, possibly ending in a comma or newline.
+    */
+    explicit RecordView(std::string_view text = std::string_view());
+
+    /**
+    * @brief Gets the record as it is stored, with whatever it ended in.
+    * @return the text of the record.
+    */
+    std::string_view getText() const;
+
+    /**
+    * @brief Gets one field of the record.
+    * @param index the field to get, 0 for the zip code.
+    * @return the field without its deliminator, empty if the record has fewer fields.
+    */
+    std::string_view getField(int index) const;
+
+    /**
+    * @brief Gets the record key (zipcode).
+    * @return key as an integer, -1 if the record does not start with one.
+    */
+    int getKey() const;
+
+    /**
+    * @brief Checks if the record was deleted lazily and is only waiting to be purged.
+    * @return true if the key is followed by tombstoneMark.
+    */
+    bool isTombstone() const;
+
+    std::string_view getZipCode() const { return getField(0); }   /**< @return the ZipCode field */
+    std::string_view getPlaceName() const { return getField(1); } /**< @return the PlaceName field */
+    std::string_view getState() const { return getField(2); }     /**< @return the State field */
+    std::string_view getCounty() const { return getField(3); }    /**< @return the County field */
+
+    /**
+    * @brief Gets the latitude of the record.
+    * @return the Lat field as a number, 0 if it is not one.
+    */
+    double getLat() const;
+
+    /**
+    * @brief Gets the longitude of the record.
+    * @return the Long field as a number, 0 if it is not one.
+    */
+    double getLong() const;
+
+private:
+    std::string_view text;  /**< The record text, owned by someone else */
+
+    /**
+    * @brief Parses a number, ignoring anything after it.
+    * @param field the text to parse.
+    * @return the number, 0 if the text does not start with one.
+    */
+    static double parseDouble(std::string_view field);
+};
+
+#endif //CSCI331_PROJECT4_RECORDVIEW_H
@@ -5,75 +5,129 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <climits>
 #include "StateDatabase.h"
 
 using namespace std;
 
 void StateDatabase::processRecord(const Record &record) {
-    auto it = stateInfoMap.find(record.State);
+    processLocation(record.State, record.ZipCode, record.Lat, record.Long);
+}
+
+void StateDatabase::processLocation(string_view state, string_view zipCode, double lat, double lon) {
+    auto it = stateInfoMap.find(state);
 
     if (it != stateInfoMap.end()) {
         StateExtrema &extrema = it->second;
 
-        if (record.Long < extrema.eastLong) {
-            extrema.eastZip = record.ZipCode;
-            extrema.eastLong = record.Long;
+        if (lon < extrema.eastLong) {
+            extrema.eastZip = zipCode;
+            extrema.eastLong = lon;
         }
 
-        if (record.Long > extrema.westLong) {
-            extrema.westZip = record.ZipCode;
-            extrema.westLong = record.Long;
+        if (lon > extrema.westLong) {
+            extrema.westZip = zipCode;
+            extrema.westLong = lon;
         }
 
-        if (record.Lat > extrema.northLat) {
-            extrema.northZip = record.ZipCode;
-            extrema.northLat = record.Lat;
+        if (lat > extrema.northLat) {
+            extrema.northZip = zipCode;
+            extrema.northLat = lat;
         }
 
-        if (record.Lat < extrema.southLat) {
-            extrema.southZip = record.ZipCode;
-            extrema.southLat = record.Lat;
+        if (lat < extrema.southLat) {
+            extrema.southZip = zipCode;
+            extrema.southLat = lat;
         }
     } else {
         StateExtrema extrema;
-        extrema.eastZip = record.ZipCode;
-        extrema.eastLong = record.Long;
-        extrema.westZip = record.ZipCode;
-        extrema.westLong = record.Long;
-        extrema.northZip = record.ZipCode;
-        extrema.northLat = record.Lat;
-        extrema.southZip = record.ZipCode;
-        extrema.southLat = record.Lat;
-        stateInfoMap[record.State] = extrema;
+        extrema.eastZip = zipCode;
+        extrema.eastLong = lon;
+        extrema.westZip = zipCode;
+        extrema.westLong = lon;
+        extrema.northZip = zipCode;
+        extrema.northLat = lat;
+        extrema.southZip = zipCode;
+        extrema.southLat = lat;
+        stateInfoMap.emplace(string(state), extrema);
+    }
+}
+
+bool StateDatabase::processColumns(const LeafColumns &columns) {
+    const unsigned char *states = columns.states.data();
+    const int *lat = columns.lat.data();
+    const int *lon = columns.lon.data();
+    int count = columns.states.size();
+
+    for (int i = 0; i < count; i++) {
+        if (states[i] == ColumnarBlockCodec::rawState) return false;
+    }
+
+    for (int code = 0; code < columns.stateNames.size(); code++) {
+        // Branch free passes over the columns, which the compiler can vectorize
+        int matches = 0;
+        int eastLong = INT_MAX, westLong = INT_MIN, northLat = INT_MIN, southLat = INT_MAX;
+        for (int i = 0; i < count; i++) {
+            bool match = states[i] == code;
+            matches += match;
+            eastLong = min(eastLong, match ? lon[i] : INT_MAX);
+            westLong = max(westLong, match ? lon[i] : INT_MIN);
+            northLat = max(northLat, match ? lat[i] : INT_MIN);
+            southLat = min(southLat, match ? lat[i] : INT_MAX);
+        }
+        if (matches == 0) continue;
+
+        // The first record reaching each extreme, in record order
+        int extremes[4] = {-1, -1, -1, -1};
+        for (int i = 0; i < count; i++) {
+            if (states[i] != code) continue;
+            if (extremes[0] == -1 && lon[i] == eastLong) extremes[0] = i;
+            if (extremes[1] == -1 && lon[i] == westLong) extremes[1] = i;
+            if (extremes[2] == -1 && lat[i] == northLat) extremes[2] = i;
+            if (extremes[3] == -1 && lat[i] == southLat) extremes[3] = i;
+        }
+        sort(extremes, extremes + 4);
+
+        const string &state = columns.stateNames[code];
+        for (int j = 0; j < 4; j++) {
+            int i = extremes[j];
+            if (j > 0 && i == extremes[j - 1]) continue;
+            processLocation(state, to_string(columns.keys[i]),
+                            static_cast<double>(lat[i]) / ColumnarBlockCodec::coordinateScale,
+                            static_cast<double>(lon[i]) / ColumnarBlockCodec::coordinateScale);
+        }
     }
+
+    return true;
 }
 
-void StateDatabase::printStateInfo(std::string state) const {
+void StateDatabase::printStateInfo(std::ostream &ostream, std::string state) const {
     if (state == "*") {
-        cout << left << setw(5) << "State " << setw(15) << "Easternmost" << setw(15)
-             << "Westernmost" << setw(15) << "Northernmost" << setw(15) << "Southernmost" << endl;
+        ostream << left << setw(5) << "State " << setw(15) << "Easternmost" << setw(15)
+                << "Westernmost" << setw(15) << "Northernmost" << setw(15) << "Southernmost" << endl;
 
         for (auto state: stateInfoMap) {
-            cout << left << setw(6) << state.first
-                 << setw(15) << state.second.eastZip
-                 << setw(15) << state.second.westZip
-                 << setw(15) << state.second.northZip
-                 << setw(15) << state.second.southZip << endl;
+            ostream << left << setw(6) << state.first
+                    << setw(15) << state.second.eastZip
+                    << setw(15) << state.second.westZip
+                    << setw(15) << state.second.northZip
+                    << setw(15) << state.second.southZip << endl;
         }
     } else {
         auto it = stateInfoMap.find(state);
         if (it != stateInfoMap.end()) {
-            cout << left << setw(5) << "State " << setw(15) << "Easternmost" << setw(15)
-                 << "Westernmost" << setw(15) << "Northernmost" << setw(15) << "Southernmost" << endl;
+            ostream << left << setw(5) << "State " << setw(15) << "Easternmost" << setw(15)
+                    << "Westernmost" << setw(15) << "Northernmost" << setw(15) << "Southernmost" << endl;
 
             StateExtrema extrema = it->second;
-            cout << left << setw(6) << it->first
-                 << setw(15) << extrema.eastZip
-                 << setw(15) << extrema.westZip
-                 << setw(15) << extrema.northZip
-                 << setw(15) << extrema.southZip << endl;
+            ostream << left << setw(6) << it->first
+                    << setw(15) << extrema.eastZip
+                    << setw(15) << extrema.westZip
+                    << setw(15) << extrema.northZip
+                    << setw(15) << extrema.southZip << endl;
         } else {
-            cout << "STATE: " << state << " not found in database!" << endl;
+            ostream << "STATE: " << state << " not found in database!" << endl;
         }
     }
 }
@@ -16,8 +16,11 @@
 #define ZIPCODE_STATEDATABASE_H
 
 #include <map>
+#include <ostream>
+#include <string_view>
 #include "StateExtrema.h"
 #include "Record.h"
+#include "ColumnarBlockCodec.h"
 
 class StateDatabase {
 public:
@@ -32,16 +35,40 @@ public:
     */
     void processRecord(const Record &record);
 
+    /**
+    * @brief Processes one location and updates state information.
+    *
+    * @param state The State of the location.
+    * @param zipCode The zip code of the location.
+    * @param lat The latitude of the location.
+    * @param lon The longitude of the location.
+    * @post As processRecord, for a record holding these fields.
+    */
+    void processLocation(std::string_view state, std::string_view zipCode, double lat, double lon);
+
+    /**
+    * @brief Processes the records of a columnar block from its State and coordinate columns.
+    * @details Only the first record of each extreme in each State can change the database, so those
+    * are found with min and max passes over the coordinate columns and processed in record order,
+    * giving the same result as processing every record.
+    *
+    * @param columns The columns of the block.
+    * @return false if the block holds records kept as text, in which case nothing is processed.
+    */
+    bool processColumns(const LeafColumns &columns);
+
     /**
     * @brief Prints the state information.
     *
+    * @param ostream The stream to print to.
+    * @param state The state to print, or "*" for every state.
     * @pre None.
     * @post All objects in stateInfoMap are displayed by field.
     */
-    void printStateInfo(std::string state) const;
+    void printStateInfo(std::ostream &ostream, std::string state) const;
 
 private:
-    std::map<std::string, StateExtrema> stateInfoMap; /**< Map that links state ID to StateExtrema object. */
+    std::map<std::string, StateExtrema, std::less<>> stateInfoMap; /**< Map that links state ID to StateExtrema object. */
 };
 
 #endif //ZIPCODE_STATEDATABASE_H
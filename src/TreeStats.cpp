@@ -0,0 +1,196 @@
+/**
+ * @file TreeStats.cpp
+ * @brief Implementation file for the TreeStats class.
+ */
+
+#include "TreeStats.h"
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <set>
+
+using namespace std;
+
+namespace {
+
+struct ThreadCounters;
+
+/**
+ * The counters of live threads, and the totals of threads that have ended and of the last reset.
+ */
+struct Registry {
+    mutex registryMutex;
+    set<ThreadCounters*> live;
+    TreeStats::Counts retired{};
+    TreeStats::Counts baseline{};
+    array<LatencyHistogram, TreeStats::OPERATION_COUNT> retiredLatencies;
+    array<LatencyHistogram, TreeStats::OPERATION_COUNT> baselineLatencies;
+};
+
+Registry &getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+/**
+ * One thread's counters. Only the owning thread writes them, the atomics let reports read them meanwhile.
+ */
+struct ThreadCounters {
+    array<atomic<long long>, TreeStats::COUNTER_COUNT> values;
+    array<array<atomic<long long>, LatencyHistogram::bucketCount>, TreeStats::OPERATION_COUNT> latencyCounts;
+    array<atomic<long long>, TreeStats::OPERATION_COUNT> latencyTotals;
+
+    ThreadCounters() {
+        for (auto &value : values) value.store(0, memory_order_relaxed);
+        for (auto &buckets : latencyCounts) {
+            for (auto &bucket : buckets) bucket.store(0, memory_order_relaxed);
+        }
+        for (auto &latencyTotal : latencyTotals) latencyTotal.store(0, memory_order_relaxed);
+        Registry &registry = getRegistry();
+        lock_guard<mutex> guard(registry.registryMutex);
+        registry.live.insert(this);
+    }
+
+    ~ThreadCounters() {
+        Registry &registry = getRegistry();
+        lock_guard<mutex> guard(registry.registryMutex);
+        for (int i = 0; i < TreeStats::COUNTER_COUNT; i++) {
+            registry.retired[i] += values[i].load(memory_order_relaxed);
+        }
+        for (int i = 0; i < TreeStats::OPERATION_COUNT; i++) {
+            addLatencies(registry.retiredLatencies[i], static_cast<TreeStats::Operation>(i));
+        }
+        registry.live.erase(this);
+    }
+
+    /**
+     * Adds this thread's latencies of an operation to a histogram.
+     */
+    void addLatencies(LatencyHistogram &histogram, TreeStats::Operation operation) const {
+        for (int bucket = 0; bucket < LatencyHistogram::bucketCount; bucket++) {
+            long long count = latencyCounts[operation][bucket].load(memory_order_relaxed);
+            if (count > 0) histogram.addBucket(bucket, count, 0);
+        }
+        histogram.addBucket(0, 0, latencyTotals[operation].load(memory_order_relaxed));
+    }
+};
+
+thread_local ThreadCounters threadCounters;
+
+/**
+ * Adds up every thread's counters, ignoring the baseline.
+ */
+TreeStats::Counts total(Registry &registry) {
+    TreeStats::Counts counts = registry.retired;
+    for (ThreadCounters *counters : registry.live) {
+        for (int i = 0; i < TreeStats::COUNTER_COUNT; i++) {
+            counts[i] += counters->values[i].load(memory_order_relaxed);
+        }
+    }
+    return counts;
+}
+
+/**
+ * Adds up every thread's latencies of an operation, ignoring the baseline.
+ */
+LatencyHistogram totalLatencies(Registry &registry, TreeStats::Operation operation) {
+    LatencyHistogram histogram = registry.retiredLatencies[operation];
+    for (ThreadCounters *counters : registry.live) {
+        counters->addLatencies(histogram, operation);
+    }
+    return histogram;
+}
+
+}
+
+void TreeStats::add(Counter counter, long long amount) {
+    atomic<long long> &value = threadCounters.values[counter];
+    value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+TreeStats::Counts TreeStats::report() {
+    Registry &registry = getRegistry();
+    lock_guard<mutex> guard(registry.registryMutex);
+    Counts counts = total(registry);
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counts[i] -= registry.baseline[i];
+    }
+    return counts;
+}
+
+void TreeStats::reset() {
+    Registry &registry = getRegistry();
+    lock_guard<mutex> guard(registry.registryMutex);
+    registry.baseline = total(registry);
+    for (int i = 0; i < OPERATION_COUNT; i++) {
+        registry.baselineLatencies[i] = totalLatencies(registry, static_cast<Operation>(i));
+    }
+}
+
+const char *TreeStats::getName(Counter counter) {
+    static const char *names[COUNTER_COUNT] = {
+        "block_reads", "block_writes", "cache_hits", "bytes_parsed", "splits", "root_splits",
+        "three_way_splits", "merges", "redistributions", "redescents", "link_chases",
+    };
+    return names[counter];
+}
+
+void TreeStats::print(std::ostream &out, const Counts &counts) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        out << getName(static_cast<Counter>(i)) << "=" << counts[i] << "\n";
+    }
+    out.flush();
+}
+
+void TreeStats::recordLatency(Operation operation, long long nanoseconds) {
+    atomic<long long> &bucket = threadCounters.latencyCounts[operation][LatencyHistogram::getBucket(nanoseconds)];
+    bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic<long long> &latencyTotal = threadCounters.latencyTotals[operation];
+    latencyTotal.store(latencyTotal.load(memory_order_relaxed) + nanoseconds, memory_order_relaxed);
+}
+
+LatencyHistogram TreeStats::reportLatency(Operation operation) {
+    Registry &registry = getRegistry();
+    lock_guard<mutex> guard(registry.registryMutex);
+    LatencyHistogram histogram = totalLatencies(registry, operation);
+    histogram.subtract(registry.baselineLatencies[operation]);
+    return histogram;
+}
+
+const char *TreeStats::getName(Operation operation) {
+    static const char *names[OPERATION_COUNT] = {"insert", "remove", "search", "scan_leaf"};
+    return names[operation];
+}
+
+void TreeStats::printLatencies(std::ostream &out, bool json) {
+    static const double percentiles[] = {50, 90, 99, 99.9};
+    static const char *percentileNames[] = {"p50", "p90", "p99", "p99.9"};
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+
+    if (json) out << "{";
+    for (int i = 0; i < OPERATION_COUNT; i++) {
+        Operation operation = static_cast<Operation>(i);
+        LatencyHistogram histogram = reportLatency(operation);
+
+        if (json) {
+            out << (i > 0 ? ", " : "") << "\"" << getName(operation) << "\": {\"count\": " << histogram.getCount()
+                << ", \"mean_ns\": " << fixed << setprecision(1) << histogram.getMean();
+            for (int p = 0; p < 4; p++) {
+                out << ", \"" << percentileNames[p] << "_ns\": " << histogram.getPercentile(percentiles[p]);
+            }
+            out << ", \"max_ns\": " << histogram.getMax() << "}";
+        } else {
+            out << getName(operation) << " count=" << histogram.getCount()
+                << " mean_ns=" << fixed << setprecision(1) << histogram.getMean();
+            for (int p = 0; p < 4; p++) {
+                out << " " << percentileNames[p] << "_ns=" << histogram.getPercentile(percentiles[p]);
+            }
+            out << " max_ns=" << histogram.getMax() << "\n";
+        }
+    }
+    if (json) out << "}\n";
+    out.flags(flags);
+    out.precision(precision);
+    out.flush();
+}
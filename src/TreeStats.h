@@ -0,0 +1,155 @@
+/**
+ * @file TreeStats.h
+ * @brief Header file for the TreeStats class.
+ */
+
+/**
+ * @class TreeStats
+ * @brief Counters of block I/O and structural changes made by the tree, and histograms of how long its
+ * operations take.
+ * @details: Every thread counts into its own set of counters and histograms, so counting is a plain add
+ * to memory the thread alone writes. A report adds up the counters of every thread, including threads that have
+ * exited, whose counts are folded into a shared total when they end. The counters cover every tree in
+ * the process. reset keeps the current totals as a baseline that later reports are taken from, so it
+ * never races with threads still counting. Latencies are timed with the steady clock, which never goes
+ * back, and cost two clock reads and a bucket count per operation.
+ * Includes: Counting, timing, reporting, resetting and printing the counters and histograms.
+ */
+
+#ifndef CSCI331_PROJECT4_TREESTATS_H
+#define CSCI331_PROJECT4_TREESTATS_H
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include "LatencyHistogram.h"
+
+class TreeStats {
+public:
+    /**
+    * @brief The events that are counted.
+    */
+    enum Counter {
+        BLOCK_READS,        /**< Node blocks read from file */
+        BLOCK_WRITES,       /**< Node blocks written to file */
+        CACHE_HITS,         /**< Nodes found in the buffer pool */
+        BYTES_PARSED,       /**< Bytes of block images parsed into nodes */
+        SPLITS,             /**< Nodes split in two, the root included */
+        ROOT_SPLITS,        /**< Splits of the root, each adding a level */
+        THREE_WAY_SPLITS,   /**< Pairs of full siblings split into three */
+        MERGES,             /**< Pairs of siblings merged into one */
+        REDISTRIBUTIONS,    /**< Entries moved between siblings instead of a split or merge */
+        REDESCENTS,         /**< Descents started again from the root to find a parent or retry */
+        LINK_CHASES,        /**< Right links followed past a concurrent split in B_LINK mode */
+        COUNTER_COUNT       /**< Number of counters */
+    };
+
+    typedef std::array<long long, COUNTER_COUNT> Counts; /**< A value for every counter */
+
+    /**
+    * @brief The operations that are timed.
+    */
+    enum Operation {
+        INSERT,             /**< Inserting a record */
+        REMOVE,             /**< Removing a record */
+        SEARCH,             /**< Searching for a record by key */
+        SCAN_LEAF,          /**< Reading one leaf of a scan along the sequence set, and moving to the next */
+        OPERATION_COUNT     /**< Number of operations */
+    };
+
+    /**
+    * @class Timer
+    * @brief Times an operation from its construction until it is destroyed.
+    */
+    class Timer {
+    public:
+        /**
+        * @brief Starts timing.
+        * @param operation the operation the latency is counted under
+        */
+        explicit Timer(Operation operation) : operation(operation), start(std::chrono::steady_clock::now()) {}
+
+        /**
+        * @brief Counts the time since the timer started.
+        */
+        ~Timer() {
+            recordLatency(operation, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+        }
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+    private:
+        Operation operation;                            /**< The operation being timed */
+        std::chrono::steady_clock::time_point start;    /**< When the timer started */
+    };
+
+    /**
+    * @brief Adds to a counter of the calling thread.
+    * @param counter the counter to add to
+    * @param amount how much to add
+    * @return nothing
+    */
+    static void add(Counter counter, long long amount = 1);
+
+    /**
+    * @brief Adds up the counters of every thread since the last reset.
+    * @return the totals
+    */
+    static Counts report();
+
+    /**
+    * @brief Starts the counters over from zero.
+    * @return nothing
+    */
+    static void reset();
+
+    /**
+    * @brief Gets the name a counter is printed under.
+    * @param counter the counter
+    * @return the name, in lower case with underscores
+    */
+    static const char *getName(Counter counter);
+
+    /**
+    * @brief Prints one line per counter.
+    * @param out the stream to print to
+    * @param counts the totals to print
+    * @return nothing
+    */
+    static void print(std::ostream &out, const Counts &counts);
+
+    /**
+    * @brief Counts a latency in a histogram of the calling thread.
+    * @param operation the operation that took the time
+    * @param nanoseconds how long it took
+    * @return nothing
+    */
+    static void recordLatency(Operation operation, long long nanoseconds);
+
+    /**
+    * @brief Adds up the latencies of an operation counted by every thread since the last reset.
+    * @param operation the operation
+    * @return the histogram of its latencies
+    */
+    static LatencyHistogram reportLatency(Operation operation);
+
+    /**
+    * @brief Gets the name an operation is printed under.
+    * @param operation the operation
+    * @return the name, in lower case with underscores
+    */
+    static const char *getName(Operation operation);
+
+    /**
+    * @brief Prints the count, mean, 50th, 90th, 99th and 99.9th percentile and largest latency of every
+    * operation, in nanoseconds.
+    * @param out the stream to print to
+    * @param json true to print one JSON object keyed by operation, false for one line per operation
+    * @return nothing
+    */
+    static void printLatencies(std::ostream &out, bool json);
+};
+
+#endif //CSCI331_PROJECT4_TREESTATS_H
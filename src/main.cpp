@@ -5,21 +5,31 @@
  *        various views of the data, such as extrema, sequence sets, and the tree structure itself.
  */
 
+#include <csignal>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include "RecordBuffer.h"
 #include "HeaderBuffer.h"
 #include "Record.h"
-#include "RecordFile.h"
+#include "ParallelCsvReader.h"
 #include "BTreeFile.h"
+#include "BTreeServer.h"
 
 using namespace std;
 
 // Function prototypes
 bool processCommandLine(int argc, char* argv[], HeaderBuffer &headerBuffer, vector<vector<string>> &actions);
-void addRecords(BTreeFile &bTreeFile, HeaderBuffer &headerBuffer, const string& fileName);
-void deleteRecords(BTreeFile &bTreeFile, HeaderBuffer &headerBuffer, const string& fileName);
+void addRecords(BTreeFile &bTreeFile, const string& fileName);
+void deleteRecords(BTreeFile &bTreeFile, const string& fileName);
 void searchIndex(BTreeFile &bTreeFile, vector<string> zipcodes);
+void defragmentIndex(BTreeFile &bTreeFile, int leavesPerStep);
+void purgeIndex(BTreeFile &bTreeFile, int leavesPerStep);
+void vacuumIndex(BTreeFile &bTreeFile, double fillFactor);
+void verifyIndex(BTreeFile &bTreeFile, int threads);
+void analyzeIndex(BTreeFile &bTreeFile, int threads);
+void serveIndex(BTreeFile &bTreeFile, const string& socketPath);
+void streamCommands(BTreeFile &bTreeFile, istream &input, ostream &output);
 
 /**
  * Main function which serves as the entry point for the program. It processes command line
@@ -30,6 +40,8 @@ void searchIndex(BTreeFile &bTreeFile, vector<string> zipcodes);
  * @return int Program exit status.
  */
 int main(int argc, char* argv[]) {
+    ios::sync_with_stdio(false); // Lets cin buffer ahead, so -STDIN can see commands waiting to be read.
+
     HeaderBuffer headerBuffer; // Object to manage file header operations.
 
     string bTreeFileName; // Name of the B+ tree file.
@@ -49,25 +61,60 @@ int main(int argc, char* argv[]) {
         return -1;
     }
 
+    bool showStats = false; // Print the counters once every action has run.
+    string latencyFormat; // Print the latency percentiles once every action has run, as TEXT or JSON.
+
     // Iterate through actions derived from command line arguments and perform them.
     for (int i = 0; i < actions.size(); i++) {
         string action = actions[i][0]; // Action type (e.g., -ADD_RECORDS, -SEARCH).
         // Call specific function based on the action.
-        if (action == "-ADD_RECORDS") {
-            addRecords(bTreeFile, headerBuffer, actions[i][1]);
+        if (action == "-SPLIT_MODE") {
+            bTreeFile.setSplitMode(actions[i][1] == "TWO_TO_THREE" ? BTreeFile::TWO_TO_THREE : BTreeFile::ONE_TO_TWO);
+        } else if (action == "-LAZY_DELETE") {
+            bTreeFile.setDeleteMode(BTreeFile::LAZY);
+            bTreeFile.setTombstoneThreshold(actions[i].size() > 1 ? stoi(actions[i][1]) : 1024);
+        } else if (action == "-ADD_RECORDS") {
+            addRecords(bTreeFile, actions[i][1]);
         } else if (action == "-DELETE_RECORDS") {
-            deleteRecords(bTreeFile, headerBuffer, actions[i][1]);
+            deleteRecords(bTreeFile, actions[i][1]);
         } else if (action == "-DISPLAY_EXTREMA") {
             bTreeFile.displayExtrema(cout, actions[i][1]);
         } else if (action == "-DISPLAY_SEQUENCE_SET") {
             bTreeFile.displaySequenceSet(cout);
         } else if (action == "-DUMP_TREE") {
             bTreeFile.displayTree(cout);
+        } else if (action == "-STATS") {
+            showStats = true;
+        } else if (action == "-LATENCIES") {
+            latencyFormat = actions[i].size() > 1 ? actions[i][1] : "TEXT";
         } else if (action == "-SEARCH") {
             searchIndex(bTreeFile, actions[i]);
+        } else if (action == "-DEFRAGMENT") {
+            defragmentIndex(bTreeFile, actions[i].size() > 1 ? stoi(actions[i][1]) : 64);
+        } else if (action == "-PURGE") {
+            purgeIndex(bTreeFile, actions[i].size() > 1 ? stoi(actions[i][1]) : 64);
+        } else if (action == "-VACUUM") {
+            vacuumIndex(bTreeFile, actions[i].size() > 1 ? stod(actions[i][1]) : 0.9);
+        } else if (action == "-VERIFY") {
+            verifyIndex(bTreeFile, actions[i].size() > 1 ? stoi(actions[i][1]) : 0);
+        } else if (action == "-ANALYZE") {
+            analyzeIndex(bTreeFile, actions[i].size() > 1 ? stoi(actions[i][1]) : 0);
+        } else if (action == "-SERVE") {
+            serveIndex(bTreeFile, actions[i][1]);
+        } else if (action == "-STDIN") {
+            streamCommands(bTreeFile, cin, cout);
         }
     }
 
+    // Flush first so the writes the run left cached are counted
+    if (showStats) {
+        bTreeFile.flushData();
+        TreeStats::print(cout, TreeStats::report());
+    }
+    if (!latencyFormat.empty()) {
+        TreeStats::printLatencies(cout, latencyFormat == "JSON");
+    }
+
     return 0;
 }
 
@@ -98,6 +145,10 @@ bool processCommandLine(int argc, char* argv[], HeaderBuffer &headerBuffer, vect
         if (arg == "-BLOCK_SIZE") {
             if (i + 1 < argc) {
                 headerBuffer.blockSize = stoi(argv[++i]); // Parse and set block size, advance to next argument.
+                if (headerBuffer.blockSize <= 0 || headerBuffer.blockSize > HeaderBuffer::maxBlockSize) {
+                    cout << "Error: -BLOCK_SIZE must be between 1 and " << HeaderBuffer::maxBlockSize << "." << endl;
+                    return false;
+                }
             } else {
                 cout << "Error: -BLOCK_SIZE flag requires a numerical value." << endl;
                 return false;
@@ -109,6 +160,40 @@ bool processCommandLine(int argc, char* argv[], HeaderBuffer &headerBuffer, vect
                 cout << "Error: -MINIMUM_BLOCK_CAPACITY flag requires a numerical value." << endl;
                 return false;
             }
+        } else if (arg == "-LEAF_ENCODING") {
+            if (i + 1 < argc - 1) {
+                headerBuffer.leafEncoding = argv[++i]; // TEXT, COMPACT or COLUMNAR, used when the file is created.
+            } else {
+                cout << "Error: -LEAF_ENCODING flag requires TEXT, COMPACT or COLUMNAR." << endl;
+                return false;
+            }
+        } else if (arg == "-BLOCK_CODEC") {
+            if (i + 1 < argc - 1) {
+                headerBuffer.blockCodec = argv[++i]; // NONE or LZ, used when the file is created.
+            } else {
+                cout << "Error: -BLOCK_CODEC flag requires NONE or LZ." << endl;
+                return false;
+            }
+        } else if (arg == "-BLOCK_CHECKSUM") {
+            if (i + 1 < argc - 1) {
+                headerBuffer.blockChecksum = argv[++i]; // NONE or CRC32C, used when the file is created.
+            } else {
+                cout << "Error: -BLOCK_CHECKSUM flag requires NONE or CRC32C." << endl;
+                return false;
+            }
+        } else if (arg == "-SPLIT_MODE") {
+            if (i + 1 < argc - 1) {
+                actions.push_back({arg, argv[++i]}); // ONE_TO_TWO or TWO_TO_THREE, for the actions after it.
+            } else {
+                cout << "Error: -SPLIT_MODE flag requires ONE_TO_TWO or TWO_TO_THREE." << endl;
+                return false;
+            }
+        } else if (arg == "-LAZY_DELETE") {
+            vector<string> tmp = {arg};
+            if (i + 1 < argc - 1 && argv[i + 1][0] != '-') {
+                tmp.push_back(argv[++i]); // Add the tombstone threshold if present, then advance.
+            }
+            actions.push_back(tmp);
         } else if (arg == "-ADD_RECORDS") {
             if (i + 1 < argc) {
                 actions.push_back({arg, argv[++i]}); // Schedule addition of records, move past filename.
@@ -131,15 +216,62 @@ bool processCommandLine(int argc, char* argv[], HeaderBuffer &headerBuffer, vect
             actions.push_back(tmp);
         } else if (arg == "-DISPLAY_SEQUENCE_SET") {
             actions.push_back({arg}); // Schedule display of the sequence set.
+        } else if (arg == "-STATS") {
+            actions.push_back({arg}); // Print the counters after the run.
+        } else if (arg == "-LATENCIES") {
+            vector<string> tmp = {arg};
+            if (i + 1 < argc - 1 && (string(argv[i + 1]) == "TEXT" || string(argv[i + 1]) == "JSON")) {
+                tmp.push_back(argv[++i]); // Add the output format if given, then advance.
+            }
+            actions.push_back(tmp);
         } else if (arg == "-DUMP_TREE") {
             actions.push_back({arg}); // Schedule display of the B+ tree structure.
         } else if (arg == "-SEARCH") {
             vector<string> tmp = {arg};
-            // Accumulate all zip codes until another flag or the end of arguments.
-            while (i + 1 < argc && argv[i + 1][0] != '-') {
+            // Accumulate all zip codes until another flag or the B+ tree file name.
+            while (i + 1 < argc - 1 && argv[i + 1][0] != '-') {
                 tmp.push_back(argv[++i]);
             }
             actions.push_back(tmp);
+        } else if (arg == "-SERVE") {
+            if (i + 1 < argc - 1) {
+                actions.push_back({arg, argv[++i]}); // Schedule serving requests, move past the socket path.
+            } else {
+                cout << "Error: -SERVE flag requires a socket path." << endl;
+                return false;
+            }
+        } else if (arg == "-STDIN") {
+            actions.push_back({arg}); // Schedule reading commands from standard input.
+        } else if (arg == "-DEFRAGMENT") {
+            vector<string> tmp = {arg};
+            if (i + 1 < argc - 1 && argv[i + 1][0] != '-') {
+                tmp.push_back(argv[++i]); // Add the leaves per step if present, then advance.
+            }
+            actions.push_back(tmp);
+        } else if (arg == "-PURGE") {
+            vector<string> tmp = {arg};
+            if (i + 1 < argc - 1 && argv[i + 1][0] != '-') {
+                tmp.push_back(argv[++i]); // Add the leaves per step if present, then advance.
+            }
+            actions.push_back(tmp);
+        } else if (arg == "-VACUUM") {
+            vector<string> tmp = {arg};
+            if (i + 1 < argc - 1 && argv[i + 1][0] != '-') {
+                tmp.push_back(argv[++i]); // Add the fill factor if present, then advance.
+            }
+            actions.push_back(tmp);
+        } else if (arg == "-VERIFY") {
+            vector<string> tmp = {arg};
+            if (i + 1 < argc - 1 && argv[i + 1][0] != '-') {
+                tmp.push_back(argv[++i]); // Add the thread count if present, then advance.
+            }
+            actions.push_back(tmp);
+        } else if (arg == "-ANALYZE") {
+            vector<string> tmp = {arg};
+            if (i + 1 < argc - 1 && argv[i + 1][0] != '-') {
+                tmp.push_back(argv[++i]); // Add the thread count if present, then advance.
+            }
+            actions.push_back(tmp);
         }
     }
 
@@ -148,70 +280,52 @@ bool processCommandLine(int argc, char* argv[], HeaderBuffer &headerBuffer, vect
 
 
 /**
- * Adds records to the B+ tree from a specified file. This function opens the file containing new records,
- * reads each record into a RecordBuffer object, and then inserts each record into the B+ tree.
- * If the specified file contains records in a format not compatible with direct insertion into the B+ tree,
- * a pre-processing step might be necessary to convert the file into a suitable format.
+ * Adds records to the B+ tree from a specified file. The CSV file containing new records is parsed on
+ * several threads, and each batch of parsed records is inserted into the B+ tree in file order.
  *
  * @param bTreeFile Reference to the BTreeFile object to perform operations on the B+ tree.
- * @param headerBuffer Reference to the HeaderBuffer object for managing file headers, used here
- *        for configuring the RecordFile object for reading the new records.
- * @param fileName Name of the file containing the new records to add. The file format is expected
- *        to be compatible with the RecordBuffer and RecordFile specifications for direct reading
- *        and insertion into the B+ tree.
+ * @param fileName Name of the CSV file containing the new records to add, with a header line first.
  */
-void addRecords(BTreeFile &bTreeFile, HeaderBuffer &headerBuffer, const string& fileName) {
-    RecordBuffer recordBuffer; // Buffer for individual records to be added.
-    RecordFile newRecordsFile(headerBuffer); // File handler for the new records, configured with the header buffer.
+void addRecords(BTreeFile &bTreeFile, const string& fileName) {
+    ParallelCsvReader newRecordsFile; // Parses the records straight from the CSV file.
 
-    string lengthIndicatedFile; // Filename for a temporary, length-indicated version of the records file.
     // Attempt to open the file containing new records. If unsuccessful, print an error message and exit this function.
-    if (!newRecordsFile.openFile(fileName, lengthIndicatedFile)) {
+    if (!newRecordsFile.openFile(fileName)) {
         cout << "Failed to open " << fileName << " for adding records." << endl;
         return;
     }
 
-    // Read each record from the file into the record buffer, then insert it into the B+ tree.
-    while (newRecordsFile.read(recordBuffer) != -1) {
-        // Insert the current record into the B+ tree.
-        bTreeFile.insert(recordBuffer);
-    }
-
-    // Clean up: Attempt to delete the temporary file used for processing.
-    if (std::remove(lengthIndicatedFile.c_str()) != 0) {
-        cout << "Failed to delete temporary file: " << lengthIndicatedFile << endl;
-    }
+    // Insert each batch of records into the B+ tree while the next batches are parsed.
+    newRecordsFile.readBatches([&bTreeFile](vector<RecordBuffer> &batch) {
+        for (RecordBuffer &recordBuffer : batch) {
+            bTreeFile.insert(recordBuffer);
+        }
+    });
 }
 
 
 /**
  * Deletes records from the B+ tree based on the contents of a specified file.
- * This function iterates through each record in the file, constructs a RecordBuffer object for it,
- * and then attempts to remove it from the B+ tree.
+ * The CSV file is parsed on several threads into batches of RecordBuffer objects,
+ * and each record is then removed from the B+ tree in file order.
  *
  * @param bTreeFile Reference to the BTreeFile object to operate on the B+ tree.
- * @param headerBuffer Reference to the HeaderBuffer object for managing file headers.
- * @param fileName Name of the file containing records to delete.
+ * @param fileName Name of the CSV file containing records to delete, with a header line first.
  */
-void deleteRecords(BTreeFile &bTreeFile, HeaderBuffer &headerBuffer, const string& fileName) {
-    RecordBuffer recordBuffer; // Buffer for individual records to be deleted.
-    RecordFile deleteRecordsFile(headerBuffer); // Handles file operations for records to delete.
+void deleteRecords(BTreeFile &bTreeFile, const string& fileName) {
+    ParallelCsvReader deleteRecordsFile; // Parses the records straight from the CSV file.
 
-    string lengthIndicatedFile; // Temporary file for length-indicated processing.
-    if (!deleteRecordsFile.openFile(fileName, lengthIndicatedFile)) {
+    if (!deleteRecordsFile.openFile(fileName)) {
         cout << "Failed to open " << fileName << " for deletion!" << endl;
         return;
     }
 
-    // Loop to read each record from the file and attempt to delete from the B+ tree.
-    while (deleteRecordsFile.read(recordBuffer) != -1) {
-        bTreeFile.remove(recordBuffer);
-    }
-
-    // Clean up: Attempt to delete the temporary file used for processing.
-    if (std::remove(lengthIndicatedFile.c_str()) != 0) {
-        cout << "Failed to delete temporary file: " << lengthIndicatedFile << endl;
-    }
+    // Attempt to delete each record of each batch from the B+ tree.
+    deleteRecordsFile.readBatches([&bTreeFile](vector<RecordBuffer> &batch) {
+        for (RecordBuffer &recordBuffer : batch) {
+            bTreeFile.remove(recordBuffer);
+        }
+    });
 }
 
 
@@ -239,3 +353,256 @@ void searchIndex(BTreeFile &bTreeFile, vector<string> zipcodes) {
         }
     }
 }
+
+
+/**
+ * Moves the leaves of the B+ tree so the sequence set reads the file from front to back. The work is
+ * done in steps of a few leaves, as it would be if it were interleaved with other requests.
+ *
+ * @param bTreeFile Reference to the BTreeFile object for B+ tree operations.
+ * @param leavesPerStep The most leaves to visit in each step.
+ */
+void defragmentIndex(BTreeFile &bTreeFile, int leavesPerStep) {
+    int moved = 0; // Leaves moved by one step.
+    int totalMoved = 0; // Leaves moved by every step.
+    int status;
+
+    while ((status = bTreeFile.defragmentStep(leavesPerStep, moved)) > 0) {
+        totalMoved += moved;
+    }
+    totalMoved += moved;
+
+    if (status == -1) {
+        cout << "Failed to defragment the B+ tree." << endl;
+    } else {
+        cout << "Moved " << totalMoved << " leaves into sequence set order." << endl;
+    }
+}
+
+
+/**
+ * Removes the tombstones lazy deletes left in the B+ tree, merging or redistributing the leaves that are
+ * left underfilled. The work is done in steps of a few leaves, as it would be in the background.
+ *
+ * @param bTreeFile Reference to the BTreeFile object for B+ tree operations.
+ * @param leavesPerStep The most leaves to visit in each step.
+ */
+void purgeIndex(BTreeFile &bTreeFile, int leavesPerStep) {
+    int purged = 0; // Tombstones removed by one step.
+    int totalPurged = 0; // Tombstones removed by every step.
+    int status;
+
+    while ((status = bTreeFile.purgeStep(leavesPerStep, purged)) > 0) {
+        totalPurged += purged;
+    }
+    totalPurged += purged;
+
+    if (status == -1) {
+        cout << "Failed to purge the B+ tree." << endl;
+    } else {
+        cout << "Purged " << totalPurged << " deleted records." << endl;
+    }
+}
+
+
+/**
+ * Rebuilds the B+ tree into a freshly packed file that replaces the current one, then reports how
+ * much space was reclaimed and how the height and number of leaves changed.
+ *
+ * @param bTreeFile Reference to the BTreeFile object for B+ tree operations.
+ * @param fillFactor How full to make each node, from above 0 up to 1.
+ */
+void vacuumIndex(BTreeFile &bTreeFile, double fillFactor) {
+    VacuumReport report; // Sizes and shapes of the tree before and after.
+
+    if (bTreeFile.vacuum(fillFactor, report) == -1) {
+        cout << "Failed to vacuum the B+ tree." << endl;
+        return;
+    }
+
+    cout << "Reclaimed " << static_cast<long long>(report.oldSize) - static_cast<long long>(report.newSize)
+         << " bytes, " << report.oldSize << " before and " << report.newSize << " after." << endl;
+    cout << "Height " << report.oldHeight << " before and " << report.newHeight << " after." << endl;
+    cout << "Leaves " << report.oldLeaves << " before and " << report.newLeaves << " after." << endl;
+}
+
+
+/**
+ * Checks the checksum of every block in the B+ tree file on several threads, and reports each
+ * block that is damaged.
+ *
+ * @param bTreeFile Reference to the BTreeFile object for B+ tree operations.
+ * @param threads Number of threads to check with, 0 for one per core.
+ */
+void verifyIndex(BTreeFile &bTreeFile, int threads) {
+    VerifyReport report; // Blocks checked and the ones that failed.
+
+    if (bTreeFile.verify(report, threads) == -1) {
+        cout << "Failed to verify the B+ tree, the file has no block checksums or could not be read." << endl;
+        return;
+    }
+
+    for (int RBN : report.badBlocks) {
+        cout << "Block " << RBN << " failed its checksum." << endl;
+    }
+    cout << "Verified " << report.blocks << " blocks, " << report.badBlocks.size() << " damaged." << endl;
+}
+
+
+/**
+ * Walks the B+ tree once and prints its height, a table of the nodes on each level and how full
+ * they are, the free blocks, the average key span of a leaf and how often a leaf links to the
+ * block after its own, which tell when the tree is worth a vacuum or a defragment.
+ *
+ * @param bTreeFile Reference to the BTreeFile object for B+ tree operations.
+ * @param threads Number of threads to read index levels with, 0 for one per core.
+ */
+void analyzeIndex(BTreeFile &bTreeFile, int threads) {
+    AnalyzeReport report; // Shape, fill and layout of the tree.
+
+    if (bTreeFile.analyze(report, threads) == -1) {
+        cout << "Failed to analyze the B+ tree, a block could not be read." << endl;
+        return;
+    }
+
+    ios::fmtflags flags = cout.flags(); // Restored at the end, so later output prints as before.
+    streamsize precision = cout.precision();
+
+    cout << "Height: " << report.height << endl;
+    cout << "Level   Nodes   Fill";
+    for (int i = 0; i < 10; i++) {
+        cout << setw(6) << i * 10 << "%";
+    }
+    cout << endl;
+    for (int depth = report.height - 1; depth >= 0; depth--) {
+        const LevelReport &level = report.levels[depth];
+        cout << setw(5) << depth << setw(8) << level.nodes << setw(6) << fixed << setprecision(1)
+             << level.averageFill * 100 << "%";
+        for (int count : level.fillHistogram) {
+            cout << setw(7) << count;
+        }
+        cout << endl;
+    }
+
+    cout << "Blocks: " << report.blocks << ", " << report.freeBlocks << " free" << endl;
+    cout << "Records: " << report.records << ", average key span per leaf " << report.averageKeySpan << endl;
+    cout << "Leaf chain locality: "
+         << (report.leafLinks > 0 ? 100.0 * report.sequentialLinks / report.leafLinks : 100.0) << "% ("
+         << report.sequentialLinks << " of " << report.leafLinks << " links to the next block, "
+         << report.forwardLinks << " further on)" << endl;
+
+    cout.flags(flags);
+    cout.precision(precision);
+}
+
+
+/**
+ * Serves requests against the B+ tree over a Unix domain socket until the process receives
+ * SIGINT or SIGTERM. The tree and its cached nodes stay in memory between requests, so clients
+ * avoid reopening the file for every lookup. Changes are flushed when the tree file is closed.
+ *
+ * @param bTreeFile Reference to the BTreeFile object to serve.
+ * @param socketPath Filesystem path to listen on.
+ */
+void serveIndex(BTreeFile &bTreeFile, const string& socketPath) {
+    BTreeServer server(bTreeFile);
+
+    signal(SIGINT, [](int) { BTreeServer::stop(); });
+    signal(SIGTERM, [](int) { BTreeServer::stop(); });
+
+    cout << "Serving on " << socketPath << endl;
+    if (server.serve(socketPath) == -1) {
+        cout << "Failed to listen on " << socketPath << "!" << endl;
+    }
+}
+
+
+/**
+ * Runs commands read from a stream against the B+ tree, one command per line, until the stream ends:
+ *   SEARCH zipcode       -> FOUND csv | NOT_FOUND zipcode
+ *   RANGE low high       -> RANGE count, followed by one csv line per record
+ *   ADD csv              -> OK | ERROR
+ *   DEL zipcode          -> OK | NOT_FOUND zipcode
+ * Replies are collected in a buffer and only written out once every command already received has
+ * been answered, so a client can send many commands without waiting for each reply.
+ *
+ * @param bTreeFile Reference to the BTreeFile object for B+ tree operations.
+ * @param input The stream to read commands from.
+ * @param output The stream to write replies to.
+ */
+void streamCommands(BTreeFile &bTreeFile, istream &input, ostream &output) {
+    const size_t flushSize = 1 << 16; // Write replies out once this many bytes are pending.
+    string replies; // Replies not yet written.
+    string line; // Current command.
+    RecordBuffer recordBuffer; // Buffer for records found or added.
+
+    input.tie(nullptr);
+
+    while (getline(input, line)) {
+        istringstream command(line);
+        string op;
+        command >> op;
+
+        try {
+            if (op == "SEARCH") {
+                int zipCode;
+                command >> zipCode;
+                if (!command) {
+                    replies += "ERROR " + line + "\n";
+                } else if (bTreeFile.search(recordBuffer, zipCode) != -1) {
+                    replies += "FOUND " + recordBuffer.getRecord() + "\n";
+                } else {
+                    replies += "NOT_FOUND " + to_string(zipCode) + "\n";
+                }
+            } else if (op == "RANGE") {
+                int lowZip, highZip;
+                vector<RecordBuffer> results;
+                command >> lowZip >> highZip;
+                if (!command || bTreeFile.rangeSearch(lowZip, highZip, results) == -1) {
+                    replies += "ERROR " + line + "\n";
+                } else {
+                    replies += "RANGE " + to_string(results.size()) + "\n";
+                    for (auto &result : results) {
+                        replies += result.getRecord() + "\n";
+                    }
+                }
+            } else if (op == "ADD") {
+                string record;
+                getline(command >> ws, record);
+                recordBuffer.clear();
+                if (recordBuffer.packRecord(record) != -1 && bTreeFile.insert(recordBuffer) != -1) {
+                    replies += "OK\n";
+                } else {
+                    replies += "ERROR " + line + "\n";
+                }
+            } else if (op == "DEL") {
+                int zipCode;
+                command >> zipCode;
+                recordBuffer.clear();
+                recordBuffer.pack(to_string(zipCode));
+                if (!command) {
+                    replies += "ERROR " + line + "\n";
+                } else if (bTreeFile.remove(recordBuffer) != -1) {
+                    replies += "OK\n";
+                } else {
+                    replies += "NOT_FOUND " + to_string(zipCode) + "\n";
+                }
+            } else if (!op.empty()) {
+                replies += "ERROR " + line + "\n";
+            }
+        } catch (...) {
+            // A record without a numeric zip code
+            replies += "ERROR " + line + "\n";
+        }
+
+        // Hold replies back while more commands are already waiting to be read
+        if (replies.size() >= flushSize || input.rdbuf()->in_avail() <= 0) {
+            output.write(replies.data(), replies.size());
+            output.flush();
+            replies.clear();
+        }
+    }
+
+    output.write(replies.data(), replies.size());
+    output.flush();
+}